@@ -0,0 +1,67 @@
+#ifndef _UNIAUDIO_ADAPTIVE_DEPTH_H_
+#define _UNIAUDIO_ADAPTIVE_DEPTH_H_
+
+namespace ua
+{
+
+/**
+ * How many blocks a buffer keeps queued, from the time between its
+ * refills and its underruns.
+ *
+ * The depth covers the longest recent refill gap plus the block being
+ * played. An underrun grows it by half at once, it shrinks one block at
+ * a time after SHRINK_DELAY without one. Not thread-safe, called by the
+ * side that refills.
+ **/
+class AdaptiveDepth
+{
+public:
+	// starts at `max_depth`
+	AdaptiveDepth(float block_time, int min_depth, int max_depth);
+
+	// in blocks, `max_depth` is at least `min_depth`
+	void SetRange(int min_depth, int max_depth);
+	// in second, rounded up to whole blocks
+	void SetLatency(float min_time, float max_time);
+
+	// a refill at `time` second, `underruns` the total so far, return the
+	// depth
+	int Update(double time, int underruns);
+	// same, now on the steady clock
+	int Update(int underruns);
+	// after a pause in the refills, which is not a gap to cover
+	void Restart() { m_last_time = -1; }
+
+	int GetDepth() const { return m_depth; }
+	int GetMinDepth() const { return m_min; }
+	int GetMaxDepth() const { return m_max; }
+
+	float GetBlockTime() const { return m_block_time; }
+
+public:
+	// the longest refill gap halves in this time, in second
+	static const float GAP_HALF_LIFE;
+	// without an underrun before shrinking, in second
+	static const float SHRINK_DELAY;
+	// between two shrink steps, in second
+	static const float SHRINK_STEP;
+
+private:
+	float m_block_time;
+
+	int m_min, m_max;
+	int m_depth;
+
+	// of the last Update(), < 0 before the first
+	double m_last_time;
+	// decaying maximum of the refill gaps, in second
+	double m_peak_gap;
+	int    m_underruns;
+	// no shrinking before
+	double m_hold_until;
+
+}; // AdaptiveDepth
+
+}
+
+#endif // _UNIAUDIO_ADAPTIVE_DEPTH_H_
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef _UNIAUDIO_ADPCM_DECODER_H_
+#define _UNIAUDIO_ADPCM_DECODER_H_
+
+#include "uniaudio/Decoder.h"
+#include "uniaudio/ImaAdpcm.h"
+
+namespace ua
+{
+
+class AudioData;
+
+// Plays an AudioData kept as IMA ADPCM, see AudioData::STORE_IMA_ADPCM,
+// decoding the blocks as they are reached, so the PCM of a resident
+// sound is only ever a stream buffer long. The data is not owned and
+// must outlive the decoder.
+class AdpcmDecoder : public Decoder
+{
+public:
+	AdpcmDecoder(const AudioData* data, int buf_sz = DEFAULT_BUFFER_SIZE);
+	AdpcmDecoder(const AdpcmDecoder&);
+	virtual ~AdpcmDecoder();
+
+	virtual Decoder* Clone() override;
+
+	virtual int Decode(unsigned char* dst, int size) override final;
+	using Decoder::Decode;
+
+	virtual bool Seek(float s) override final;
+	// costs a block decode at most
+	virtual bool SeekFrame(int64_t frame) override final;
+	virtual bool Rewind() override final;
+
+	virtual int GetChannels() const override final;
+	virtual int GetBitDepth() const override final;
+
+	virtual float GetDuration() const override final;
+
+private:
+	const AudioData* m_data;
+
+	ImaAdpcm m_ima;
+
+	// of the next Decode()
+	int64_t m_frame;
+
+}; // AdpcmDecoder
+
+}
+
+#endif // _UNIAUDIO_ADPCM_DECODER_H_
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef _UNIAUDIO_AUDIO_CONTEXT_H_
 #define _UNIAUDIO_AUDIO_CONTEXT_H_
 
+#include "uniaudio/OutputFormat.h"
+
 #include <cu/cu_stl.h>
 
 #include <memory>
@@ -11,6 +13,9 @@ namespace ua
 class Source;
 class AudioData;
 class Decoder;
+class MixGraph;
+class XrunLog;
+class BufferPool;
 
 class AudioContext
 {
@@ -29,6 +34,32 @@ public:
 
 	virtual void SetVolume(float volume) = 0;
 
+	// Mixes the streamed voices on `threads` worker threads, 0 mixes them
+	// on the device thread. The output is the same for any count above 0.
+	virtual void SetMixThreads(int threads) = 0;
+
+	// Decodes the mixed streams ahead on `threads` worker threads, 0
+	// decodes them on the update thread.
+	virtual void SetDecodeThreads(int threads) = 0;
+
+	// Bounds in second of the mixed audio queued on the device, the depth
+	// follows the update jitter and the underruns within them. OpenSL
+	// ignores them, its queue has a fixed depth.
+	virtual void  SetOutputLatency(float min_time, float max_time) = 0;
+	virtual float GetOutputLatency() const = 0;
+
+	// underruns of the streams and of the output queue, lock-free
+	virtual const XrunLog& GetXrunLog() const = 0;
+
+	// memory of the streams, with its occupancy
+	virtual const BufferPool& GetBufferPool() const = 0;
+
+	// submix buses of the streamed voices
+	virtual MixGraph& GetMixGraph() = 0;
+
+	// negotiated with the device when the context is created
+	virtual const OutputFormat& GetOutputFormat() const = 0;
+
 }; // AudioContext
 
 }
@@ -4,6 +4,8 @@
 #include <cu/uncopyable.h>
 #include <cu/cu_stl.h>
 
+#include <memory>
+
 #include <stdint.h>
 
 namespace ua
@@ -14,7 +16,17 @@ class Decoder;
 class AudioData : private cu::Uncopyable
 {
 public:
-	AudioData(const CU_STR& filepath);
+	enum Storage
+	{
+		STORE_PCM = 0,
+		// a quarter of 16 bit PCM, decoded a block at a time when played,
+		// see AdpcmDecoder, IMA ADPCM files are kept as they are
+		STORE_IMA_ADPCM,
+	};
+
+public:
+	AudioData(const CU_STR& filepath, Storage storage = STORE_PCM);
+	// PCM only, IMA ADPCM data is copied from the first
 	AudioData(const CU_VEC<ua::AudioData*>& list);
 	~AudioData();
 
@@ -23,21 +35,37 @@ public:
 
 	int GetSampleRate() const { return m_sample_rate; }
 	int GetChannels() const { return m_channels; }
+	// 4 for IMA ADPCM
 	int GetBitDepth() const { return m_bit_depth; }
 
+	// of the IMA ADPCM blocks, 0 for PCM
+	int GetBlockAlign() const { return m_block_align; }
+	// padding excluded
+	int64_t GetFrames() const;
+
 private:
-	void LoadFromFile(const CU_STR& filepath);
+	void LoadFromFile(const CU_STR& filepath, Storage storage);
 
 	void LoadFromList(const CU_VEC<ua::AudioData*>& list);
 
+	// the 16 bit PCM in m_data to IMA ADPCM
+	void Compress();
+
 private:
 	uint8_t* m_data;
 	int m_size;
 
+	// m_data points into its memory if it has the whole stream as it is,
+	// see Decoder::GetData()
+	std::unique_ptr<Decoder> m_mapped;
+
 	int m_sample_rate;
 	int m_channels;
 	int m_bit_depth;
 
+	int     m_block_align;
+	int64_t m_frames;
+
 }; // AudioData
 
 }
@@ -1,7 +1,10 @@
 #ifndef _UNIAUDIO_AUDIO_MIXER_H_
 #define _UNIAUDIO_AUDIO_MIXER_H_
 
+#include "uniaudio/OutputFormat.h"
+
 #include <cu/uncopyable.h>
+#include <cu/cu_stl.h>
 
 #include <stdint.h>
 #include <string.h>
@@ -9,20 +12,123 @@
 namespace ua
 {
 
+struct MixKernel;
+class Limiter;
+class Resampler;
+class GainRamp;
+
 class AudioMixer : private cu::Uncopyable
 {
 public:
-	AudioMixer(float buf_time_len);
+	enum Bus
+	{
+		// int32 accumulation, hard clipped to int16
+		BUS_INT32 = 0,
+		// float accumulation, with a look-ahead limiter on the master
+		BUS_FLOAT32,
+	};
+
+	// mixes `frames` bus frames from `first`, `repeat` bus frames per
+	// source frame
+	typedef void (*MixFunc)(const MixKernel& k, void* bus, const uint8_t* src, int first, int frames,
+		int repeat, float gain, float step);
+
+	// in place on `frames` interleaved stereo frames of the float bus
+	typedef void (*Effect)(float* buf, int frames, void* ud);
+
+	// A source format resolved against the mixer, once per voice.
+	struct Voice
+	{
+		// null if the source needs a Resampler
+		MixFunc func;
+		int     repeat;
+
+		int     sample_rate;
+		int     bit_depth;
+		// bytes per source frame
+		int     frame_size;
+		// to the bus range
+		float   scale;
+
+		Voice() : func(nullptr), repeat(0), sample_rate(0), bit_depth(0), frame_size(0), scale(0) {}
+
+		bool IsResolved() const { return frame_size != 0; }
+		bool IsValid() const { return func != nullptr; }
+	};
+
+	// The voices of one block as parallel arrays, filled by the pool and
+	// mixed in one pass by Input(const Batch&).
+	struct Batch
+	{
+		// direct voices
+		CU_VEC<const uint8_t*> bufs;
+		CU_VEC<int>            frames;
+		CU_VEC<const Voice*>   voices;
+		// resampled voices, null for the direct ones
+		CU_VEC<Resampler*>     resamplers;
+
+		CU_VEC<GainRamp*>      ramps;
+		// -1 left, 1 right
+		CU_VEC<float>          pans;
+
+		// `frames` source frames
+		void Add(const uint8_t* buf, int frames, const Voice& voice, GainRamp& ramp, float pan);
+		void Add(Resampler& resampler, GainRamp& ramp, float pan);
+		// voice `i` of `batch`
+		void Add(const Batch& batch, int i);
+
+		void Clear();
+
+		int Size() const { return static_cast<int>(ramps.size()); }
+		bool Empty() const { return ramps.empty(); }
+
+		// of voice `i`, relative to the others
+		int GetCost(int i) const;
+	};
+
+public:
+	AudioMixer(float buf_time_len, Bus bus = BUS_INT32);
+	// zero fields of `fmt` are filled with the defaults
+	AudioMixer(float buf_time_len, const OutputFormat& fmt, Bus bus = BUS_INT32);
 	~AudioMixer();
 
 	void Input(const uint8_t* buf, int buf_sz, int sample_rate, int bit_depth, int channel, float volume);
-	int16_t* Output();
+	// gain interpolated per frame, `ramp` moves by the frames mixed
+	void Input(const uint8_t* buf, int buf_sz, int sample_rate, int bit_depth, int channel, GainRamp& ramp);
+	// `voice` from GetVoice(), skips the format dispatch
+	void Input(const uint8_t* buf, int buf_sz, const Voice& voice, GainRamp& ramp);
+	// renders as many frames as the resampler has input for
+	void Input(Resampler& resampler, float volume);
+	void Input(Resampler& resampler, GainRamp& ramp);
+	void Input(const Batch& batch);
+	// adds the frames mixed into `mixer`, same format and bus
+	void Merge(const AudioMixer& mixer);
+	// same with a gain, `ramp` moves by a whole block
+	void Merge(const AudioMixer& mixer, GainRamp& ramp);
+	// over the whole block, which counts as mixed after, no-op on the
+	// int32 bus
+	void ApplyEffect(Effect effect, void* ud);
+	// GetBufSize() bytes in the format of GetFormat()
+	void* Output();
+	// the last Output() is all zeros
+	bool IsSilent() const { return m_out_begin >= m_out_end; }
 
 	int GetSamples() const { return m_samples; }
-	int GetBufSize() const { return sizeof(int16_t) * DEFAULT_CHANNELS * m_samples; }
+	int GetBufSize() const { return m_format.GetFrameSize() * m_samples; }
+
+	const OutputFormat& GetFormat() const { return m_format; }
+	Bus GetBus() const { return m_bus; }
 
+	// Invalid if the rate is not a divisor of the mixer's, those go
+	// through a Resampler. The format fields are set anyway.
+	Voice GetVoice(int sample_rate, int bit_depth, int channel) const;
+
+	// clears only the frames mixed since the last call
 	void Reset();
 
+	// Defaults to MixKernel::Get(), MixKernel::Scalar() is for comparison.
+	void SetKernel(const MixKernel& kernel) { m_kernel = &kernel; }
+
 public:
 	// Indicates the quality of the sound.
 	static const int DEFAULT_SAMPLE_RATE = 44100;
@@ -33,16 +139,56 @@ public:
 	static const int DEFAULT_BIT_DEPTH = 16;
 
 private:
-	void MixFast(const uint8_t* buf, int buf_sz, int sample_rate, int bit_depth, int channel, float volume);
-	void MixSlow(const uint8_t* buf, int buf_sz, int sample_rate, int bit_depth, int channel, float volume);
+	void Init(float buf_time_len);
+
+	// return the bus frames mixed into `bus`
+	int MixVoice(const uint8_t* buf, int frames, const Voice& voice, GainRamp& ramp, void* bus);
+	int MixResampler(Resampler& resampler, GainRamp& ramp, void* bus);
+
+	void* GetBusBuffer();
+
+	void MarkDirty(int begin, int end);
+	// zeros the frames of m_out_buffer written before but not in [begin, end)
+	void ClearOutput(int begin, int end);
 
 private:
+	// the bus is always stereo, folded at output for mono devices
+	static const int BUS_CHANNELS = 2;
+
+	// the mix buffers start on a cache line, partial buses of a parallel
+	// mix do not share lines
+	static const int CACHE_LINE = 64;
+
+private:
+	const MixKernel* m_kernel;
+
+	OutputFormat m_format;
+	const Bus m_bus;
+
 	int32_t* m_mix_buffer;
-	int16_t* m_out_buffer;
+	uint8_t* m_out_buffer;
+	// stereo output before folding, if m_format is mono
+	uint8_t* m_stage_buffer;
+
+	// Limiter::LOOKAHEAD delayed frames, then m_samples frames to mix in
+	float*   m_mix_buffer_f;
+	Limiter* m_limiter;
+
+	// resampler output on the int32 bus
+	float*   m_resample_buffer;
+
+	// a panned voice before its balance, float or int32 like the bus
+	void*    m_pan_buffer;
 
 	int m_samples;
 
-	bool m_dirty;
+	// frames [m_dirty_begin, m_dirty_end) received input since Reset()
+	int m_dirty_begin, m_dirty_end;
+	// the delayed frames are not silent
+	bool m_tail_dirty;
+
+	// frames [m_out_begin, m_out_end) of m_out_buffer may not be zero
+	int m_out_begin, m_out_end;
 
 }; // AudioMixer
 
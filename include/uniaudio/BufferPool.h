@@ -0,0 +1,79 @@
+#ifndef _UNIAUDIO_BUFFER_POOL_H_
+#define _UNIAUDIO_BUFFER_POOL_H_
+
+#include <cu/uncopyable.h>
+
+#include <mutex>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ua
+{
+
+/**
+ * Memory of the stream buffers of a context, carved from one slab.
+ *
+ * Blocks come in power of two size classes from MIN_BLOCK to MAX_BLOCK. A
+ * freed block goes to the free list of its class and is reused, once the
+ * streams have warmed up nothing is allocated from the heap. Larger
+ * requests, or those past the end of the slab, fall back to malloc() and
+ * are counted as overflow.
+ **/
+class BufferPool : private cu::Uncopyable
+{
+public:
+	BufferPool(size_t slab_size = DEFAULT_SLAB_SIZE);
+	~BufferPool();
+
+	// CACHE_LINE aligned
+	void* Alloc(size_t size);
+	// `size` as passed to Alloc()
+	void  Free(void* ptr, size_t size);
+
+	// occupancy, in bytes
+	size_t GetCapacity() const;
+	// ever carved from the slab, in use or on a free list
+	size_t GetCarved() const;
+	// in the blocks of the slab in use, whole classes
+	size_t GetUsed() const;
+	// in use outside the slab
+	size_t GetOverflow() const;
+
+public:
+	static const size_t DEFAULT_SLAB_SIZE = 1 << 20;
+
+	static const size_t MIN_BLOCK = 1 << 12;
+	static const size_t MAX_BLOCK = 1 << 18;
+
+	static const int CACHE_LINE = 64;
+
+private:
+	// -1 if over MAX_BLOCK
+	static int GetClass(size_t size);
+
+	bool IsInSlab(const void* ptr) const;
+
+private:
+	static const int CLASS_COUNT = 7;
+
+private:
+	mutable std::mutex m_mutex;
+
+	uint8_t* m_mem;
+	// m_mem aligned
+	uint8_t* m_slab;
+	size_t   m_capacity;
+	size_t   m_carved;
+
+	// the link is in the first bytes of each free block
+	void* m_free[CLASS_COUNT];
+
+	size_t m_used;
+	size_t m_overflow;
+
+}; // BufferPool
+
+}
+
+#endif // _UNIAUDIO_BUFFER_POOL_H_
\ No newline at end of file
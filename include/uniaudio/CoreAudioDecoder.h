@@ -24,7 +24,8 @@ public:
 
 	virtual Decoder* Clone();
 
-	virtual int Decode() final;
+	virtual int Decode(unsigned char* dst, int size) final;
+	using Decoder::Decode;
 
 	virtual bool Seek(float s) final;
 	virtual bool Rewind() final;
@@ -44,11 +45,13 @@ private:
 public:
 	struct Data
 	{
-		Data() : file(nullptr), size(0) {}
+		Data() : file(nullptr), size(0), decoder(nullptr) {}
 		~Data() { if (file) fs_close(file); }
 
 		fs_file* file;
 		size_t size;
+
+		Decoder* decoder;
 	};
 
 private:
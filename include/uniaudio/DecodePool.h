@@ -0,0 +1,92 @@
+#ifndef _UNIAUDIO_DECODE_POOL_H_
+#define _UNIAUDIO_DECODE_POOL_H_
+
+#include <cu/uncopyable.h>
+#include <cu/cu_stl.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#include <stdint.h>
+
+namespace ua
+{
+
+class InputBuffer;
+class OutputBuffer;
+
+/**
+ * Worker threads that keep the output rings of the mixed streams full, so
+ * a slow decode or file read only holds up its own worker.
+ *
+ * A stream stays on the worker with the fewest streams when it was added.
+ * A worker decodes one slot at a time for whichever of its streams has
+ * the least audio buffered, until every ring is full, then sleeps for
+ * `period` seconds or until Wakeup(). Under load the streams closest to
+ * an underrun are served first, the others run lower.
+ **/
+class DecodePool : private cu::Uncopyable
+{
+public:
+	DecodePool(int threads, float period);
+	~DecodePool();
+
+	void Add(InputBuffer* ibuf, OutputBuffer* obuf);
+	// `ibuf` is not decoded again, does not wait for a decode in flight
+	void Remove(InputBuffer* ibuf);
+	// a worker is decoding `ibuf`, it can not be deleted yet
+	bool IsBusy(const InputBuffer* ibuf);
+
+	// after a seek or a new stream
+	void Wakeup();
+
+	int GetThreads() const { return static_cast<int>(m_threads.size()); }
+
+private:
+	void WorkerLoop(int id);
+
+private:
+	struct Stream
+	{
+		uint32_t      id;
+		InputBuffer*  ibuf;
+		OutputBuffer* obuf;
+		// of ibuf, the headroom is read from obuf without its lock
+		int           bytes_per_sec;
+		int           worker;
+	};
+
+	// a stream waiting for its next slot
+	struct Urgent
+	{
+		uint32_t id;
+		// seconds buffered
+		float    headroom;
+	};
+
+	const Stream* Find(uint32_t id) const;
+
+private:
+	const float m_period;
+
+	std::vector<std::thread> m_threads;
+
+	// below are guarded by m_mutex
+	std::mutex m_mutex;
+	std::condition_variable m_start_cond;
+	CU_VEC<Stream> m_streams;
+	// streams per worker
+	CU_VEC<int> m_loads;
+	// stream each worker is decoding
+	CU_VEC<InputBuffer*> m_busy;
+	uint32_t m_next_id;
+	uint32_t m_generation;
+	bool     m_quit;
+
+}; // DecodePool
+
+}
+
+#endif // _UNIAUDIO_DECODE_POOL_H_
\ No newline at end of file
@@ -3,7 +3,10 @@
 
 #include <cu/uncopyable.h>
 
+#include <atomic>
+
 #include <stddef.h>
+#include <stdint.h>
 
 namespace ua
 {
@@ -38,9 +41,27 @@ public:
 
 	virtual Decoder* Clone() = 0;
 
-	virtual int Decode() = 0;
+	// Decodes at most `size` bytes into `dst`, whole frames, return the
+	// bytes written.
+	virtual int Decode(unsigned char* dst, int size) = 0;
+	// GetBufferSize() bytes into GetBuffer(), which is only allocated by
+	// the first call
+	int Decode();
+
+	// Points `buf` at the next at most `size` bytes, whole frames, and
+	// moves past them without copying, return the bytes, or -1 if the
+	// decoded audio is not in memory as it is.
+	virtual int Map(const unsigned char*& buf, int size);
+	// the whole decoded stream if it is in memory as it is, its bytes in
+	// `size`, nullptr if not
+	virtual const unsigned char* GetData(size_t& size) const;
+	// the whole stream if it is in memory as IMA ADPCM blocks, see
+	// ImaAdpcm, nullptr if not
+	virtual const unsigned char* GetAdpcmData(size_t& size, int& block_align, int64_t& frames) const;
 
 	virtual bool Seek(float s) = 0;
+	// sample exact where the format allows, Seek() otherwise
+	virtual bool SeekFrame(int64_t frame);
 	virtual bool Rewind() = 0;
 
 	virtual int GetChannels() const = 0;
@@ -50,12 +71,29 @@ public:
 	virtual float GetDuration() const  = 0;
 
 	const unsigned char* GetBuffer() const { return m_buf; }
+	// also the size to decode at a time
 	int GetBufferSize() const { return m_buf_size; }
 
 	int GetSampleRate() const { return m_sample_rate; }
 
 	bool IsFinished() const { return m_eof; }
 
+	// spent in file reads, steady clock nanoseconds, read from any thread
+	int64_t GetIoTime() const { return m_io_time.load(std::memory_order_relaxed); }
+
+	// Adds the time of a file read of `decoder` to its GetIoTime(), for
+	// the reader callbacks.
+	class IoTimer
+	{
+	public:
+		IoTimer(Decoder* decoder);
+		~IoTimer();
+
+	private:
+		Decoder* m_decoder;
+		int64_t  m_begin;
+	};
+
 protected:
 	unsigned char* m_buf;
 	int m_buf_size;
@@ -68,6 +106,8 @@ protected:
 
 	int m_length;
 
+	std::atomic<int64_t> m_io_time;
+
 }; // Decoder
 
 }
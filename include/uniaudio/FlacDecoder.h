@@ -0,0 +1,98 @@
+#ifdef UA_SUPPORT_FLAC
+
+#ifndef _UNIAUDIO_FLAC_DECODER_H_
+#define _UNIAUDIO_FLAC_DECODER_H_
+
+#include <cu/cu_stl.h>
+
+#include "uniaudio/Decoder.h"
+
+#include <FLAC/stream_decoder.h>
+
+#include <memory>
+
+namespace ua
+{
+
+// FLAC, mono or stereo of any depth, read from a MappedFile with libFLAC.
+// Each frame is converted straight into the caller's buffer, deeper
+// samples are reduced to 16 bit by MixKernel::pack_s16.
+class FlacDecoder : public Decoder
+{
+public:
+	FlacDecoder(const std::string& filepath, int buf_sz);
+	FlacDecoder(const FlacDecoder&);
+	virtual ~FlacDecoder();
+
+	virtual Decoder* Clone() override;
+
+	virtual int Decode(unsigned char* dst, int size) override final;
+	using Decoder::Decode;
+
+	virtual bool Seek(float s) override final;
+	// from the nearest seek point before, libFLAC's search without a
+	// seek table
+	virtual bool SeekFrame(int64_t frame) override final;
+	virtual bool Rewind() override final;
+
+	virtual int GetChannels() const override final;
+	virtual int GetBitDepth() const override final;
+
+	virtual float GetDuration() const override final;
+
+	static bool Accepts(const CU_STR& ext);
+
+public:
+	// the file and its metadata, shared
+	struct Stream;
+
+private:
+	void Init();
+
+	// m_pending into m_dst
+	void Drain();
+
+	// decodes from `pos` in the file, `target` is the frame to start at,
+	// -1 for the next one
+	void Restart(size_t pos, int64_t target);
+
+	static FLAC__StreamDecoderReadStatus ReadCallback(const FLAC__StreamDecoder* decoder,
+		FLAC__byte buffer[], size_t* bytes, void* client_data);
+	static FLAC__StreamDecoderSeekStatus SeekCallback(const FLAC__StreamDecoder* decoder,
+		FLAC__uint64 absolute_byte_offset, void* client_data);
+	static FLAC__StreamDecoderTellStatus TellCallback(const FLAC__StreamDecoder* decoder,
+		FLAC__uint64* absolute_byte_offset, void* client_data);
+	static FLAC__StreamDecoderLengthStatus LengthCallback(const FLAC__StreamDecoder* decoder,
+		FLAC__uint64* stream_length, void* client_data);
+	static FLAC__bool EofCallback(const FLAC__StreamDecoder* decoder, void* client_data);
+	static FLAC__StreamDecoderWriteStatus WriteCallback(const FLAC__StreamDecoder* decoder,
+		const FLAC__Frame* frame, const FLAC__int32* const buffer[], void* client_data);
+	static void ErrorCallback(const FLAC__StreamDecoder* decoder,
+		FLAC__StreamDecoderErrorStatus status, void* client_data);
+
+private:
+	std::shared_ptr<Stream> m_stream;
+
+	FLAC__StreamDecoder* m_handle;
+
+	// in the file, of the next read
+	size_t m_pos;
+
+	// of the running Decode(), in frames
+	int16_t* m_dst;
+	int      m_room;
+
+	// the rest of a frame that did not fit, interleaved
+	CU_VEC<int16_t> m_pending;
+	size_t m_pending_read;
+
+	// the first frame to output after a seek, -1 if none
+	int64_t m_target;
+
+}; // FlacDecoder
+
+}
+
+#endif // _UNIAUDIO_FLAC_DECODER_H_
+
+#endif // UA_SUPPORT_FLAC
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef _UNIAUDIO_GAIN_RAMP_H_
+#define _UNIAUDIO_GAIN_RAMP_H_
+
+#include <stdint.h>
+
+namespace ua
+{
+
+/**
+ * Per voice gain, interpolated sample by sample by the mixer.
+ *
+ * Volume changes ramp over RAMP_TIME instead of stepping at block edges.
+ * Fades are windows over the voice's position, counted in mixer frames
+ * from the start of play. The update thread only sets targets, the mixer
+ * walks the envelope with Next().
+ **/
+class GainRamp
+{
+public:
+	GainRamp();
+
+	// mixer rate, the times below are converted with it
+	void SetSampleRate(int sample_rate);
+
+	// back to position 0, the volume jumps to `volume`
+	void Start(float volume);
+	// in second from the start of play
+	void Seek(float pos);
+
+	// linear ramp to `volume` over `time` second
+	void SetVolume(float volume, float time = RAMP_TIME);
+
+	// from 0 over the first `time` second
+	void SetFadeIn(float time);
+	// to 0 over the `time` second before `end`, no fade-out if `end` <= 0
+	void SetFadeOut(float end, float time);
+
+	// Gain of the next frame and the per frame step, for a segment of at
+	// most `frames` frames. Return the segment length and move past it.
+	int Next(int frames, float& gain, float& step);
+
+	// gain of the next frame
+	float GetGain() const;
+
+	int64_t GetPosition() const { return m_pos; }
+
+public:
+	// 5ms, below the length of one mix block
+	static const float RAMP_TIME;
+
+private:
+	float Envelope(int64_t pos) const;
+
+	void UpdateFrames();
+
+private:
+	int m_sample_rate;
+
+	// volume ramp
+	float m_volume, m_target, m_step;
+	int   m_remain;
+
+	// in second, kept to convert again if the rate changes
+	float m_fade_in_time;
+	float m_fade_out_end_time, m_fade_out_time;
+
+	// in frames
+	int64_t m_fade_in;
+	int64_t m_fade_out_end, m_fade_out;
+
+	int64_t m_pos;
+
+}; // GainRamp
+
+}
+
+#endif // _UNIAUDIO_GAIN_RAMP_H_
\ No newline at end of file
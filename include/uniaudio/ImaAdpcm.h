@@ -0,0 +1,61 @@
+#ifndef _UNIAUDIO_IMA_ADPCM_H_
+#define _UNIAUDIO_IMA_ADPCM_H_
+
+#include <cu/cu_stl.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ua
+{
+
+// IMA ADPCM laid out as WAVE_FORMAT_IMA_ADPCM: blocks of a 4 byte header
+// per channel, the first sample and the step index, then 4 byte words of
+// 8 samples of each channel in turn, 4 bits a sample. Blocks decode on
+// their own, the whole ones with MixKernel::decode_ima.
+class ImaAdpcm
+{
+public:
+	// `frames` of the `blocks` are played, the rest is padding
+	ImaAdpcm(const uint8_t* blocks, int64_t frames, int channels, int block_align);
+
+	// frames [frame, frame + count) to interleaved 16 bit, the partial
+	// blocks through a cached one
+	void Decode(int16_t* dst, int64_t frame, int count);
+
+	int64_t GetFrames() const { return m_frames; }
+
+	// one channel or two, a header and at least a word each
+	static bool IsValid(int channels, int block_align);
+	static int  GetBlockFrames(int block_align, int channels);
+
+	// the bytes Encode() writes for `frames`, whole blocks
+	static size_t GetEncodedSize(int64_t frames, int channels, int block_align);
+	// from interleaved 16 bit, the last block is padded with silence
+	static void   Encode(uint8_t* dst, const int16_t* src, int64_t frames, int channels, int block_align);
+
+public:
+	// of the blocks Encode() writes, per channel, 1017 frames a block
+	static const int BLOCK_ALIGN = 512;
+
+	static const int     MAX_INDEX = 88;
+	static const int32_t STEP_TABLE[MAX_INDEX + 1];
+	static const int     INDEX_TABLE[16];
+
+private:
+	const uint8_t* m_blocks;
+	int64_t m_frames;
+
+	int m_channels;
+	int m_block_align;
+	int m_block_frames;
+
+	// block m_cached decoded
+	CU_VEC<int16_t> m_block;
+	int64_t m_cached;
+
+}; // ImaAdpcm
+
+}
+
+#endif // _UNIAUDIO_IMA_ADPCM_H_
\ No newline at end of file
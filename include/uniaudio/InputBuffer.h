@@ -1,7 +1,15 @@
 #ifndef _UNIAUDIO_INPUT_BUFFER_H_
 #define _UNIAUDIO_INPUT_BUFFER_H_
 
+#include "uniaudio/XrunLog.h"
+
+#include <cu/cu_stl.h>
+
+#include <atomic>
 #include <memory>
+#include <mutex>
+
+#include <stdint.h>
 
 namespace ua
 {
@@ -9,12 +17,37 @@ namespace ua
 class Decoder;
 class OutputBuffer;
 
+// The decoding side of a stream, safe to call from the update thread and
+// a DecodePool worker at the same time.
 class InputBuffer
 {
 public:
 	InputBuffer(std::unique_ptr<Decoder>& decoder);
 
-	void Output(OutputBuffer* out, bool looping);
+	// fills the free slots of `out`
+	void Output(OutputBuffer* out);
+	// stops after the slot that reaches `max_sz` bytes, return the bytes
+	int  Output(OutputBuffer* out, int max_sz);
+
+	// of the decoded audio, fixed for the decoder
+	int GetBytesPerSec() const;
+
+	// why the consumer found nothing decoded now, lock-free: a decode
+	// running or slower than real time is late, on file reads if those
+	// took most of it, else the refill had not come yet
+	XrunCause GetStallCause() const;
+
+	// at most GetDecoder()->GetBufferSize() bytes into `buf`, which is
+	// valid until the next call, return the bytes, zero-copy from the
+	// decoder's memory where it can, see Decoder::Map()
+	int  Decode(const unsigned char*& buf);
+
+	// rewinds at the end of the stream, the first LOOP_HEAD_TIME is
+	// replayed from memory while the decoder seeks past it
+	void SetLooping(bool looping);
+	// in frames, after the intro [0, begin) the loop plays [begin, end),
+	// an `end` of 0 is the end of the stream
+	void SetLoopRegion(int64_t begin, int64_t end);
 
 	bool IsDecoderFinished() const;
 	void DecoderRewind();
@@ -22,22 +55,66 @@ public:
 	const std::unique_ptr<Decoder>& GetDecoder() const { return m_decoder; }
 	std::unique_ptr<Decoder>& GetDecoder() { return m_decoder; }
 
-	void Seek(float offset, bool looping);
+	void Seek(float offset);
 
-	// return second
+	// of the decoded frames, in second
 	float GetOffset() const;
 
 	void Rewind();
 
+public:
+	// in second
+	static const float LOOP_HEAD_TIME;
+
 private:
-	void Reload(bool looping);
+	// the loop applied, with m_mutex locked
+	int  Read(unsigned char* dst, int size);
+	// Read() without the copy, -1 if the decoder can not
+	int  Map(const unsigned char*& buf, int size);
+
+	void CaptureHead(const unsigned char* buf, int size);
+	bool IsLoopEnd() const;
+	// after a seek
+	void MoveTo(int64_t frame);
+	// the seek left by the last pass, at the start of the next
+	void ApplySeek();
+
+	int GetFrameSize() const;
+
+	// around the decoding of Output() and Decode()
+	void BeginBusy();
+	void EndBusy(int bytes);
 
 private:
+	mutable std::mutex m_mutex;
+
 	std::unique_ptr<Decoder> m_decoder;
 
-	int m_size, m_used;
+	// in the stream, of the next frame to read
+	int64_t m_frame;
+
+	bool m_looping;
+	int64_t m_loop_begin, m_loop_end;
+
+	// the first frames of the loop, decoded once
+	CU_VEC<unsigned char> m_head;
+	bool   m_head_done;
+	// no decoding left in the loop
+	bool   m_head_whole;
+	// m_head.size() if not replaying
+	size_t m_head_read;
+
+	// where the decoder goes on the next pass, after the loop start it
+	// played from memory, -1 if none
+	int64_t m_seek_frame;
+
+	CU_VEC<unsigned char> m_scratch;
 
-	float m_offset;
+	// steady clock ns, when the running decode began, 0 if none, and the
+	// decoder's io time then
+	std::atomic<int64_t> m_busy_since, m_busy_io;
+	// the last decode, its time, io time and length of audio, in ns
+	std::atomic<int64_t> m_last_wall, m_last_io, m_last_audio;
 
 }; // InputBuffer
 
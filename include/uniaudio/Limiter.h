@@ -0,0 +1,64 @@
+#ifndef _UNIAUDIO_LIMITER_H_
+#define _UNIAUDIO_LIMITER_H_
+
+#include <cu/uncopyable.h>
+
+#include <stdint.h>
+
+namespace ua
+{
+
+struct MixKernel;
+
+/**
+ * Look-ahead peak limiter for the float mix bus.
+ *
+ * The input is delayed by LOOKAHEAD frames, so the gain can ramp down
+ * before a peak arrives instead of clipping it.
+ **/
+class Limiter : private cu::Uncopyable
+{
+public:
+	Limiter(int channels, int sample_rate);
+
+	// `buf` holds LOOKAHEAD delayed frames followed by `frames` new ones,
+	// the oldest `frames` are written to `dst` and the newest LOOKAHEAD
+	// are moved to the head of `buf` for the next call.
+	void Process(int16_t* dst, float* buf, int frames, const MixKernel& kernel);
+	// same, to float output
+	void Process(float* dst, float* buf, int frames, const MixKernel& kernel);
+
+	// after silence
+	void Reset();
+
+	float GetGain() const { return m_gain; }
+
+public:
+	// 64 frames, ~1.5ms at 44.1kHz.
+	static const int LOOKAHEAD = 64;
+
+	static const float THRESHOLD;
+
+	// in second
+	static const float RELEASE_TIME;
+
+private:
+	template <typename T>
+	void ProcessImpl(T* dst, float* buf, int frames, const MixKernel& kernel);
+
+private:
+	int m_channels;
+
+	// per LOOKAHEAD frames
+	float m_release;
+
+	float m_gain;
+
+	// peak of the delayed frames
+	float m_peak;
+
+}; // Limiter
+
+}
+
+#endif // _UNIAUDIO_LIMITER_H_
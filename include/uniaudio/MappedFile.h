@@ -0,0 +1,53 @@
+#ifndef _UNIAUDIO_MAPPED_FILE_H_
+#define _UNIAUDIO_MAPPED_FILE_H_
+
+#include <cu/uncopyable.h>
+#include <cu/cu_stl.h>
+
+#include <stddef.h>
+
+namespace ua
+{
+
+/**
+ * A whole file in memory, read only.
+ *
+ * Mapped by the OS where it can be, pages are read on first touch and
+ * shared by every decoder of the file. Files the OS can not map, such as
+ * those packed in an archive, are read through fs_file instead.
+ **/
+class MappedFile : private cu::Uncopyable
+{
+public:
+	MappedFile(const CU_STR& filepath);
+	~MappedFile();
+
+	// nullptr if the file could not be opened
+	const unsigned char* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+	// false if read into the heap
+	bool IsMapped() const { return m_mapped; }
+
+private:
+	bool Map(const CU_STR& filepath);
+	void Unmap();
+
+	bool Load(const CU_STR& filepath);
+
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+
+	bool m_mapped;
+
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#endif // _WIN32
+
+}; // MappedFile
+
+}
+
+#endif // _UNIAUDIO_MAPPED_FILE_H_
\ No newline at end of file
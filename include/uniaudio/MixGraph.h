@@ -0,0 +1,99 @@
+#ifndef _UNIAUDIO_MIX_GRAPH_H_
+#define _UNIAUDIO_MIX_GRAPH_H_
+
+#include "uniaudio/AudioMixer.h"
+#include "uniaudio/ParallelMixer.h"
+#include "uniaudio/GainRamp.h"
+
+#include <cu/uncopyable.h>
+#include <cu/cu_stl.h>
+
+#include <mutex>
+
+namespace ua
+{
+
+/**
+ * Submix buses between the voices and the pool's mixer.
+ *
+ * Each bus (music, sfx, ...) has its own accumulation buffer, gain and
+ * effect chain, and sends to one or more output buses, the outputs form
+ * a DAG ending at MASTER, which is the pool's mixer. Every block the
+ * buses are evaluated inputs first, a bus without voices nor active
+ * inputs is skipped.
+ *
+ * The config functions can be called from any thread.
+ **/
+class MixGraph : private cu::Uncopyable
+{
+public:
+	MixGraph(float buf_time_len, const OutputFormat& fmt, AudioMixer::Bus bus);
+	~MixGraph();
+
+	// Return the new bus' id, throws if `name` is taken or `output` does
+	// not exist.
+	int  AddBus(const CU_STR& name, int output = MASTER);
+	// also sends `bus` to `output`, throws if it makes a cycle
+	void AddOutput(int bus, int output);
+	// -1 if not found
+	int  GetBus(const CU_STR& name) const;
+
+	// ramps over GainRamp::RAMP_TIME, the master's is the context volume
+	void SetVolume(int bus, float volume);
+	// appended to the chain of `bus`, only run on the float mix bus
+	void AddEffect(int bus, AudioMixer::Effect effect, void* ud);
+
+	// A block, voices are added to the batch of their bus, unknown buses
+	// go to the master. Mix() consumes the batches, on `parallel` if not
+	// null.
+	AudioMixer::Batch& GetBatch(int bus);
+	void Mix(AudioMixer& master, ParallelMixer* parallel);
+
+public:
+	static const int MASTER = 0;
+
+private:
+	bool IsReachable(int from, int to) const;
+
+	void UpdateOrder();
+
+private:
+	struct Effect
+	{
+		AudioMixer::Effect func;
+		void* ud;
+	};
+
+	struct Node
+	{
+		CU_STR name;
+
+		// nullptr for MASTER
+		AudioMixer* mixer;
+		GainRamp    ramp;
+
+		CU_VEC<int>    outputs;
+		CU_VEC<Effect> effects;
+
+		AudioMixer::Batch batch;
+		// has input this block
+		bool active;
+	};
+
+private:
+	const float        m_buf_time_len;
+	const OutputFormat m_format;
+	const AudioMixer::Bus m_bus;
+
+	mutable std::mutex m_mutex;
+
+	CU_VEC<Node*> m_nodes;
+
+	// inputs before their outputs, MASTER last
+	CU_VEC<int> m_order;
+
+}; // MixGraph
+
+}
+
+#endif // _UNIAUDIO_MIX_GRAPH_H_
@@ -0,0 +1,98 @@
+#ifndef _UNIAUDIO_MIX_KERNEL_H_
+#define _UNIAUDIO_MIX_KERNEL_H_
+
+#include <stdint.h>
+
+namespace ua
+{
+
+/**
+ * Inner loops of the AudioMixer, one table per instruction set.
+ *
+ * All the mix functions accumulate into an interleaved stereo bus,
+ * dst[i] += src[i] * (gain + step * f) for frame f, mono sources are
+ * written to both channels.
+ * The int32 bus truncates each product. Every table gives bit-exact
+ * results to the scalar one, except resample_f32 which sums the taps in
+ * a different order.
+ **/
+struct MixKernel
+{
+	// polyphase filter state, see Resampler
+	struct Resample
+	{
+		// planar, `stride` floats per channel
+		const float* src;
+		int stride;
+		int channels;
+
+		// (1 << (32 - phase_shift)) rows of `taps` coefficients
+		const float* table;
+		int taps;
+		int phase_shift;
+
+		// 32.32 fixed point, the integer part is the first tap's index
+		uint64_t pos;
+		uint64_t step;
+	};
+
+	const char* name;
+
+	void (*mix_s8_mono)(int32_t* dst, const int8_t* src, int frames, float gain, float step);
+	void (*mix_s8_stereo)(int32_t* dst, const int8_t* src, int frames, float gain, float step);
+	void (*mix_s16_mono)(int32_t* dst, const int16_t* src, int frames, float gain, float step);
+	void (*mix_s16_stereo)(int32_t* dst, const int16_t* src, int frames, float gain, float step);
+
+	void (*mix_s8_mono_f32)(float* dst, const int8_t* src, int frames, float gain, float step);
+	void (*mix_s8_stereo_f32)(float* dst, const int8_t* src, int frames, float gain, float step);
+	void (*mix_s16_mono_f32)(float* dst, const int16_t* src, int frames, float gain, float step);
+	void (*mix_s16_stereo_f32)(float* dst, const int16_t* src, int frames, float gain, float step);
+
+	// saturating int32 to int16
+	void (*clamp_s16)(int16_t* dst, const int32_t* src, int count);
+
+	// max of |src[i]|
+	float (*peak_f32)(const float* src, int count);
+
+	// Gain ramp and conversion in one pass, for frame f of the interleaved
+	// src: dst = saturate((int32_t)(src * (gain + step * f))).
+	void (*ramp_s16)(int16_t* dst, const float* src, int frames, int channels, float gain, float step);
+	// same for float output, saturated to [-1, 1]
+	void (*ramp_f32)(float* dst, const float* src, int frames, int channels, float gain, float step);
+
+	// Filters `frames` output frames from a mono or stereo planar source
+	// and accumulates them into the float bus.
+	void (*resample_f32)(float* dst, int frames, float gain, float step, const Resample& r);
+
+	// dst[i] += src[i], sums the partial buses of a parallel mix
+	void (*add_s32)(int32_t* dst, const int32_t* src, int count);
+	void (*add_f32)(float* dst, const float* src, int count);
+	// dst += src * (gain + step * f) on the stereo float bus, for submixes
+	void (*add_ramp_f32)(float* dst, const float* src, int frames, float gain, float step);
+
+	// Planar int32 to interleaved int16 for the decoders of deeper
+	// samples, dst = src[c][f] >> shift, mono or stereo, `shift` is 0 to 16
+	// and the results fit.
+	void (*pack_s16)(int16_t* dst, const int32_t* const* src, int frames, int channels, int shift);
+
+	// Whole IMA ADPCM blocks to interleaved int16, mono or stereo, see
+	// ImaAdpcm. The vector tables decode a channel of a block per lane.
+	void (*decode_ima)(int16_t* dst, const uint8_t* src, int blocks, int block_align, int channels);
+
+	// The best table for the running cpu, resolved once.
+	// Define UA_MIX_SCALAR to always get the scalar one.
+	static const MixKernel& Get();
+
+	// Reference implementation.
+	static const MixKernel& Scalar();
+
+	// nullptr if not built for this target or not supported by the cpu.
+	static const MixKernel* SSE2();
+	static const MixKernel* AVX2();
+	static const MixKernel* NEON();
+
+}; // MixKernel
+
+}
+
+#endif // _UNIAUDIO_MIX_KERNEL_H_
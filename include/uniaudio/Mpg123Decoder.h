@@ -23,9 +23,11 @@ public:
 
 	virtual Decoder* Clone();
 
-	virtual int Decode() override final;
+	virtual int Decode(unsigned char* dst, int size) override final;
+	using Decoder::Decode;
 
 	virtual bool Seek(float s) override final;
+	virtual bool SeekFrame(int64_t frame) override final;
 	virtual bool Rewind() override final;
 
 	virtual int GetChannels() const override final;
@@ -37,6 +39,16 @@ public:
 
 	static void Quit();
 
+public:
+	// the handle of the reader callbacks
+	struct Reader
+	{
+		Reader() : file(nullptr), decoder(nullptr) {}
+
+		fs_file* file;
+		Decoder* decoder;
+	};
+
 private:
 	void InitHandle();
 	void InitMpg123();
@@ -44,6 +56,7 @@ private:
 private:
 	std::string m_filepath;
 	fs_file*    m_file;
+	Reader      m_reader;
 
 	mpg123_handle* m_handle;
 
@@ -0,0 +1,69 @@
+#if defined(UA_SUPPORT_VORBIS) || defined(UA_SUPPORT_OPUS)
+
+#ifndef _UNIAUDIO_OGG_PAGES_H_
+#define _UNIAUDIO_OGG_PAGES_H_
+
+#include "uniaudio/MappedFile.h"
+
+#include <cu/uncopyable.h>
+#include <cu/cu_stl.h>
+
+#include <ogg/ogg.h>
+
+#include <functional>
+#include <mutex>
+
+#include <stdint.h>
+
+namespace ua
+{
+
+/**
+ * The pages of an Ogg file, read in place from a MappedFile.
+ *
+ * Shared by the clones of a decoder, the index of the granule positions
+ * is built once at the first seek.
+ **/
+class OggPages : private cu::Uncopyable
+{
+public:
+	// of the pages a packet ends on
+	struct Page
+	{
+		// in the file, after the page
+		size_t  end;
+		int64_t granule;
+	};
+
+	// frames a packet decodes to, -1 to skip it
+	typedef std::function<int64_t(ogg_packet&)> PacketFrames;
+
+public:
+	OggPages(const CU_STR& filepath);
+
+	// the page at `pos`, or the next one found, `pos` moves past it
+	bool Next(size_t& pos, ogg_page& og) const;
+
+	// of the last page of `serial` after `begin`, -1 if none has one
+	int64_t GetLastGranule(int serial, size_t begin) const;
+
+	// of the first frame decoded from the page at `pos`, back from the
+	// first packet with a granule position, -1 if the stream ends before
+	int64_t GetStartGranule(int serial, size_t pos, const PacketFrames& frames) const;
+
+	// the pages of `serial` from `begin`, built at the first call
+	const CU_VEC<Page>& GetIndex(int serial, size_t begin);
+
+private:
+	MappedFile m_file;
+
+	std::once_flag m_index_once;
+	CU_VEC<Page>   m_index;
+
+}; // OggPages
+
+}
+
+#endif // _UNIAUDIO_OGG_PAGES_H_
+
+#endif // UA_SUPPORT_VORBIS || UA_SUPPORT_OPUS
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifdef UA_SUPPORT_OPUS
+
+#ifndef _UNIAUDIO_OPUS_DECODER_H_
+#define _UNIAUDIO_OPUS_DECODER_H_
+
+#include <cu/cu_stl.h>
+
+#include "uniaudio/Decoder.h"
+
+#include <ogg/ogg.h>
+#include <opus/opus.h>
+
+#include <memory>
+
+namespace ua
+{
+
+// Ogg Opus, mono or stereo, read from a MappedFile with libogg and
+// libopus. Outputs at 48 kHz, the rate Opus is coded at, the mixer's
+// Resampler takes it to the output rate. The pre-skip and the end
+// trimming of the granule positions are applied.
+class OpusDecoder : public Decoder
+{
+public:
+	OpusDecoder(const std::string& filepath, int buf_sz);
+	OpusDecoder(const OpusDecoder&);
+	virtual ~OpusDecoder();
+
+	virtual Decoder* Clone() override;
+
+	virtual int Decode(unsigned char* dst, int size) override final;
+	using Decoder::Decode;
+
+	virtual bool Seek(float s) override final;
+	// by the granule positions, sample exact, with PRE_ROLL decoded ahead
+	virtual bool SeekFrame(int64_t frame) override final;
+	virtual bool Rewind() override final;
+
+	virtual int GetChannels() const override final;
+	virtual int GetBitDepth() const override final;
+
+	virtual float GetDuration() const override final;
+
+	static bool Accepts(const CU_STR& ext);
+
+public:
+	static const int SAMPLE_RATE = 48000;
+
+	// the decoder converges within 80 ms
+	static const int PRE_ROLL = 3840;
+
+	// the longest packet, 120 ms
+	static const int MAX_PACKET = 5760;
+
+	// the file and its headers, shared
+	struct Stream;
+
+private:
+	void Init();
+
+	// the next packet into m_pcm, the skip and the end trimming applied,
+	// false at the end
+	bool DecodePacket();
+
+	// decodes from the page at `pos`, whose first packet is at `granule`,
+	// dropping `skip` frames
+	void Restart(size_t pos, int64_t granule, int64_t skip);
+
+private:
+	std::shared_ptr<Stream> m_stream;
+
+	ogg_stream_state m_ogg;
+	::OpusDecoder*   m_handle;
+
+	// in the file, of the next page
+	size_t  m_pos;
+	// of the next decoded frame, pre-skip included
+	int64_t m_granule;
+	// frames to drop, the pre-skip or after a seek
+	int64_t m_skip;
+
+	// the last packet decoded, interleaved, [begin, end) in frames left
+	CU_VEC<opus_int16> m_pcm;
+	int m_pcm_begin, m_pcm_end;
+
+}; // OpusDecoder
+
+}
+
+#endif // _UNIAUDIO_OPUS_DECODER_H_
+
+#endif // UA_SUPPORT_OPUS
\ No newline at end of file
@@ -1,44 +1,110 @@
 #ifndef _UNIAUDIO_OUTPUT_BUFFER_H_
 #define _UNIAUDIO_OUTPUT_BUFFER_H_
 
-#include <multitask/Thread.h>
+#include <cu/uncopyable.h>
 
-#include <list>
+#include <atomic>
+#include <memory>
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace ua
 {
 
-class OutputBuffer
+class BufferPool;
+
+/**
+ * Decoded blocks from the update thread to the mixer, wait-free on both
+ * sides with one producer and one consumer.
+ *
+ * A ring of fixed size slots. The producer fills the slot at m_write and
+ * publishes it when full or on Flush(), the consumer keeps the slot at
+ * m_read until its next Output(). The producer fills at most GetDepth()
+ * slots, from 1 to the slot count.
+ **/
+class OutputBuffer : private cu::Uncopyable
 {
 public:
-	OutputBuffer(int count, int size);
+	// `count` is rounded up to a power of two, the memory comes from
+	// `pool` if not null, which is kept until the memory is back
+	OutputBuffer(int count, int size, const std::shared_ptr<BufferPool>& pool = nullptr);
 	~OutputBuffer();
 
-	int Input(const unsigned char* buf, int buf_sz);
+	// producer, return the bytes taken, 0 if full
+	int  Input(const unsigned char* buf, int buf_sz);
+	// producer, the free part of the slot being filled, to decode into,
+	// nullptr if full
+	unsigned char* Reserve(int& sz);
+	// producer, `sz` bytes written after Reserve()
+	void Commit(int sz);
+	// producer, publishes the slot being filled, at the end of the stream
+	void Flush();
+	// bytes ready or being filled, from any thread
+	int  GetFilled() const;
+
+	// slots the producer may fill, from any thread, clamped to
+	// [1, GetCount()], the extra slots drain if it shrinks
+	void SetDepth(int depth);
+	int  GetDepth() const { return static_cast<int>(m_depth.load(std::memory_order_relaxed)); }
+	int  GetCount() const { return static_cast<int>(m_count); }
+	// of a slot
+	int  GetSlotSize() const { return static_cast<int>(m_slot_size); }
+
+	// consumer, valid until the next call, nullptr if nothing is ready
 	const unsigned char* Output(int& sz);
 
+	// Output() found the ring empty before the end of the stream
+	int GetUnderruns() const { return m_underruns.load(std::memory_order_relaxed); }
+	// consumer, the last Output() was an underrun
+	bool IsStarved() const { return m_starved; }
+
 private:
 	void Init(int count, int size);
 
+	void Publish();
+
 private:
-	struct Buffer
-	{
-		uint32_t cap;
-		uint32_t size;
-		uint8_t  buf[1];
-	};
+	static const int CACHE_LINE = 64;
 
 private:
-	std::mutex m_mutex;
+	std::shared_ptr<BufferPool> m_pool;
+
+	// one block, the slots then m_sizes
+	uint8_t*  m_data;
+	size_t    m_data_size;
+	// bytes in each published slot
+	uint32_t* m_sizes;
+
+	// capacity, and the distance between slots, 4 bytes aligned
+	uint32_t  m_slot_size, m_stride;
+	uint32_t  m_count, m_mask;
+
+	// the two sides a cache line apart whatever the object's alignment,
+	// alignas would need an aligned new, not there before C++17
+	char m_pad0[CACHE_LINE];
+
+	// written by the producer only
+	std::atomic<uint32_t> m_write;
+	// bytes in the slot at m_write, also read by GetFilled()
+	std::atomic<uint32_t> m_fill;
+	// m_write at the last Flush()
+	std::atomic<uint32_t> m_end;
+	std::atomic<uint32_t> m_depth;
+
+	char m_pad1[CACHE_LINE];
 
- 	std::list<Buffer*> m_bufs;
+	// written by the consumer only
+	std::atomic<uint32_t> m_read;
+	// the slot at m_read was returned by Output()
+	bool m_held;
+	bool m_starved;
+	std::atomic<int> m_underruns;
 
-	bool m_full;
+	char m_pad2[CACHE_LINE];
 
 }; // OutputBuffer
 
 }
 
-#endif // _UNIAUDIO_OUTPUT_BUFFER_H_
+#endif // _UNIAUDIO_OUTPUT_BUFFER_H_
\ No newline at end of file
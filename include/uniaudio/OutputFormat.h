@@ -0,0 +1,41 @@
+#ifndef _UNIAUDIO_OUTPUT_FORMAT_H_
+#define _UNIAUDIO_OUTPUT_FORMAT_H_
+
+#include <stdint.h>
+
+namespace ua
+{
+
+/**
+ * Format of the mixed stream handed to the device.
+ *
+ * Passed to the context as a request, zero fields mean "device default".
+ * The context negotiates with the backend and the result is what the
+ * mixer renders, see AudioContext::GetOutputFormat().
+ **/
+struct OutputFormat
+{
+	enum SampleFormat
+	{
+		SAMPLE_S16 = 0,
+		SAMPLE_F32,
+	};
+
+	int sample_rate;
+	// 1 or 2
+	int channels;
+	SampleFormat sample_fmt;
+
+	OutputFormat(int sample_rate = 0, int channels = 0, SampleFormat sample_fmt = SAMPLE_S16)
+		: sample_rate(sample_rate), channels(channels), sample_fmt(sample_fmt) {}
+
+	int GetBytesPerSample() const {
+		return sample_fmt == SAMPLE_F32 ? sizeof(float) : sizeof(int16_t);
+	}
+	int GetFrameSize() const { return GetBytesPerSample() * channels; }
+
+}; // OutputFormat
+
+}
+
+#endif // _UNIAUDIO_OUTPUT_FORMAT_H_
\ No newline at end of file
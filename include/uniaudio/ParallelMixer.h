@@ -0,0 +1,79 @@
+#ifndef _UNIAUDIO_PARALLEL_MIXER_H_
+#define _UNIAUDIO_PARALLEL_MIXER_H_
+
+#include "uniaudio/AudioMixer.h"
+
+#include <cu/uncopyable.h>
+#include <cu/cu_stl.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#include <stdint.h>
+
+namespace ua
+{
+
+/**
+ * Mixes the voices of one block on a pool of worker threads.
+ *
+ * Voices are spread by cost over at most NUM_PARTIALS partial buses, a
+ * worker takes a whole partial at a time. The split only depends on the
+ * voices and the partials are merged in order, so the output does not
+ * change with the thread count.
+ **/
+class ParallelMixer : private cu::Uncopyable
+{
+public:
+	// `threads` workers besides the calling thread
+	ParallelMixer(float buf_time_len, const OutputFormat& fmt, AudioMixer::Bus bus, int threads);
+	~ParallelMixer();
+
+	// mixes `batch` into `dst`, the calling thread works too
+	void Mix(AudioMixer& dst, const AudioMixer::Batch& batch);
+
+	int GetThreads() const { return static_cast<int>(m_threads.size()); }
+
+public:
+	static const int NUM_PARTIALS = 8;
+
+private:
+	// return the number of partials used
+	int Split(const AudioMixer::Batch& batch);
+
+	void Run();
+
+	void WorkerLoop();
+
+private:
+	struct Partial
+	{
+		AudioMixer*       mixer;
+		AudioMixer::Batch batch;
+		int64_t           cost;
+	};
+
+private:
+	// batch indices by cost
+	CU_VEC<int> m_order;
+
+	Partial m_partials[NUM_PARTIALS];
+
+	std::vector<std::thread> m_threads;
+
+	// below are guarded by m_mutex
+	std::mutex m_mutex;
+	std::condition_variable m_start_cond, m_done_cond;
+	int      m_num_partials;
+	// next partial to take, partials not finished
+	int      m_next, m_pending;
+	uint32_t m_generation;
+	bool     m_quit;
+
+}; // ParallelMixer
+
+}
+
+#endif // _UNIAUDIO_PARALLEL_MIXER_H_
@@ -0,0 +1,81 @@
+#ifndef _UNIAUDIO_PLAY_CURSOR_H_
+#define _UNIAUDIO_PLAY_CURSOR_H_
+
+#include <cu/uncopyable.h>
+
+#include <atomic>
+
+#include <stdint.h>
+
+namespace ua
+{
+
+/**
+ * Play position of a mixed voice, in mixer frames.
+ *
+ * Written by the thread that mixes the voice, under the pool's lock, and
+ * read lock-free from any thread. The mixed frames are queued with the
+ * output block they went into and only count once the device played that
+ * block, the position is what is heard, not what is mixed. The frame
+ * count, the time it was published and the block length form a seqlock,
+ * a reader retries if it raced a write.
+ **/
+class PlayCursor : private cu::Uncopyable
+{
+public:
+	PlayCursor();
+
+	// mixer rate
+	void SetSampleRate(int sample_rate);
+
+	// writer, moves to `time` second
+	void Reset(double time);
+	// writer, `frames` were heard now
+	void Advance(int frames);
+
+	// writer, `frames` were mixed into the output block `block`
+	void Queue(int frames, uint64_t block);
+	// writer, the device played every output block before `block`
+	void Play(uint64_t block);
+
+	int64_t GetFrame() const;
+	// in second, `interpolate` adds the time since the last Advance(), at
+	// most its block
+	double GetTime(bool interpolate = false) const;
+
+private:
+	void Publish(int64_t frame, int block);
+
+	void Read(int64_t& frame, int64_t& time, int& block) const;
+
+private:
+	struct Pending
+	{
+		uint64_t block;
+		int      frames;
+	};
+
+private:
+	std::atomic<int> m_sample_rate;
+
+	// odd while a write is in progress
+	std::atomic<uint32_t> m_seq;
+
+	std::atomic<int64_t> m_frame;
+	// XrunLog::Now()
+	std::atomic<int64_t> m_time;
+	// frames of the last Advance()
+	std::atomic<int>     m_block;
+
+	// mixed and not heard yet, writer only, more output blocks than any
+	// device queue holds
+	static const int MAX_PENDING = 32;
+	Pending m_pending[MAX_PENDING];
+	int     m_pending_begin;
+	int     m_pending_count;
+
+}; // PlayCursor
+
+}
+
+#endif // _UNIAUDIO_PLAY_CURSOR_H_
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef _UNIAUDIO_RESAMPLER_H_
+#define _UNIAUDIO_RESAMPLER_H_
+
+#include <cu/uncopyable.h>
+#include <cu/cu_stl.h>
+
+#include <stdint.h>
+
+namespace ua
+{
+
+struct MixKernel;
+
+/**
+ * Per voice polyphase resampler, converts any input rate to the mixer's.
+ *
+ * Input is pushed in whatever chunks the stream delivers and kept as
+ * planar float, the fractional read position is kept across blocks.
+ * The cost per output frame and channel is the tap count of the quality.
+ **/
+class Resampler : private cu::Uncopyable
+{
+public:
+	enum Quality
+	{
+		// 2 taps, linear interpolation
+		QUALITY_LINEAR = 0,
+		// 8 taps windowed sinc
+		QUALITY_MEDIUM,
+		// 16 taps windowed sinc
+		QUALITY_HIGH,
+	};
+
+public:
+	Resampler(int src_rate, int dst_rate, int channels, Quality quality);
+
+	// interleaved 8 or 16 bit pcm
+	void Push(const uint8_t* buf, int buf_sz, int bit_depth);
+
+	// input frames still missing to render `frames` output frames
+	int GetRequiredFrames(int frames) const;
+	// output frames the pushed input is enough for
+	int GetAvailableFrames() const;
+
+	// Accumulates up to `frames` frames into the interleaved stereo `dst`
+	// with gain (gain + step * f), return the number rendered, less than
+	// asked if input ran out.
+	int Process(float* dst, int frames, float gain, float step, const MixKernel& kernel);
+
+	// drops the pending input and the filter history
+	void Reset();
+
+	Quality GetQuality() const { return m_quality; }
+	// filter length, the cost of one output frame
+	int GetTaps() const { return m_taps; }
+
+	int GetSrcRate() const { return m_src_rate; }
+	int GetDstRate() const { return m_dst_rate; }
+
+private:
+	// drops the input before the read position
+	void Compact();
+
+private:
+	const int m_src_rate, m_dst_rate;
+	const int m_channels;
+
+	const Quality m_quality;
+
+	const float* m_table;
+	int m_taps;
+	int m_phase_shift;
+
+	// input frames per output frame, 32.32 fixed point
+	uint64_t m_step;
+
+	// planar, m_cap frames per channel
+	CU_VEC<float> m_buf;
+	int m_cap;
+
+	// frames in m_buf
+	int m_len;
+
+	// read position, 32.32 fixed point, the integer part is the index of
+	// the first tap in m_buf
+	uint64_t m_pos;
+
+}; // Resampler
+
+}
+
+#endif // _UNIAUDIO_RESAMPLER_H_
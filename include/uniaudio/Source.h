@@ -1,10 +1,17 @@
 #ifndef _UNIAUDIO_SOURCE_H_
 #define _UNIAUDIO_SOURCE_H_
 
+#include "uniaudio/Resampler.h"
+#include "uniaudio/GainRamp.h"
+#include "uniaudio/PlayCursor.h"
+#include "uniaudio/XrunLog.h"
+
 #include <cu/uncopyable.h>
 
 #include <memory>
 
+#include <stdint.h>
+
 namespace ua
 {
 
@@ -20,6 +27,9 @@ public:
 
 	virtual std::shared_ptr<Source> Clone() = 0;
 
+	// unique in the process, clones get their own
+	int GetId() const { return m_id; }
+
 	virtual bool Update() = 0;
 
 	virtual void Play() = 0;
@@ -31,26 +41,79 @@ public:
 	virtual void Seek(float offset) = 0;
 	virtual float Tell() = 0;
 
+	virtual bool IsLooping() const = 0;
+
 	void  SetOffset(float offset) { m_offset = offset; }
 	float GetOffset() const { return m_offset; }
-	void  SetDuration(float duration) { m_duration = duration; }
+	void  SetDuration(float duration) { m_duration = duration; UpdateFadeOut(); }
 	float GetDuration() const { return m_duration; }
 
-	void  SetFadeIn(float time) { m_fade_in = time; }
+	void  SetFadeIn(float time) { m_fade_in = time; m_gain_ramp.SetFadeIn(time); }
 	float GetFadeIn() const { return m_fade_in; }
-	void  SetFadeOut(float time) { m_fade_out = time; }
+	void  SetFadeOut(float time) { m_fade_out = time; UpdateFadeOut(); }
 	float GetFadeOut() const { return m_fade_out; }
 
 	void  SetOriVolume(float volume) { m_ori_volume = volume; }
 	float GetOriVolume() const { return m_ori_volume; }
 	float GetCurrVolume() const { return m_curr_volume; }
 
+	// for streams not at the mixer's rate, applies from the next Play()
+	void SetResampleQuality(Resampler::Quality quality) { m_resample_quality = quality; }
+	Resampler::Quality GetResampleQuality() const { return m_resample_quality; }
+
+	// volume and fades of the mixed streams, walked by the mixer
+	GainRamp& GetGainRamp() { return m_gain_ramp; }
+	// position of the mixed streams, advanced by the mixer
+	PlayCursor& GetPlayCursor() { return m_cursor; }
+
+	// submix bus of a mixed stream, from MixGraph::AddBus()
+	void SetMixBus(int bus) { m_mix_bus = bus; }
+	int  GetMixBus() const { return m_mix_bus; }
+
+	// -1 left to 1 right, mixed voices only
+	void  SetPan(float pan) { m_pan = pan < -1 ? -1 : (pan > 1 ? 1 : pan); }
+	float GetPan() const { return m_pan; }
+
+	// underruns of the stream, with the audio missing, added by the pool
+	const XrunCounter& GetXruns() const { return m_xruns; }
+	XrunCounter& GetXruns() { return m_xruns; }
+
+	// in frames of the stream, 0 end for the end of the stream
+	int64_t GetLoopBegin() const { return m_loop_begin; }
+	int64_t GetLoopEnd() const { return m_loop_end; }
+
+protected:
+	// the fade-out is at the end of m_duration, none when looping
+	void UpdateFadeOut();
+	// a stream played `time` second past m_duration, never when looping,
+	// its play time does not stop at the duration
+	bool IsPastDuration(double time) const;
+
+	// false if [begin, end) is empty
+	bool SetLoopRegionImpl(int64_t begin, int64_t end);
+	// a play time of a looping stream back into the loop region, a loop
+	// end of 0 is `length`, the stream's in second, no wrap if unknown
+	double WrapLoop(double time, int sample_rate, float length) const;
+
 protected:
+	const int m_id;
+
 	float m_offset, m_duration;
 	float m_fade_in, m_fade_out;
 
 	float m_ori_volume, m_curr_volume;
 
+	Resampler::Quality m_resample_quality;
+
+	GainRamp m_gain_ramp;
+	PlayCursor m_cursor;
+	XrunCounter m_xruns;
+
+	int m_mix_bus;
+	float m_pan;
+
+	int64_t m_loop_begin, m_loop_end;
+
 }; // Source
 
 }
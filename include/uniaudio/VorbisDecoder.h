@@ -0,0 +1,80 @@
+#ifdef UA_SUPPORT_VORBIS
+
+#ifndef _UNIAUDIO_VORBIS_DECODER_H_
+#define _UNIAUDIO_VORBIS_DECODER_H_
+
+#include <cu/cu_stl.h>
+
+#include "uniaudio/Decoder.h"
+
+#include <vorbis/codec.h>
+
+#include <memory>
+
+namespace ua
+{
+
+// Ogg Vorbis, mono or stereo, read from a MappedFile with libogg and
+// libvorbis. The pages are handed to libogg where they lie in the file,
+// the headers and codebooks are parsed once and shared by the clones.
+class VorbisDecoder : public Decoder
+{
+public:
+	VorbisDecoder(const std::string& filepath, int buf_sz);
+	VorbisDecoder(const VorbisDecoder&);
+	virtual ~VorbisDecoder();
+
+	virtual Decoder* Clone() override;
+
+	virtual int Decode(unsigned char* dst, int size) override final;
+	using Decoder::Decode;
+
+	// interleaved float, at most `frames`, return the frames
+	int DecodeFloat(float* dst, int frames);
+
+	virtual bool Seek(float s) override final;
+	// by the granule positions, sample exact
+	virtual bool SeekFrame(int64_t frame) override final;
+	virtual bool Rewind() override final;
+
+	virtual int GetChannels() const override final;
+	virtual int GetBitDepth() const override final;
+
+	virtual float GetDuration() const override final;
+
+	static bool Accepts(const CU_STR& ext);
+
+public:
+	// the file and its headers, shared
+	struct Stream;
+
+private:
+	void Init();
+
+	int  DecodeFrames(void* dst, int frames, bool to_float);
+
+	// one more packet into m_dsp, false at the end
+	bool NextPacket();
+
+	// decodes from the page at `pos`, dropping `skip` frames
+	void Restart(size_t pos, int64_t skip);
+
+private:
+	std::shared_ptr<Stream> m_stream;
+
+	ogg_stream_state m_ogg;
+	vorbis_dsp_state m_dsp;
+	vorbis_block     m_block;
+
+	// in the file, of the next page
+	size_t  m_pos;
+	// frames to drop after a seek
+	int64_t m_skip;
+
+}; // VorbisDecoder
+
+}
+
+#endif // _UNIAUDIO_VORBIS_DECODER_H_
+
+#endif // UA_SUPPORT_VORBIS
\ No newline at end of file
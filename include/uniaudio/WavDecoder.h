@@ -0,0 +1,77 @@
+#ifndef _UNIAUDIO_WAV_DECODER_H_
+#define _UNIAUDIO_WAV_DECODER_H_
+
+#include <cu/cu_stl.h>
+
+#include "uniaudio/Decoder.h"
+
+#include <memory>
+
+namespace ua
+{
+
+class MappedFile;
+class ImaAdpcm;
+
+// RIFF/WAVE of 8, 16, 24 or 32 bit PCM, float or IMA ADPCM, mono or
+// stereo, read from a MappedFile. Decodes to 16 bit, 16 bit PCM is served
+// as it is by Map() and GetData(), IMA ADPCM by GetAdpcmData().
+class WavDecoder : public Decoder
+{
+public:
+	WavDecoder(const std::string& filepath, int buf_sz);
+	WavDecoder(const WavDecoder&);
+	virtual ~WavDecoder();
+
+	virtual Decoder* Clone() override;
+
+	virtual int Decode(unsigned char* dst, int size) override final;
+	using Decoder::Decode;
+
+	virtual int Map(const unsigned char*& buf, int size) override final;
+	virtual const unsigned char* GetData(size_t& size) const override final;
+	virtual const unsigned char* GetAdpcmData(size_t& size, int& block_align, int64_t& frames) const override final;
+
+	virtual bool Seek(float s) override final;
+	virtual bool SeekFrame(int64_t frame) override final;
+	virtual bool Rewind() override final;
+
+	virtual int GetChannels() const override final;
+	virtual int GetBitDepth() const override final;
+
+	virtual float GetDuration() const override final;
+
+	static bool Accepts(const CU_STR& ext);
+
+private:
+	bool ParseHeader();
+
+	// of the file
+	bool IsPcm16() const { return !m_float && m_src_bits == 16; }
+	bool IsAdpcm() const { return m_ima != nullptr; }
+
+private:
+	// shared by the clones
+	std::shared_ptr<MappedFile> m_file;
+
+	// the data chunk
+	const unsigned char* m_samples;
+	int64_t m_frames;
+
+	int  m_channels;
+	int  m_src_bits;
+	bool m_float;
+	// of a block for IMA ADPCM
+	int  m_src_frame_size;
+
+	// IMA ADPCM, decoded a block at a time
+	std::unique_ptr<ImaAdpcm> m_ima;
+
+	// of the next Decode()
+	int64_t m_frame;
+
+}; // WavDecoder
+
+}
+
+#endif // _UNIAUDIO_WAV_DECODER_H_
\ No newline at end of file
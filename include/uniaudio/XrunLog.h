@@ -0,0 +1,106 @@
+#ifndef _UNIAUDIO_XRUN_LOG_H_
+#define _UNIAUDIO_XRUN_LOG_H_
+
+#include <cu/uncopyable.h>
+
+#include <atomic>
+
+#include <stdint.h>
+
+namespace ua
+{
+
+enum XrunCause
+{
+	// the decoder was running, short of CPU time
+	XRUN_DECODE_LATE = 0,
+	// the decoder was waiting on file reads
+	XRUN_IO_LATE,
+	// nothing was decoding, the consumer came before the next refill
+	XRUN_CONSUMER_EARLY,
+
+	XRUN_CAUSE_COUNT
+};
+
+struct XrunEvent
+{
+	// steady clock, nanoseconds, see XrunLog::Now()
+	int64_t   time;
+	// Source::GetId(), -1 for the output queue
+	int       source;
+	XrunCause cause;
+	// of the audio that was not played, in second
+	float     missing;
+};
+
+// Totals of the xruns, read lock-free from any thread.
+class XrunCounter
+{
+public:
+	XrunCounter();
+	// starts from zero
+	XrunCounter(const XrunCounter&);
+
+	void Add(XrunCause cause, float missing);
+
+	int GetCount() const;
+	int GetCount(XrunCause cause) const;
+	// in second
+	float GetMissing() const;
+
+private:
+	std::atomic<int>     m_counts[XRUN_CAUSE_COUNT];
+	std::atomic<int64_t> m_missing_us;
+
+}; // XrunCounter
+
+/**
+ * The last CAPACITY xruns of a context and its totals.
+ *
+ * Add() is called by one thread at a time, under the pool's lock. Readers
+ * take no lock, each slot is a seqlock and a slot overwritten while read
+ * is skipped.
+ **/
+class XrunLog : private cu::Uncopyable
+{
+public:
+	XrunLog();
+
+	void Add(const XrunEvent& ev);
+
+	// the `max` most recent events at most into `events`, oldest first,
+	// return how many
+	int GetRecent(XrunEvent* events, int max) const;
+
+	const XrunCounter& GetCounter() const { return m_counter; }
+
+	// steady clock, nanoseconds
+	static int64_t Now();
+
+public:
+	static const int CAPACITY = 64;
+
+private:
+	struct Slot
+	{
+		// 2 * index + 2 once written, odd while writing
+		std::atomic<uint32_t> seq;
+
+		std::atomic<int64_t> time;
+		std::atomic<int>     source;
+		std::atomic<int>     cause;
+		std::atomic<float>   missing;
+	};
+
+private:
+	Slot m_slots[CAPACITY];
+	// index of the next event
+	std::atomic<uint32_t> m_next;
+
+	XrunCounter m_counter;
+
+}; // XrunLog
+
+}
+
+#endif // _UNIAUDIO_XRUN_LOG_H_
\ No newline at end of file
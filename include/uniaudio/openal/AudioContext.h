@@ -16,8 +16,8 @@ class AudioPool;
 class AudioContext : public ua::AudioContext
 {
 public:
-	AudioContext();
-	AudioContext(ALCdevice* device, ALCcontext* context);
+	AudioContext(const OutputFormat& fmt = OutputFormat());
+	AudioContext(ALCdevice* device, ALCcontext* context, const OutputFormat& fmt = OutputFormat());
 	virtual ~AudioContext();
 
 	virtual std::shared_ptr<ua::Source> CreateSource(const AudioData* data) override final;
@@ -31,6 +31,21 @@ public:
 
 	virtual void SetVolume(float volume) override final;
 
+	virtual void SetMixThreads(int threads) override final;
+
+	virtual void SetDecodeThreads(int threads) override final;
+
+	virtual void  SetOutputLatency(float min_time, float max_time) override final;
+	virtual float GetOutputLatency() const override final;
+
+	virtual const XrunLog& GetXrunLog() const override final;
+
+	virtual const BufferPool& GetBufferPool() const override final;
+
+	virtual MixGraph& GetMixGraph() override final;
+
+	virtual const OutputFormat& GetOutputFormat() const override final { return m_format; }
+
 public:
 	// 10ms length.
 	static const float BUFFER_TIME_LEN;
@@ -40,6 +55,8 @@ private:
 	void Initialize(ALCdevice* device, ALCcontext* context);
 	void Terminate();
 
+	void NegotiateFormat();
+
 private:
 	bool m_own_ctx;
 
@@ -47,6 +64,9 @@ private:
 
 	ALCcontext* m_context;
 
+	// requested, then what the device accepted
+	OutputFormat m_format;
+
 	AudioPool* m_pool;
 
 }; // AudioContext
@@ -2,6 +2,12 @@
 #define _UNIAUDIO_OPENAL_AUDIO_POOL_H_
 
 #include <uniaudio/AudioMixer.h>
+#include <uniaudio/ParallelMixer.h>
+#include <uniaudio/MixGraph.h>
+#include <uniaudio/DecodePool.h>
+#include <uniaudio/AdaptiveDepth.h>
+#include <uniaudio/XrunLog.h>
+#include <uniaudio/BufferPool.h>
 #include <cu/uncopyable.h>
 #include <cu/cu_stl.h>
 #include <multitask/Thread.h>
@@ -11,17 +17,43 @@
 #include <queue>
 #include <atomic>
 #include <memory>
+#include <mutex>
 
 namespace ua
 {
 namespace openal
 {
 
+/**
+ * AL buffers of the non-mixed streams, recycled instead of deleted.
+ *
+ * Shared by the pool and its streams, a stream can outlive the pool and
+ * still give its buffers back. Those are dropped once the pool closed it,
+ * with the AL context gone.
+ **/
+class StreamBuffers : private cu::Uncopyable
+{
+public:
+	StreamBuffers() : m_closed(false) {}
+
+	void Gen(ALuint* buffers, int n);
+	void Delete(const ALuint* buffers, int n);
+
+	// deletes the recycled buffers, while the AL context is current
+	void Close();
+
+private:
+	std::mutex m_mutex;
+	CU_VEC<ALuint> m_freelist;
+	bool m_closed;
+
+}; // StreamBuffers
+
 class Source;
 class AudioPool : private cu::Uncopyable
 {
 public:
-	AudioPool();
+	AudioPool(const OutputFormat& fmt);
 	~AudioPool();
 
 	void Update();
@@ -42,24 +74,100 @@ public:
 	float GetVolume() const { return m_volume; }
 	void  SetVolume(float volume) { m_volume = volume; }
 
+	void SetMixThreads(int threads);
+
+	// bounds in second of the mixed audio queued on the device
+	void  SetOutputLatency(float min_time, float max_time);
+	// current, in second
+	float GetOutputLatency();
+
+	void SetDecodeThreads(int threads);
+	// the mixed streams are not decoded by Source::Update()
+	bool IsDecodeAhead() const { return m_decode_pool != nullptr; }
+
+	MixGraph& GetMixGraph() { return m_queue_player.GetMixGraph(); }
+
+	// AL buffers of the non-mixed streams
+	const std::shared_ptr<StreamBuffers>& GetStreamBuffers() const { return m_stream_buffers; }
+
+	// the rings of the streams, shared with them, they can outlive the pool
+	const std::shared_ptr<BufferPool>& GetBufferPool() const { return m_buffer_pool; }
+
+	// added to under the pool's lock
+	const XrunLog& GetXrunLog() const { return m_xruns; }
+	XrunLog& GetXrunLog() { return m_xruns; }
+
+	const OutputFormat& GetOutputFormat() const { return m_queue_player.GetFormat(); }
+
+private:
+	void StartDecodeAhead(Source& source);
+	void StopDecodeAhead(const std::shared_ptr<Source>& source);
+	// drops the stopped sources no worker decodes any more
+	void ReleaseDecoded();
+
 private:
 	class QueuePlayer
 	{
 	public:
-		QueuePlayer();
+		QueuePlayer(const OutputFormat& fmt);
 		~QueuePlayer();
 
-		void Update(const std::set<std::shared_ptr<Source>>& playing);
+		void Update(const std::set<std::shared_ptr<Source>>& playing, XrunLog& xruns);
+
+		const OutputFormat& GetFormat() const { return m_mixer.GetFormat(); }
+
+		void SetMixThreads(int threads);
+
+		void  SetLatency(float min_time, float max_time);
+		float GetLatency() const;
+
+		MixGraph& GetMixGraph() { return m_graph; }
 
 	private:
-		void Stream(ALuint buffer, const std::set<std::shared_ptr<Source>>& playing);
+		void Stream(ALuint buffer, const std::set<std::shared_ptr<Source>>& playing, XrunLog& xruns);
+
+		// stop the source once the whole queue is silence, restart it
+		// with the silent buffers when a mixed source plays again
+		void Sleep();
+		void Wakeup();
+
+		int GetBufferIndex(ALuint buffer) const;
 
 	private:
 		ALuint     m_source;
 		AudioMixer m_mixer;
+		ALenum     m_al_format;
+
+		MixGraph   m_graph;
+
+		// nullptr mixes on the calling thread
+		ParallelMixer* m_parallel;
 
 		static const unsigned int MAX_BUFFERS = 16;
+		static const unsigned int MIN_BUFFERS = 2;
 		ALuint m_buffers[MAX_BUFFERS];
+		// buffer holds zeros, no need to upload silence again
+		bool   m_silent[MAX_BUFFERS];
+		// output block the buffer holds
+		uint64_t m_block[MAX_BUFFERS];
+
+		// the depth of the queue, in buffers
+		AdaptiveDepth m_depth;
+		unsigned int  m_queued;
+		// not queued, after the queue shrank
+		CU_VEC<ALuint> m_free;
+		// the device played every queued buffer
+		int m_underruns;
+		// XrunLog::Now() of the last Update()
+		int64_t m_last_update;
+
+		// output blocks mixed, and played by the device
+		uint64_t m_mixed_blocks;
+		uint64_t m_played_blocks;
+
+		// queued buffers in a row that are silent
+		unsigned int m_silent_count;
+		bool m_idle;
 
 	}; // QueuePlayer
 
@@ -75,6 +183,18 @@ private:
 	// queue
 	QueuePlayer m_queue_player;
 
+	// nullptr decodes on the update thread
+	DecodePool* m_decode_pool;
+	// stopped while a worker was decoding them, the buffers live until
+	// it is done
+	CU_VEC<std::shared_ptr<Source>> m_releasing;
+
+	XrunLog m_xruns;
+
+	std::shared_ptr<BufferPool> m_buffer_pool;
+
+	std::shared_ptr<StreamBuffers> m_stream_buffers;
+
 	std::atomic<bool> m_active;
 
 	// status
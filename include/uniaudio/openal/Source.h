@@ -2,6 +2,8 @@
 #define _UNIAUDIO_OPENAL_SOURCE_H_
 
 #include "uniaudio/Source.h"
+#include "uniaudio/AudioMixer.h"
+#include "uniaudio/AdaptiveDepth.h"
 
 #include <OpenAL/al.h>
 
@@ -19,6 +21,7 @@ namespace openal
 {
 
 class AudioPool;
+class StreamBuffers;
 class Source : public ua::Source, public std::enable_shared_from_this<Source>
 {
 public:
@@ -50,10 +53,26 @@ public:
 	float TellImpl();
 
 	void SetLooping(bool looping);
-	bool IsLooping() const { return m_looping; }
+	// streams only, see InputBuffer::SetLoopRegion()
+	void SetLoopRegion(int64_t begin, int64_t end);
+	virtual bool IsLooping() const override final { return m_looping; }
 
 	const InputBuffer* GetInputBuffer() const { return m_ibuf; }
+	InputBuffer* GetInputBuffer() { return m_ibuf; }
 	OutputBuffer* GetOutputBuffer() { return m_obuf; }
+	// times the mixer found no decoded audio, see DecodePool
+	int GetUnderruns() const;
+
+	// bounds in second of the audio decoded ahead of the mixer, the depth
+	// follows the update jitter and the underruns within them
+	void  SetBufferLatency(float min_time, float max_time);
+	// current, in second
+	float GetBufferLatency() const;
+
+	// nullptr if the stream is at the mixer's rate
+	Resampler* GetResampler() { return m_resampler; }
+	// resolved by the pool at the first mixed block
+	AudioMixer::Voice& GetMixVoice() { return m_mix_voice; }
 
 	void SetPlayer(ALuint player);
 	ALuint GetPlayer() { return m_player; }
@@ -75,10 +94,17 @@ private:
 
 	void UpdateCurrVolume();
 
+	void ResetResampler();
+
 	float GetCurrOffset() const;
 
+	// of one of m_buffers, in second
+	float GetBufferTime() const;
+
 private:
+	// the capacity, and the lowest depth by default
 	static const int OUTPUT_BUF_COUNT = 16;
+	static const int OUTPUT_BUF_MIN_DEPTH = 2;
 
 private:
 	AudioPool* m_pool;
@@ -96,11 +122,19 @@ private:
 	// queue
 	InputBuffer*  m_ibuf;
 	OutputBuffer* m_obuf;
+	AdaptiveDepth m_depth;
+	Resampler*    m_resampler;
+	AudioMixer::Voice m_mix_voice;
 
 	// no mix
 	ALuint m_player;
 	static const unsigned int MAX_BUFFERS = 16;
 	ALuint m_buffers[MAX_BUFFERS];
+	// where m_buffers go back, kept past the pool
+	std::shared_ptr<StreamBuffers> m_stream_buffers;
+	// XrunLog::Now() of the last Update(), the buffers queued then
+	int64_t m_last_update;
+	int     m_last_queued;
 
 }; // Source
 
@@ -27,8 +27,8 @@ class AudioPool;
 class AudioContext : public ua::AudioContext
 {
 public:
-	AudioContext();
-	AudioContext(SLObjectItf engine, SLObjectItf output_mix);
+	AudioContext(const OutputFormat& fmt = OutputFormat());
+	AudioContext(SLObjectItf engine, SLObjectItf output_mix, const OutputFormat& fmt = OutputFormat());
 	virtual ~AudioContext();
 
 	virtual std::shared_ptr<ua::Source> CreateSource(const AudioData* data) override;
@@ -42,6 +42,21 @@ public:
 
 	virtual void SetVolume(float volume) override final;
 
+	virtual void SetMixThreads(int threads) override final;
+
+	virtual void SetDecodeThreads(int threads) override final;
+
+	virtual void  SetOutputLatency(float min_time, float max_time) override final;
+	virtual float GetOutputLatency() const override final;
+
+	virtual const XrunLog& GetXrunLog() const override final;
+
+	virtual const BufferPool& GetBufferPool() const override final;
+
+	virtual MixGraph& GetMixGraph() override final;
+
+	virtual const OutputFormat& GetOutputFormat() const override final { return m_format; }
+
 #ifdef __ANDROID__
 	void InitAAssetMgr(JNIEnv* env, jobject assetManager);
 	bool LoadAssetFile(const CU_STR& filepath, SLDataLocator_AndroidFD* loc_fd);
@@ -72,6 +87,9 @@ private:
 	// buffer queue player interfaces
 	AudioPool* m_pool;
 
+	// requested, then what the buffer queue player accepted
+	OutputFormat m_format;
+
 	// aux effect on the output mix, used by the buffer queue player
 	static const SLEnvironmentalReverbSettings m_reverb_settings;
 
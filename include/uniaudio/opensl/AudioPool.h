@@ -2,6 +2,11 @@
 #define _UNIAUDIO_OPENSL_AUDIO_POOL_H_
 
 #include <uniaudio/AudioMixer.h>
+#include <uniaudio/ParallelMixer.h>
+#include <uniaudio/MixGraph.h>
+#include <uniaudio/DecodePool.h>
+#include <uniaudio/XrunLog.h>
+#include <uniaudio/BufferPool.h>
 #include <uniaudio/opensl/AudioPlayer.h>
 
 #include <cu/uncopyable.h>
@@ -23,7 +28,7 @@ class AudioContext;
 class AudioPool : private cu::Uncopyable
 {
 public:
-	AudioPool(AudioContext* ctx);
+	AudioPool(AudioContext* ctx, const OutputFormat& fmt);
 	~AudioPool();
 
 	void Update();
@@ -46,12 +51,43 @@ public:
 	float GetVolume() const { return m_volume; }
 	void  SetVolume(float volume) { m_volume = volume; }
 
+	void SetMixThreads(int threads);
+
+	// the queue is refilled by the device callback, its depth stays at
+	// NUM_OPENSL_BUFFERS
+	void  SetOutputLatency(float, float) {}
+	float GetOutputLatency() const;
+
+	void SetDecodeThreads(int threads);
+	// the mixed streams are not decoded by Source::Update()
+	bool IsDecodeAhead() const { return m_decode_pool != nullptr; }
+
+	MixGraph& GetMixGraph() { return *m_graph; }
+
+	// the rings of the streams, shared with them, they can outlive the pool
+	const std::shared_ptr<BufferPool>& GetBufferPool() const { return m_buffer_pool; }
+
+	// added to under the pool's lock
+	const XrunLog& GetXrunLog() const { return m_xruns; }
+
+	const OutputFormat& GetOutputFormat() const { return m_format; }
+
 private:
 	void CreateAssetsAudioPlayer();
-	void CreateBufferQueueAudioPlayer();
+	void CreateBufferQueueAudioPlayer(const OutputFormat& fmt);
+	SLresult CreateBufferQueueAudioPlayer(const OutputFormat& fmt, bool float_fmt);
 
 	void EnqueueAllBuffers();
 
+	void StartDecodeAhead(Source& source);
+	void StopDecodeAhead(const std::shared_ptr<Source>& source);
+	// drops the stopped sources no worker decodes any more
+	void ReleaseDecoded();
+
+	// the queue player stops enqueuing once it has only played silence,
+	// it is paused from Update() and restarted with silent buffers
+	void WakeupQueuePlayer();
+
 private:
 	static const int NUM_OPENSL_BUFFERS = 2;
 
@@ -70,8 +106,34 @@ private:
 	std::queue<AssetPlayer*> m_asset_player_freelist;
 
 	// queue
-	QueuePlayer m_queue_player;
-	AudioMixer  m_queue_mixer;
+	QueuePlayer  m_queue_player;
+	// created once the player has accepted a format
+	AudioMixer*  m_queue_mixer;
+	OutputFormat m_format;
+	MixGraph*    m_graph;
+	// nullptr mixes on the callback thread
+	ParallelMixer* m_parallel;
+	// nullptr decodes on the update thread
+	DecodePool*    m_decode_pool;
+	// stopped while a worker was decoding them, the buffers live until
+	// it is done
+	CU_VEC<std::shared_ptr<Source>> m_releasing;
+
+	XrunLog m_xruns;
+
+	std::shared_ptr<BufferPool> m_buffer_pool;
+
+	// one mix buffer of zeros, enqueued instead of a silent mix
+	uint8_t* m_silence;
+	// enqueued buffers in a row that are silent
+	int  m_silent_count;
+	bool m_queue_idle;
+	bool m_queue_paused;
+
+	// output blocks enqueued, and played by the device, the queue is
+	// FIFO and each callback is one played block
+	uint64_t m_mixed_blocks;
+	uint64_t m_played_blocks;
 
 	// status
 	float m_volume;
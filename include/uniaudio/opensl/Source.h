@@ -4,6 +4,8 @@
 #include <cu/cu_stl.h>
 
 #include "uniaudio/Source.h"
+#include "uniaudio/AudioMixer.h"
+#include "uniaudio/AdaptiveDepth.h"
 #include "uniaudio/opensl/AudioPlayer.h"
 
 #include <memory>
@@ -51,10 +53,26 @@ public:
 	float TellImpl();
 
 	void SetLooping(bool looping);
-	bool IsLooping() const { return m_looping; }
+	// streams only, see InputBuffer::SetLoopRegion()
+	void SetLoopRegion(int64_t begin, int64_t end);
+	virtual bool IsLooping() const override final { return m_looping; }
 
 	const InputBuffer* GetInputBuffer() const { return m_ibuf; }
+	InputBuffer* GetInputBuffer() { return m_ibuf; }
 	OutputBuffer* GetOutputBuffer() { return m_obuf; }
+	// times the mixer found no decoded audio, see DecodePool
+	int GetUnderruns() const;
+
+	// bounds in second of the audio decoded ahead of the mixer, the depth
+	// follows the update jitter and the underruns within them
+	void  SetBufferLatency(float min_time, float max_time);
+	// current, in second
+	float GetBufferLatency() const;
+
+	// nullptr if the stream is at the mixer's rate
+	Resampler* GetResampler() { return m_resampler; }
+	// resolved by the pool at the first mixed block
+	AudioMixer::Voice& GetMixVoice() { return m_mix_voice; }
 
 	const std::string& GetFilepath() const { return m_filepath; }
 
@@ -69,15 +87,17 @@ public:
 
 	bool IsStream() const { return m_stream; }
 
-	void UpdataOffset(float dt) { m_curr_offset += dt; }
-
 private:
 	void Stream();
 
 	void UpdateCurrVolume();
 
+	void ResetResampler();
+
 private:
+	// the capacity, and the lowest depth by default
 	static const int OUTPUT_BUF_COUNT = 16;
+	static const int OUTPUT_BUF_MIN_DEPTH = 2;
 
 private:
 	AudioPool* m_pool;
@@ -93,6 +113,9 @@ private:
 	// queue
 	InputBuffer*  m_ibuf;
 	OutputBuffer* m_obuf;
+	AdaptiveDepth m_depth;
+	Resampler*    m_resampler;
+	AudioMixer::Voice m_mix_voice;
 
 	// asset
 	std::string  m_filepath;
@@ -0,0 +1,85 @@
+#include "uniaudio/AdaptiveDepth.h"
+#include "uniaudio/XrunLog.h"
+
+#include <algorithm>
+
+#include <math.h>
+
+namespace ua
+{
+
+const float AdaptiveDepth::GAP_HALF_LIFE = 2.0f;
+const float AdaptiveDepth::SHRINK_DELAY  = 5.0f;
+const float AdaptiveDepth::SHRINK_STEP   = 0.5f;
+
+AdaptiveDepth::AdaptiveDepth(float block_time, int min_depth, int max_depth)
+	: m_block_time(block_time)
+	, m_min(1)
+	, m_max(1)
+	, m_depth(1)
+	, m_last_time(-1)
+	, m_peak_gap(0)
+	, m_underruns(0)
+	, m_hold_until(0)
+{
+	SetRange(min_depth, max_depth);
+	m_depth = m_max;
+}
+
+void AdaptiveDepth::SetRange(int min_depth, int max_depth)
+{
+	m_min = std::max(min_depth, 1);
+	m_max = std::max(max_depth, m_min);
+	m_depth = std::min(std::max(m_depth, m_min), m_max);
+}
+
+void AdaptiveDepth::SetLatency(float min_time, float max_time)
+{
+	SetRange(static_cast<int>(ceil(min_time / m_block_time - 1e-3f)),
+		static_cast<int>(ceil(max_time / m_block_time - 1e-3f)));
+}
+
+int AdaptiveDepth::Update(double time, int underruns)
+{
+	if (m_last_time >= 0)
+	{
+		const double gap = std::max(time - m_last_time, 0.0);
+		m_peak_gap = std::max(gap, m_peak_gap * pow(0.5, gap / GAP_HALF_LIFE));
+	}
+	else
+	{
+		// the first gaps are not known yet
+		m_hold_until = time + SHRINK_DELAY;
+	}
+	m_last_time = time;
+
+	// the gap to cover, and the block being played
+	const int need = static_cast<int>(ceil(m_peak_gap / m_block_time)) + 1;
+
+	if (underruns != m_underruns)
+	{
+		m_underruns = underruns;
+		m_depth = std::max(m_depth + std::max(m_depth / 2, 1), need);
+		m_hold_until = time + SHRINK_DELAY;
+	}
+	else if (need > m_depth)
+	{
+		m_depth = need;
+		m_hold_until = time + SHRINK_DELAY;
+	}
+	else if (need < m_depth && time >= m_hold_until)
+	{
+		--m_depth;
+		m_hold_until = time + SHRINK_STEP;
+	}
+
+	m_depth = std::min(std::max(m_depth, m_min), m_max);
+	return m_depth;
+}
+
+int AdaptiveDepth::Update(int underruns)
+{
+	return Update(XrunLog::Now() * 1e-9, underruns);
+}
+
+}
\ No newline at end of file
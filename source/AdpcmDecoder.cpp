@@ -0,0 +1,91 @@
+#include "uniaudio/AdpcmDecoder.h"
+#include "uniaudio/AudioData.h"
+
+#include <algorithm>
+
+namespace ua
+{
+
+AdpcmDecoder::AdpcmDecoder(const AudioData* data, int buf_sz)
+	: Decoder(buf_sz)
+	, m_data(data)
+	, m_ima(data->GetData(), data->GetBlockAlign() != 0 ? data->GetFrames() : 0,
+		data->GetChannels(), data->GetBlockAlign())
+	, m_frame(0)
+{
+	m_sample_rate = data->GetSampleRate();
+	m_length = static_cast<int>(m_ima.GetFrames());
+}
+
+AdpcmDecoder::AdpcmDecoder(const AdpcmDecoder& src)
+	: Decoder(src)
+	, m_data(src.m_data)
+	, m_ima(src.m_ima)
+	, m_frame(0)
+{
+	m_eof = false;
+}
+
+AdpcmDecoder::~AdpcmDecoder()
+{
+}
+
+Decoder* AdpcmDecoder::Clone()
+{
+	return new AdpcmDecoder(*this);
+}
+
+int AdpcmDecoder::Decode(unsigned char* dst, int size)
+{
+	const int channels = GetChannels();
+	const int n = static_cast<int>(std::min<int64_t>(size / (channels * 2), m_ima.GetFrames() - m_frame));
+	if (n > 0) {
+		m_ima.Decode(reinterpret_cast<int16_t*>(dst), m_frame, n);
+		m_frame += n;
+	}
+	if (m_frame >= m_ima.GetFrames()) {
+		m_eof = true;
+	}
+	return std::max(n, 0) * channels * 2;
+}
+
+bool AdpcmDecoder::Seek(float s)
+{
+	if (s < 0) {
+		return false;
+	}
+	return SeekFrame(static_cast<int64_t>(s * static_cast<double>(m_sample_rate)));
+}
+
+bool AdpcmDecoder::SeekFrame(int64_t frame)
+{
+	if (frame < 0 || frame > m_ima.GetFrames()) {
+		return false;
+	}
+
+	m_frame = frame;
+	m_eof = false;
+	return true;
+}
+
+bool AdpcmDecoder::Rewind()
+{
+	return SeekFrame(0);
+}
+
+int AdpcmDecoder::GetChannels() const
+{
+	return m_data->GetBlockAlign() != 0 ? m_data->GetChannels() : DEFAULT_CHANNELS;
+}
+
+int AdpcmDecoder::GetBitDepth() const
+{
+	return 16;
+}
+
+float AdpcmDecoder::GetDuration() const
+{
+	return m_length == 0 ? 0 : static_cast<float>(static_cast<double>(m_length) / m_sample_rate);
+}
+
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "uniaudio/Exception.h"
 #include "uniaudio/DecoderFactory.h"
 #include "uniaudio/Decoder.h"
+#include "uniaudio/ImaAdpcm.h"
 
 #include <limits>
 #include <algorithm>
@@ -12,14 +13,16 @@
 namespace ua
 {
 
-AudioData::AudioData(const CU_STR& filepath)
+AudioData::AudioData(const CU_STR& filepath, Storage storage)
 	: m_data(nullptr)
 	, m_size(0)
 	, m_sample_rate(Decoder::DEFAULT_SAMPLE_RATE)
 	, m_channels(0)
 	, m_bit_depth(0)
+	, m_block_align(0)
+	, m_frames(0)
 {
-	LoadFromFile(filepath);
+	LoadFromFile(filepath, storage);
 }
 
 AudioData::AudioData(const CU_VEC<ua::AudioData*>& list)
@@ -28,33 +31,92 @@ AudioData::AudioData(const CU_VEC<ua::AudioData*>& list)
 	, m_sample_rate(Decoder::DEFAULT_SAMPLE_RATE)
 	, m_channels(0)
 	, m_bit_depth(0)
+	, m_block_align(0)
+	, m_frames(0)
 {
 	LoadFromList(list);
 }
 
 AudioData::~AudioData()
 {
-	if (m_data) {
-		delete[] m_data;
+	if (m_data && !m_mapped) {
+		free(m_data);
 	}
 }
 
-void AudioData::LoadFromFile(const CU_STR& filepath)
+int64_t AudioData::GetFrames() const
+{
+	if (m_block_align != 0) {
+		return m_frames;
+	}
+	const int frame_size = m_channels * m_bit_depth / 8;
+	return frame_size > 0 ? m_size / frame_size : 0;
+}
+
+void AudioData::LoadFromFile(const CU_STR& filepath, Storage storage)
 {
 	std::unique_ptr<Decoder> decoder = DecoderFactory::Create(filepath);
 	if (!decoder) {
 		return;
 	}
 
+	m_sample_rate = decoder->GetSampleRate();
+	m_channels = decoder->GetChannels();
+	m_bit_depth = decoder->GetBitDepth();
+
+	// the blocks of the file, as they are
+	if (storage == STORE_IMA_ADPCM)
+	{
+		size_t size = 0;
+		int block_align = 0;
+		int64_t frames = 0;
+		if (const unsigned char* blocks = decoder->GetAdpcmData(size, block_align, frames))
+		{
+			if (size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+				throw Exception("Not enough memory.");
+			}
+			m_data = const_cast<uint8_t*>(blocks);
+			m_size = static_cast<int>(size);
+			m_bit_depth = 4;
+			m_block_align = block_align;
+			m_frames = frames;
+			m_mapped = std::move(decoder);
+			return;
+		}
+	}
+
+	// no copy, only read, LoadFromList() copies its first data
+	size_t mapped_size = 0;
+	if (const unsigned char* mapped = decoder->GetData(mapped_size))
+	{
+		if (mapped_size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+			throw Exception("Not enough memory.");
+		}
+		m_data = const_cast<uint8_t*>(mapped);
+		m_size = static_cast<int>(mapped_size);
+		m_mapped = std::move(decoder);
+		if (storage == STORE_IMA_ADPCM) {
+			Compress();
+		}
+		return;
+	}
+
 	size_t buf_size = 524288; // 0x80000
-	int decoded = decoder->Decode();
-	while (decoded > 0)
+	const int chunk = decoder->GetBufferSize();
+	while (true)
 	{
+		// Overflow check.
+		if (static_cast<unsigned int>(m_size) > std::numeric_limits<size_t>::max() - chunk)
+		{
+			free(m_data);
+			throw Exception("Not enough memory.");
+		}
+
 		// Expand or allocate buffer. Note that realloc may move
 		// memory to other locations.
-		if (!m_data || buf_size < static_cast<size_t>(m_size + decoded))
+		if (!m_data || buf_size < static_cast<size_t>(m_size + chunk))
 		{
-			while (buf_size < static_cast<size_t>(m_size + decoded)) {
+			while (buf_size < static_cast<size_t>(m_size + chunk)) {
 				buf_size <<= 1;
 			}
 			m_data = static_cast<uint8_t*>(realloc(m_data, buf_size));
@@ -64,29 +126,23 @@ void AudioData::LoadFromFile(const CU_STR& filepath)
 			throw Exception("Not enough memory.");
 		}
 
-		// Copy memory into new part of memory.
-		memcpy(m_data + m_size, decoder->GetBuffer(), decoded);
-
-		// Overflow check.
-		if (static_cast<unsigned int>(m_size) > std::numeric_limits<size_t>::max() - decoded)
-		{
-			free(m_data);
-			throw Exception("Not enough memory.");
+		// Decode into the new part of memory.
+		int decoded = decoder->Decode(m_data + m_size, chunk);
+		if (decoded <= 0) {
+			break;
 		}
 
 		// Keep this up to date.
 		m_size += decoded;
-
-		decoded = decoder->Decode();
 	}
 
 	if (m_data && buf_size > static_cast<size_t>(m_size)) {
 		m_data = static_cast<uint8_t*>(realloc(m_data, m_size));
 	}
 
-	m_sample_rate = decoder->GetSampleRate();
-	m_channels = decoder->GetChannels();
-	m_bit_depth = decoder->GetBitDepth();
+	if (storage == STORE_IMA_ADPCM) {
+		Compress();
+	}
 }
 
 void AudioData::LoadFromList(const CU_VEC<ua::AudioData*>& list)
@@ -105,7 +161,9 @@ void AudioData::LoadFromList(const CU_VEC<ua::AudioData*>& list)
 		m_sample_rate = src->m_sample_rate;
 		m_channels = src->m_channels;
 		m_bit_depth = src->m_bit_depth;
-		if (sz == 1) {
+		m_block_align = src->m_block_align;
+		m_frames = src->m_frames;
+		if (sz == 1 || m_block_align != 0) {
 			return;
 		}
 	}
@@ -152,4 +210,32 @@ void AudioData::LoadFromList(const CU_VEC<ua::AudioData*>& list)
 	}
 }
 
+
+void AudioData::Compress()
+{
+	if (!m_data || m_bit_depth != 16 || !ImaAdpcm::IsValid(m_channels, ImaAdpcm::BLOCK_ALIGN * m_channels)) {
+		return;
+	}
+
+	const int block_align = ImaAdpcm::BLOCK_ALIGN * m_channels;
+	const int64_t frames = m_size / (m_channels * 2);
+	const size_t size = ImaAdpcm::GetEncodedSize(frames, m_channels, block_align);
+	uint8_t* blocks = static_cast<uint8_t*>(malloc(size));
+	if (!blocks) {
+		throw Exception("Not enough memory.");
+	}
+	ImaAdpcm::Encode(blocks, reinterpret_cast<const int16_t*>(m_data), frames, m_channels, block_align);
+
+	if (m_mapped) {
+		m_mapped.reset();
+	} else {
+		free(m_data);
+	}
+	m_data = blocks;
+	m_size = static_cast<int>(size);
+	m_bit_depth = 4;
+	m_block_align = block_align;
+	m_frames = frames;
+}
+
 }
\ No newline at end of file
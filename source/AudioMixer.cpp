@@ -1,4 +1,8 @@
 #include "uniaudio/AudioMixer.h"
+#include "uniaudio/MixKernel.h"
+#include "uniaudio/Limiter.h"
+#include "uniaudio/Resampler.h"
+#include "uniaudio/GainRamp.h"
 #include "uniaudio/Exception.h"
 
 #include <algorithm>
@@ -8,152 +12,631 @@
 namespace ua
 {
 
-AudioMixer::AudioMixer(float buf_time_len)
-	: m_dirty(false)
+namespace
 {
-	m_samples = static_cast<int>(DEFAULT_SAMPLE_RATE * buf_time_len);
-	m_mix_buffer = new int32_t[m_samples * DEFAULT_CHANNELS];
-	if (m_mix_buffer) {
-		memset(m_mix_buffer, 0, sizeof(int32_t) * m_samples * DEFAULT_CHANNELS);
-	} else {
-		throw Exception("Could not create m_mix_buffer.");
+
+void mix_direct(const MixKernel& k, int32_t* dst, const int8_t* src, int frames, int channel, float gain, float step)
+{
+	(channel == 1 ? k.mix_s8_mono : k.mix_s8_stereo)(dst, src, frames, gain, step);
+}
+
+void mix_direct(const MixKernel& k, int32_t* dst, const int16_t* src, int frames, int channel, float gain, float step)
+{
+	(channel == 1 ? k.mix_s16_mono : k.mix_s16_stereo)(dst, src, frames, gain, step);
+}
+
+void mix_direct(const MixKernel& k, float* dst, const int8_t* src, int frames, int channel, float gain, float step)
+{
+	(channel == 1 ? k.mix_s8_mono_f32 : k.mix_s8_stereo_f32)(dst, src, frames, gain, step);
+}
+
+void mix_direct(const MixKernel& k, float* dst, const int16_t* src, int frames, int channel, float gain, float step)
+{
+	(channel == 1 ? k.mix_s16_mono_f32 : k.mix_s16_stereo_f32)(dst, src, frames, gain, step);
+}
+
+// zero-order hold, each source frame is repeated for `repeat` frames,
+// `first` is the index of dst's first frame in the up-sampled stream
+template <int CH, typename D, typename T>
+void mix_repeat(D* dst, const T* src, int first, int dst_frames, int repeat, float gain, float step)
+{
+	for (int i = 0; i < dst_frames; ++i)
+	{
+		const T* s = src + (first + i) / repeat * CH;
+		const float g = gain + step * static_cast<float>(i);
+		D l = static_cast<D>(s[0] * g);
+		D r = CH == 2 ? static_cast<D>(s[1] * g) : l;
+		*dst++ += l;
+		*dst++ += r;
 	}
-	m_out_buffer = new int16_t[m_samples * DEFAULT_CHANNELS];
-	if (m_out_buffer) {
-		memset(m_out_buffer, 0, sizeof(int16_t) * m_samples * DEFAULT_CHANNELS);
+}
+
+// One instance per voice format, the channel and repeat branches are
+// resolved at compile time.
+template <typename D, typename T, int CH, bool REPEAT>
+void mix(const MixKernel& k, void* bus, const uint8_t* buf, int first, int frames, int repeat,
+         float gain, float step)
+{
+	D* dst = static_cast<D*>(bus) + first * 2;
+	const T* src = reinterpret_cast<const T*>(buf);
+	if (REPEAT) {
+		mix_repeat<CH>(dst, src, first, frames, repeat, gain, step);
 	} else {
-		throw Exception("Could not create m_out_buffer.");
+		mix_direct(k, dst, src + first * CH, frames, CH, gain, step);
+	}
+}
+
+// [bus][bit depth 8, 16][channel 1, 2][direct, repeat]
+constexpr AudioMixer::MixFunc MIX_TABLE[2][2][2][2] =
+{
+	{
+		{
+			{ mix<int32_t, int8_t, 1, false>, mix<int32_t, int8_t, 1, true> },
+			{ mix<int32_t, int8_t, 2, false>, mix<int32_t, int8_t, 2, true> },
+		},
+		{
+			{ mix<int32_t, int16_t, 1, false>, mix<int32_t, int16_t, 1, true> },
+			{ mix<int32_t, int16_t, 2, false>, mix<int32_t, int16_t, 2, true> },
+		},
+	},
+	{
+		{
+			{ mix<float, int8_t, 1, false>, mix<float, int8_t, 1, true> },
+			{ mix<float, int8_t, 2, false>, mix<float, int8_t, 2, true> },
+		},
+		{
+			{ mix<float, int16_t, 1, false>, mix<float, int16_t, 1, true> },
+			{ mix<float, int16_t, 2, false>, mix<float, int16_t, 2, true> },
+		},
+	},
+};
+
+// `count` T on a cache line, freed with free_aligned()
+template <typename T>
+T* new_aligned(int count, int align)
+{
+	uint8_t* raw = new uint8_t[sizeof(T) * count + align + sizeof(void*)];
+	if (!raw) {
+		return nullptr;
+	}
+	uintptr_t ptr = reinterpret_cast<uintptr_t>(raw + sizeof(void*));
+	ptr = (ptr + align - 1) & ~static_cast<uintptr_t>(align - 1);
+	reinterpret_cast<uint8_t**>(ptr)[-1] = raw;
+	return reinterpret_cast<T*>(ptr);
+}
+
+void free_aligned(void* ptr)
+{
+	delete[] static_cast<uint8_t**>(ptr)[-1];
+}
+
+// the int32 bus has no kernel for this, submixes are meant for the float one
+void add_ramp_s32(int32_t* dst, const int32_t* src, int frames, float gain, float step)
+{
+	for (int i = 0, n = frames * 2; i < n; ++i) {
+		dst[i] += static_cast<int32_t>(src[i] * (gain + step * static_cast<float>(i / 2)));
+	}
+}
+
+// dst += src with a gain per channel
+template <typename D>
+void add_pan(D* dst, const D* src, int frames, float left, float right)
+{
+	for (int i = 0; i < frames; ++i, dst += 2, src += 2) {
+		dst[0] += static_cast<D>(src[0] * left);
+		dst[1] += static_cast<D>(src[1] * right);
+	}
+}
+
+// int32 bus to float output, same clipping as clamp_s16
+void to_f32(float* dst, const int32_t* src, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		int32_t v = std::min(std::max(src[i], -32768), 32767);
+		dst[i] = v * (1.0f / 32768);
+	}
+}
+
+// stereo to mono, average of the two channels
+template <typename T>
+void fold_mono(T* dst, const T* src, int frames)
+{
+	for (int i = 0; i < frames; ++i, src += 2) {
+		dst[i] = static_cast<T>((src[0] + src[1]) / 2);
 	}
 }
 
+}
+
+AudioMixer::AudioMixer(float buf_time_len, Bus bus)
+	: m_kernel(&MixKernel::Get())
+	, m_format(DEFAULT_SAMPLE_RATE, DEFAULT_CHANNELS)
+	, m_bus(bus)
+{
+	Init(buf_time_len);
+}
+
+AudioMixer::AudioMixer(float buf_time_len, const OutputFormat& fmt, Bus bus)
+	: m_kernel(&MixKernel::Get())
+	, m_format(fmt)
+	, m_bus(bus)
+{
+	if (m_format.sample_rate == 0) {
+		m_format.sample_rate = DEFAULT_SAMPLE_RATE;
+	}
+	if (m_format.channels == 0) {
+		m_format.channels = DEFAULT_CHANNELS;
+	}
+	if (m_format.channels != 1 && m_format.channels != 2) {
+		throw Exception("AudioMixer unsupported channels: %d.", m_format.channels);
+	}
+	Init(buf_time_len);
+}
+
 AudioMixer::~AudioMixer()
 {
 	if (m_mix_buffer) {
-		delete[] m_mix_buffer;
+		free_aligned(m_mix_buffer);
 	}
 	if (m_out_buffer) {
 		delete[] m_out_buffer;
 	}
+	if (m_mix_buffer_f) {
+		free_aligned(m_mix_buffer_f);
+	}
+	if (m_limiter) {
+		delete m_limiter;
+	}
+	if (m_resample_buffer) {
+		delete[] m_resample_buffer;
+	}
+	if (m_stage_buffer) {
+		delete[] m_stage_buffer;
+	}
+	if (m_pan_buffer) {
+		free_aligned(m_pan_buffer);
+	}
+}
+
+void AudioMixer::Init(float buf_time_len)
+{
+	m_mix_buffer      = nullptr;
+	m_out_buffer      = nullptr;
+	m_stage_buffer    = nullptr;
+	m_mix_buffer_f    = nullptr;
+	m_limiter         = nullptr;
+	m_resample_buffer = nullptr;
+	m_pan_buffer      = nullptr;
+	m_dirty_begin     = 0;
+	m_dirty_end       = 0;
+	m_tail_dirty      = false;
+	m_out_begin       = 0;
+	m_out_end         = 0;
+
+	m_samples = static_cast<int>(m_format.sample_rate * buf_time_len);
+	if (m_bus == BUS_FLOAT32)
+	{
+		const int sz = (Limiter::LOOKAHEAD + m_samples) * BUS_CHANNELS;
+		m_mix_buffer_f = new_aligned<float>(sz, CACHE_LINE);
+		if (m_mix_buffer_f) {
+			memset(m_mix_buffer_f, 0, sizeof(float) * sz);
+		} else {
+			throw Exception("Could not create m_mix_buffer_f.");
+		}
+		m_limiter = new Limiter(BUS_CHANNELS, m_format.sample_rate);
+	}
+	else
+	{
+		m_mix_buffer = new_aligned<int32_t>(m_samples * BUS_CHANNELS, CACHE_LINE);
+		if (m_mix_buffer) {
+			memset(m_mix_buffer, 0, sizeof(int32_t) * m_samples * BUS_CHANNELS);
+		} else {
+			throw Exception("Could not create m_mix_buffer.");
+		}
+		m_resample_buffer = new float[m_samples * BUS_CHANNELS];
+		if (!m_resample_buffer) {
+			throw Exception("Could not create m_resample_buffer.");
+		}
+	}
+
+	// float or int32 bus frames
+	m_pan_buffer = new_aligned<float>(m_samples * BUS_CHANNELS, CACHE_LINE);
+	if (!m_pan_buffer) {
+		throw Exception("Could not create m_pan_buffer.");
+	}
+
+	m_out_buffer = new uint8_t[GetBufSize()];
+	if (m_out_buffer) {
+		memset(m_out_buffer, 0, GetBufSize());
+	} else {
+		throw Exception("Could not create m_out_buffer.");
+	}
+	if (m_format.channels != BUS_CHANNELS)
+	{
+		m_stage_buffer = new uint8_t[m_format.GetBytesPerSample() * BUS_CHANNELS * m_samples];
+		if (!m_stage_buffer) {
+			throw Exception("Could not create m_stage_buffer.");
+		}
+	}
 }
 
 void AudioMixer::Input(const uint8_t* buf, int buf_sz, int sample_rate, int bit_depth, int channel, float volume)
 {
-	m_dirty = true;
-	MixFast(buf, buf_sz, sample_rate, bit_depth, channel, volume);
+	GainRamp ramp;
+	ramp.Start(volume);
+	Input(buf, buf_sz, sample_rate, bit_depth, channel, ramp);
 }
 
-void AudioMixer::MixFast(const uint8_t* buf, int buf_sz, int sample_rate, int bit_depth, int channel, float volume)
+void AudioMixer::Input(const uint8_t* buf, int buf_sz, int sample_rate, int bit_depth, int channel, GainRamp& ramp)
 {
-	// simple up-sampling, must be divisible
-	if (DEFAULT_SAMPLE_RATE % sample_rate) {
-		return;
+	Voice voice = GetVoice(sample_rate, bit_depth, channel);
+	if (voice.IsValid()) {
+		Input(buf, buf_sz, voice, ramp);
 	}
+}
 
-	int up_sample_rate = DEFAULT_SAMPLE_RATE / sample_rate;
-	if (channel == 1) {
-		up_sample_rate *= 2;
+void AudioMixer::Input(const uint8_t* buf, int buf_sz, const Voice& voice, GainRamp& ramp)
+{
+	assert(voice.IsValid());
+	const int frames = MixVoice(buf, buf_sz / voice.frame_size, voice, ramp, GetBusBuffer());
+	if (frames > 0) {
+		MarkDirty(0, frames);
 	}
+}
 
-	int32_t* dst_ptr = m_mix_buffer;
-	if (bit_depth == 8)
+void AudioMixer::Input(Resampler& resampler, float volume)
+{
+	GainRamp ramp;
+	ramp.Start(volume);
+	Input(resampler, ramp);
+}
+
+void AudioMixer::Input(Resampler& resampler, GainRamp& ramp)
+{
+	const int frames = MixResampler(resampler, ramp, GetBusBuffer());
+	if (frames > 0) {
+		MarkDirty(0, frames);
+	}
+}
+
+void AudioMixer::Input(const Batch& batch)
+{
+	void* bus = GetBusBuffer();
+	for (int i = 0, n = batch.Size(); i < n; ++i)
 	{
-		const int8_t* src_ptr = reinterpret_cast<const int8_t*>(buf);
-		int count = 0;
-		for (int i = 0, n = m_samples * DEFAULT_CHANNELS; i < n; ++i, ++dst_ptr) {
-			*dst_ptr += static_cast<int32_t>((*src_ptr) * volume);
-			if (++count == up_sample_rate) {
-				count = 0;
-				++src_ptr;
+		// panned voices go through m_pan_buffer
+		const float pan = batch.pans[i];
+		void* dst = bus;
+		if (pan != 0) {
+			dst = m_pan_buffer;
+			memset(m_pan_buffer, 0, sizeof(float) * m_samples * BUS_CHANNELS);
+		}
+
+		int frames;
+		if (Resampler* resampler = batch.resamplers[i]) {
+			frames = MixResampler(*resampler, *batch.ramps[i], dst);
+		} else {
+			frames = MixVoice(batch.bufs[i], batch.frames[i], *batch.voices[i], *batch.ramps[i], dst);
+		}
+		if (frames <= 0) {
+			continue;
+		}
+		MarkDirty(0, frames);
+
+		if (pan != 0)
+		{
+			// balance, the center is unity
+			const float left = std::min(1 - pan, 1.0f), right = std::min(1 + pan, 1.0f);
+			if (m_bus == BUS_FLOAT32) {
+				add_pan(static_cast<float*>(bus), static_cast<const float*>(dst), frames, left, right);
+			} else {
+				add_pan(static_cast<int32_t*>(bus), static_cast<const int32_t*>(dst), frames, left, right);
 			}
 		}
 	}
-	else if (bit_depth == 16)
+}
+
+int AudioMixer::MixVoice(const uint8_t* buf, int frames, const Voice& voice, GainRamp& ramp, void* bus)
+{
+	if (!voice.IsValid()) {
+		return 0;
+	}
+
+	const int dst_frames = std::min(frames * voice.repeat, m_samples);
+
+	// one call per segment of the ramp
+	for (int i = 0; i < dst_frames; )
 	{
-		const int16_t* src_ptr = reinterpret_cast<const int16_t*>(buf);
-		int count = 0;
-		for (int i = 0, n = m_samples * DEFAULT_CHANNELS; i < n; ++i, ++dst_ptr) {
-			*dst_ptr += static_cast<int32_t>((*src_ptr) * volume);
-			if (++count == up_sample_rate) {
-				count = 0;
-				++src_ptr;
-			}
-		}
+		float gain, step;
+		const int n = ramp.Next(dst_frames - i, gain, step);
+		voice.func(*m_kernel, bus, buf, i, n, voice.repeat, gain * voice.scale, step * voice.scale);
+		i += n;
 	}
+
+	return dst_frames;
 }
 
-void AudioMixer::MixSlow(const uint8_t* buf, int buf_sz, int sample_rate, int bit_depth, int channel, float volume)
+int AudioMixer::MixResampler(Resampler& resampler, GainRamp& ramp, void* bus)
 {
-	assert((bit_depth == 8 || bit_depth == 16)
-		&& (channel == 1 || channel == 2));
+	assert(resampler.GetDstRate() == m_format.sample_rate);
 
-	const int src_samples = buf_sz / bit_depth / channel;
-	const int dst_samples = src_samples * DEFAULT_SAMPLE_RATE / sample_rate;
-	int32_t* ptr = m_mix_buffer;
-	if (channel == 1)
+	const int frames = std::min(m_samples, resampler.GetAvailableFrames());
+	if (frames == 0) {
+		return 0;
+	}
+
+	float* dst;
+	float scale;
+	if (m_bus == BUS_FLOAT32) {
+		dst = static_cast<float*>(bus);
+		scale = 1;
+	} else {
+		dst = m_resample_buffer;
+		scale = 32768.0f;
+		memset(m_resample_buffer, 0, sizeof(float) * frames * BUS_CHANNELS);
+	}
+
+	for (int i = 0; i < frames; )
 	{
-		if (bit_depth == 8)
-		{
-			for (int i = 0; i < dst_samples; ++i)
-			{
-				int src_idx = i * sample_rate / DEFAULT_SAMPLE_RATE;
-				int src_val = static_cast<int>(buf[src_idx] * volume);
-				*ptr++ = src_val;
-				*ptr++ = src_val;
-			}
+		float gain, step;
+		int n = ramp.Next(frames - i, gain, step);
+		resampler.Process(dst + i * BUS_CHANNELS, n, gain * scale, step * scale, *m_kernel);
+		i += n;
+	}
+
+	if (m_bus == BUS_INT32)
+	{
+		int32_t* ptr = static_cast<int32_t*>(bus);
+		for (int i = 0, n = frames * BUS_CHANNELS; i < n; ++i) {
+			ptr[i] += static_cast<int32_t>(m_resample_buffer[i]);
 		}
-		else // bit_depth == 16
+	}
+
+	return frames;
+}
+
+void* AudioMixer::GetBusBuffer()
+{
+	if (m_bus == BUS_FLOAT32) {
+		return m_mix_buffer_f + Limiter::LOOKAHEAD * BUS_CHANNELS;
+	} else {
+		return m_mix_buffer;
+	}
+}
+
+AudioMixer::Voice AudioMixer::GetVoice(int sample_rate, int bit_depth, int channel) const
+{
+	Voice voice;
+
+	if (sample_rate <= 0
+	 || (bit_depth != 8 && bit_depth != 16)
+	 || (channel != 1 && channel != 2)) {
+		return voice;
+	}
+
+	voice.sample_rate = sample_rate;
+	voice.bit_depth = bit_depth;
+	voice.frame_size = bit_depth / 8 * channel;
+	// left invalid, the voice needs a Resampler
+	if (m_format.sample_rate % sample_rate != 0) {
+		return voice;
+	}
+
+	voice.repeat = m_format.sample_rate / sample_rate;
+	voice.func = MIX_TABLE[m_bus == BUS_FLOAT32][bit_depth == 16][channel - 1][voice.repeat > 1];
+	// normalize to [-1, 1) on the float bus
+	voice.scale = 1;
+	if (m_bus == BUS_FLOAT32) {
+		voice.scale = bit_depth == 8 ? 1 / 128.0f : 1 / 32768.0f;
+	}
+
+	return voice;
+}
+
+void AudioMixer::Batch::Add(const uint8_t* buf, int frames, const Voice& voice, GainRamp& ramp, float pan)
+{
+	bufs.push_back(buf);
+	this->frames.push_back(frames);
+	voices.push_back(&voice);
+	resamplers.push_back(nullptr);
+	ramps.push_back(&ramp);
+	pans.push_back(pan);
+}
+
+void AudioMixer::Batch::Add(Resampler& resampler, GainRamp& ramp, float pan)
+{
+	bufs.push_back(nullptr);
+	frames.push_back(0);
+	voices.push_back(nullptr);
+	resamplers.push_back(&resampler);
+	ramps.push_back(&ramp);
+	pans.push_back(pan);
+}
+
+void AudioMixer::Batch::Add(const Batch& batch, int i)
+{
+	bufs.push_back(batch.bufs[i]);
+	frames.push_back(batch.frames[i]);
+	voices.push_back(batch.voices[i]);
+	resamplers.push_back(batch.resamplers[i]);
+	ramps.push_back(batch.ramps[i]);
+	pans.push_back(batch.pans[i]);
+}
+
+void AudioMixer::Batch::Clear()
+{
+	bufs.clear();
+	frames.clear();
+	voices.clear();
+	resamplers.clear();
+	ramps.clear();
+	pans.clear();
+}
+
+int AudioMixer::Batch::GetCost(int i) const
+{
+	// per output frame
+	return resamplers[i] ? resamplers[i]->GetTaps() : 1;
+}
+
+void AudioMixer::Merge(const AudioMixer& mixer)
+{
+	assert(mixer.m_bus == m_bus && mixer.m_samples == m_samples);
+
+	const int begin = mixer.m_dirty_begin, end = mixer.m_dirty_end;
+	if (begin >= end) {
+		return;
+	}
+	MarkDirty(begin, end);
+
+	const int offset = begin * BUS_CHANNELS;
+	const int count = (end - begin) * BUS_CHANNELS;
+	if (m_bus == BUS_FLOAT32) {
+		const int head = Limiter::LOOKAHEAD * BUS_CHANNELS;
+		m_kernel->add_f32(m_mix_buffer_f + head + offset, mixer.m_mix_buffer_f + head + offset, count);
+	} else {
+		m_kernel->add_s32(m_mix_buffer + offset, mixer.m_mix_buffer + offset, count);
+	}
+}
+
+void AudioMixer::Merge(const AudioMixer& mixer, GainRamp& ramp)
+{
+	assert(mixer.m_bus == m_bus && mixer.m_samples == m_samples);
+
+	const int begin = mixer.m_dirty_begin, end = mixer.m_dirty_end;
+	if (begin < end) {
+		MarkDirty(begin, end);
+	}
+
+	const int head = m_bus == BUS_FLOAT32 ? Limiter::LOOKAHEAD * BUS_CHANNELS : 0;
+	for (int i = 0; i < m_samples; )
+	{
+		float gain, step;
+		const int n = ramp.Next(m_samples - i, gain, step);
+
+		// the part of the segment in the dirty range
+		const int first = std::max(i, begin), last = std::min(i + n, end);
+		if (first < last)
 		{
-			for (int i = 0; i < dst_samples; ++i)
-			{
-				int src_idx = i * sample_rate / DEFAULT_SAMPLE_RATE;
-				int src_val = static_cast<int>(((const int16_t*)buf)[src_idx] * volume);
-				*ptr++ = src_val;
-				*ptr++ = src_val;
+			const int offset = head + first * BUS_CHANNELS;
+			gain += step * (first - i);
+			if (m_bus == BUS_FLOAT32) {
+				m_kernel->add_ramp_f32(m_mix_buffer_f + offset, mixer.m_mix_buffer_f + offset, last - first, gain, step);
+			} else {
+				add_ramp_s32(m_mix_buffer + offset, mixer.m_mix_buffer + offset, last - first, gain, step);
 			}
 		}
+		i += n;
 	}
-	else // channel == 2
+}
+
+void AudioMixer::ApplyEffect(Effect effect, void* ud)
+{
+	if (m_bus != BUS_FLOAT32) {
+		return;
+	}
+	effect(m_mix_buffer_f + Limiter::LOOKAHEAD * BUS_CHANNELS, m_samples, ud);
+	MarkDirty(0, m_samples);
+}
+
+void* AudioMixer::Output()
+{
+	const bool fold = m_format.channels != BUS_CHANNELS;
+	uint8_t* dst = fold ? m_stage_buffer : m_out_buffer;
+	const bool f32 = m_format.sample_fmt == OutputFormat::SAMPLE_F32;
+
+	// frames to write, the others are silent
+	int begin = m_dirty_begin, end = m_dirty_end;
+	if (m_bus == BUS_FLOAT32)
 	{
-		if (bit_depth == 8)
+		// limiting and conversion in one pass, the limiter delays and
+		// releases across the whole block
+		if (begin < end || m_tail_dirty)
 		{
-			for (int i = 0; i < dst_samples; ++i)
-			{
-				int src_idx = i * sample_rate / DEFAULT_SAMPLE_RATE * 2;
-				int src_val = static_cast<int>(buf[src_idx] * volume);
-				*ptr++ = src_val;
-				src_val = static_cast<int>(buf[src_idx + 1]);
-				*ptr++ = src_val;
+			begin = 0;
+			end = m_samples;
+			if (f32) {
+				m_limiter->Process(reinterpret_cast<float*>(dst), m_mix_buffer_f, m_samples, *m_kernel);
+			} else {
+				m_limiter->Process(reinterpret_cast<int16_t*>(dst), m_mix_buffer_f, m_samples, *m_kernel);
 			}
 		}
-		else // bit_depth == 16
+		else
 		{
-			for (int i = 0; i < dst_samples; ++i)
-			{
-				int src_idx = i * sample_rate / DEFAULT_SAMPLE_RATE * 2;
-				int src_val = static_cast<int>(((const int16_t*)buf)[src_idx] * volume);
-				*ptr++ = src_val;
-				src_val = static_cast<int>(((const int16_t*)buf)[src_idx + 1]);
-				*ptr++ = src_val;
-			}
+			m_limiter->Reset();
+		}
+		m_tail_dirty = m_dirty_end > m_samples - Limiter::LOOKAHEAD;
+	}
+	else if (begin < end)
+	{
+		const int offset = begin * BUS_CHANNELS;
+		const int count = (end - begin) * BUS_CHANNELS;
+		if (f32) {
+			to_f32(reinterpret_cast<float*>(dst) + offset, m_mix_buffer + offset, count);
+		} else {
+			m_kernel->clamp_s16(reinterpret_cast<int16_t*>(dst) + offset, m_mix_buffer + offset, count);
 		}
 	}
-}
 
-int16_t* AudioMixer::Output()
-{
-	if (m_dirty) {
-		for (int i = 0, n = m_samples * DEFAULT_CHANNELS; i < n; ++i) {
-			m_out_buffer[i] = std::min(std::max(-32768, m_mix_buffer[i]), 32767);
+	ClearOutput(begin, end);
+
+	if (fold && begin < end)
+	{
+		if (f32) {
+			fold_mono(reinterpret_cast<float*>(m_out_buffer) + begin,
+				reinterpret_cast<const float*>(dst) + begin * BUS_CHANNELS, end - begin);
+		} else {
+			fold_mono(reinterpret_cast<int16_t*>(m_out_buffer) + begin,
+				reinterpret_cast<const int16_t*>(dst) + begin * BUS_CHANNELS, end - begin);
 		}
 	}
+
 	return m_out_buffer;
 }
 
 void AudioMixer::Reset()
 {
-	m_dirty = false;
-	memset(m_mix_buffer, 0, sizeof(int32_t) * m_samples * DEFAULT_CHANNELS);
-	memset(m_out_buffer, 0, sizeof(int16_t) * m_samples * DEFAULT_CHANNELS);
+	if (m_dirty_begin < m_dirty_end)
+	{
+		const int offset = m_dirty_begin * BUS_CHANNELS;
+		const int count = (m_dirty_end - m_dirty_begin) * BUS_CHANNELS;
+		if (m_bus == BUS_FLOAT32) {
+			// keep the delayed frames
+			memset(m_mix_buffer_f + Limiter::LOOKAHEAD * BUS_CHANNELS + offset, 0, sizeof(float) * count);
+		} else {
+			memset(m_mix_buffer + offset, 0, sizeof(int32_t) * count);
+		}
+	}
+	m_dirty_begin = m_dirty_end = 0;
+}
+
+void AudioMixer::MarkDirty(int begin, int end)
+{
+	if (m_dirty_begin < m_dirty_end) {
+		m_dirty_begin = std::min(m_dirty_begin, begin);
+		m_dirty_end = std::max(m_dirty_end, end);
+	} else {
+		m_dirty_begin = begin;
+		m_dirty_end = end;
+	}
+}
+
+void AudioMixer::ClearOutput(int begin, int end)
+{
+	const int frame_sz = m_format.GetFrameSize();
+	if (begin >= end) {
+		begin = end = m_out_end;
+	}
+	if (m_out_begin < begin) {
+		const int last = std::min(m_out_end, begin);
+		memset(m_out_buffer + m_out_begin * frame_sz, 0, (last - m_out_begin) * frame_sz);
+	}
+	if (m_out_end > end) {
+		const int first = std::max(m_out_begin, end);
+		memset(m_out_buffer + first * frame_sz, 0, (m_out_end - first) * frame_sz);
+	}
+	m_out_begin = begin;
+	m_out_end = end;
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "uniaudio/BufferPool.h"
+#include "uniaudio/Exception.h"
+
+#include <stdlib.h>
+
+namespace ua
+{
+
+// the malloc() pointer is kept before the aligned block
+static void*
+alloc_aligned(size_t size, size_t align)
+{
+	uint8_t* mem = static_cast<uint8_t*>(malloc(size + align + sizeof(void*)));
+	if (!mem) {
+		return nullptr;
+	}
+	uintptr_t addr = reinterpret_cast<uintptr_t>(mem + sizeof(void*));
+	addr = (addr + align - 1) & ~static_cast<uintptr_t>(align - 1);
+	reinterpret_cast<void**>(addr)[-1] = mem;
+	return reinterpret_cast<void*>(addr);
+}
+
+static void
+free_aligned(void* ptr)
+{
+	free(static_cast<void**>(ptr)[-1]);
+}
+
+BufferPool::BufferPool(size_t slab_size)
+	: m_mem(nullptr)
+	, m_slab(nullptr)
+	, m_capacity(slab_size)
+	, m_carved(0)
+	, m_used(0)
+	, m_overflow(0)
+{
+	for (int i = 0; i < CLASS_COUNT; ++i) {
+		m_free[i] = nullptr;
+	}
+
+	m_mem = static_cast<uint8_t*>(malloc(m_capacity + CACHE_LINE));
+	if (!m_mem) {
+		throw Exception("Could not create BufferPool slab.");
+	}
+	uintptr_t addr = reinterpret_cast<uintptr_t>(m_mem);
+	m_slab = m_mem + ((CACHE_LINE - (addr & (CACHE_LINE - 1))) & (CACHE_LINE - 1));
+}
+
+BufferPool::~BufferPool()
+{
+	free(m_mem);
+}
+
+void* BufferPool::Alloc(size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const int cls = GetClass(size);
+	if (cls >= 0)
+	{
+		const size_t block = MIN_BLOCK << cls;
+		if (void* ptr = m_free[cls])
+		{
+			m_free[cls] = *static_cast<void**>(ptr);
+			m_used += block;
+			return ptr;
+		}
+		if (m_carved + block <= m_capacity)
+		{
+			void* ptr = m_slab + m_carved;
+			m_carved += block;
+			m_used += block;
+			return ptr;
+		}
+	}
+
+	void* ptr = alloc_aligned(size, CACHE_LINE);
+	if (!ptr) {
+		throw Exception("BufferPool malloc fail.");
+	}
+	m_overflow += size;
+	return ptr;
+}
+
+void BufferPool::Free(void* ptr, size_t size)
+{
+	if (!ptr) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!IsInSlab(ptr))
+	{
+		free_aligned(ptr);
+		m_overflow -= size;
+		return;
+	}
+
+	const int cls = GetClass(size);
+	*static_cast<void**>(ptr) = m_free[cls];
+	m_free[cls] = ptr;
+	m_used -= MIN_BLOCK << cls;
+}
+
+size_t BufferPool::GetCapacity() const
+{
+	return m_capacity;
+}
+
+size_t BufferPool::GetCarved() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_carved;
+}
+
+size_t BufferPool::GetUsed() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_used;
+}
+
+size_t BufferPool::GetOverflow() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_overflow;
+}
+
+int BufferPool::GetClass(size_t size)
+{
+	int cls = 0;
+	size_t block = MIN_BLOCK;
+	while (block < size)
+	{
+		if (++cls == CLASS_COUNT) {
+			return -1;
+		}
+		block <<= 1;
+	}
+	return cls;
+}
+
+bool BufferPool::IsInSlab(const void* ptr) const
+{
+	const uint8_t* p = static_cast<const uint8_t*>(ptr);
+	return p >= m_slab && p < m_slab + m_capacity;
+}
+
+}
\ No newline at end of file
@@ -19,6 +19,7 @@ OSStatus read_func(void* in_client_data, SInt64 in_position, UInt32 request_coun
 	if (bytes_left > 0)
 	{
 		UInt32 actual_size = bytes_left >= request_count ? request_count : (UInt32) bytes_left;
+		Decoder::IoTimer timer(data->decoder);
 		fs_seek_from_head(data->file, in_position);
 		fs_read(data->file, buffer, actual_size);
 		*actual_count = actual_size;
@@ -69,19 +70,19 @@ Decoder* CoreAudioDecoder::Clone()
 	return new CoreAudioDecoder(*this);
 }
 
-int CoreAudioDecoder::Decode()
+int CoreAudioDecoder::Decode(unsigned char* dst, int buf_sz)
 {
 	int size = 0;
 
-	while (size < m_buf_size)
+	while (buf_sz - size >= static_cast<int>(m_output_info.mBytesPerFrame))
 	{
 		AudioBufferList data_buffer;
 		data_buffer.mNumberBuffers = 1;
-		data_buffer.mBuffers[0].mDataByteSize = m_buf_size - size;
-		data_buffer.mBuffers[0].mData = (char *) m_buf + size;
+		data_buffer.mBuffers[0].mDataByteSize = buf_sz - size;
+		data_buffer.mBuffers[0].mData = (char *) dst + size;
 		data_buffer.mBuffers[0].mNumberChannels = m_output_info.mChannelsPerFrame;
 
-		UInt32 frames = (m_buf_size - size) / m_output_info.mBytesPerFrame;
+		UInt32 frames = (buf_sz - size) / m_output_info.mBytesPerFrame;
 
 		if (ExtAudioFileRead(m_ext_audio_file, &frames, &data_buffer) != noErr) {
 			return size;
@@ -229,6 +230,7 @@ void CoreAudioDecoder::Init()
 			throw Exception("Could not open file: %s", m_filepath.c_str());
 		}
 		m_source.size = fs_size(m_source.file);
+		m_source.decoder = this;
 		
 		OSStatus err = noErr;
 
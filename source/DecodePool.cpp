@@ -0,0 +1,172 @@
+#include "uniaudio/DecodePool.h"
+#include "uniaudio/InputBuffer.h"
+#include "uniaudio/OutputBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace ua
+{
+
+// seconds until `obuf` runs dry, lock-free
+static float
+get_headroom(const OutputBuffer* obuf, int bytes_per_sec)
+{
+	return bytes_per_sec > 0 ? static_cast<float>(obuf->GetFilled()) / bytes_per_sec : 0;
+}
+
+DecodePool::DecodePool(int threads, float period)
+	: m_period(period)
+	, m_loads(threads, 0)
+	, m_busy(threads, nullptr)
+	, m_next_id(0)
+	, m_generation(0)
+	, m_quit(false)
+{
+	for (int i = 0; i < threads; ++i) {
+		m_threads.push_back(std::thread(&DecodePool::WorkerLoop, this, i));
+	}
+}
+
+DecodePool::~DecodePool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_start_cond.notify_all();
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void DecodePool::Add(InputBuffer* ibuf, OutputBuffer* obuf)
+{
+	const int bytes_per_sec = ibuf->GetBytesPerSec();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (auto& s : m_streams) {
+			if (s.ibuf == ibuf) {
+				return;
+			}
+		}
+
+		Stream s;
+		s.id     = m_next_id++;
+		s.ibuf   = ibuf;
+		s.obuf   = obuf;
+		s.bytes_per_sec = bytes_per_sec;
+		s.worker = static_cast<int>(std::min_element(m_loads.begin(), m_loads.end()) - m_loads.begin());
+		++m_loads[s.worker];
+		m_streams.push_back(s);
+
+		++m_generation;
+	}
+	m_start_cond.notify_all();
+}
+
+void DecodePool::Remove(InputBuffer* ibuf)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto itr = m_streams.begin(); itr != m_streams.end(); ++itr)
+	{
+		if (itr->ibuf == ibuf) {
+			--m_loads[itr->worker];
+			m_streams.erase(itr);
+			break;
+		}
+	}
+}
+
+bool DecodePool::IsBusy(const InputBuffer* ibuf)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return std::find(m_busy.begin(), m_busy.end(), ibuf) != m_busy.end();
+}
+
+void DecodePool::Wakeup()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_generation;
+	}
+	m_start_cond.notify_all();
+}
+
+void DecodePool::WorkerLoop(int id)
+{
+	const auto period = std::chrono::microseconds(static_cast<int64_t>(m_period * 1000000));
+
+	// min-heap by headroom
+	auto later = [](const Urgent& a, const Urgent& b) {
+		return a.headroom > b.headroom;
+	};
+	CU_VEC<Urgent> queue;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	uint32_t generation = m_generation;
+	while (!m_quit)
+	{
+		queue.clear();
+		for (auto& s : m_streams)
+		{
+			if (s.worker == id) {
+				Urgent u;
+				u.id       = s.id;
+				u.headroom = get_headroom(s.obuf, s.bytes_per_sec);
+				queue.push_back(u);
+			}
+		}
+		std::make_heap(queue.begin(), queue.end(), later);
+
+		while (!queue.empty() && !m_quit)
+		{
+			std::pop_heap(queue.begin(), queue.end(), later);
+			Urgent u = queue.back();
+			queue.pop_back();
+
+			// removed while unlocked
+			const Stream* s = Find(u.id);
+			if (!s) {
+				continue;
+			}
+			InputBuffer* ibuf = s->ibuf;
+			OutputBuffer* obuf = s->obuf;
+			const int bytes_per_sec = s->bytes_per_sec;
+
+			m_busy[id] = ibuf;
+			lock.unlock();
+
+			const int decoded = ibuf->Output(obuf, 1);
+			if (decoded > 0) {
+				u.headroom = get_headroom(obuf, bytes_per_sec);
+			}
+
+			lock.lock();
+			m_busy[id] = nullptr;
+
+			// full or at the end
+			if (decoded > 0) {
+				queue.push_back(u);
+				std::push_heap(queue.begin(), queue.end(), later);
+			}
+		}
+
+		m_start_cond.wait_for(lock, period, [&] { return m_quit || m_generation != generation; });
+		generation = m_generation;
+	}
+}
+
+const DecodePool::Stream* DecodePool::Find(uint32_t id) const
+{
+	for (auto& s : m_streams) {
+		if (s.id == id) {
+			return &s;
+		}
+	}
+	return nullptr;
+}
+
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "uniaudio/Decoder.h"
 #include "uniaudio/Exception.h"
+#include "uniaudio/XrunLog.h"
 
 namespace ua
 {
@@ -11,11 +12,8 @@ Decoder::Decoder(int buf_sz)
 	, m_eof(false)
 	, m_sample_rate(DEFAULT_SAMPLE_RATE)
 	, m_length(0)
+	, m_io_time(0)
 {
-	m_buf = new unsigned char[buf_sz];
-	if (!m_buf) {
-		throw Exception("Could not create decode buf.");
-	}
 }
 
 Decoder::Decoder(const Decoder& src)
@@ -25,11 +23,8 @@ Decoder::Decoder(const Decoder& src)
 	, m_eof(src.m_eof)
 	, m_sample_rate(src.m_sample_rate)
 	, m_length(src.m_length)
+	, m_io_time(0)
 {
-	m_buf = new unsigned char[m_buf_size];
-	if (!m_buf) {
-		throw Exception("Could not create decode buf.");
-	}
 }
 
 Decoder::~Decoder()
@@ -39,4 +34,53 @@ Decoder::~Decoder()
 	}
 }
 
+int Decoder::Decode()
+{
+	if (!m_buf)
+	{
+		m_buf = new unsigned char[m_buf_size];
+		if (!m_buf) {
+			throw Exception("Could not create decode buf.");
+		}
+	}
+	return Decode(m_buf, m_buf_size);
+}
+
+int Decoder::Map(const unsigned char*&, int)
+{
+	return -1;
+}
+
+const unsigned char* Decoder::GetData(size_t& size) const
+{
+	size = 0;
+	return nullptr;
+}
+
+const unsigned char* Decoder::GetAdpcmData(size_t& size, int& block_align, int64_t& frames) const
+{
+	size = 0;
+	block_align = 0;
+	frames = 0;
+	return nullptr;
+}
+
+bool Decoder::SeekFrame(int64_t frame)
+{
+	return Seek(static_cast<float>(static_cast<double>(frame) / m_sample_rate));
+}
+
+Decoder::IoTimer::IoTimer(Decoder* decoder)
+	: m_decoder(decoder)
+	, m_begin(decoder ? XrunLog::Now() : 0)
+{
+}
+
+Decoder::IoTimer::~IoTimer()
+{
+	if (m_decoder) {
+		m_decoder->m_io_time.fetch_add(XrunLog::Now() - m_begin, std::memory_order_relaxed);
+	}
+}
+
 }
\ No newline at end of file
@@ -1,10 +1,20 @@
 #include "uniaudio/DecoderFactory.h"
+#include "uniaudio/WavDecoder.h"
 #ifndef UA_NO_MPG123
 #include "uniaudio/Mpg123Decoder.h"
 #endif // UA_NO_MPG123
 #ifdef UA_SUPPORT_COREAUDIO
 #include "uniaudio/CoreAudioDecoder.h"
 #endif // UA_SUPPORT_COREAUDIO
+#ifdef UA_SUPPORT_VORBIS
+#include "uniaudio/VorbisDecoder.h"
+#endif // UA_SUPPORT_VORBIS
+#ifdef UA_SUPPORT_FLAC
+#include "uniaudio/FlacDecoder.h"
+#endif // UA_SUPPORT_FLAC
+#ifdef UA_SUPPORT_OPUS
+#include "uniaudio/OpusDecoder.h"
+#endif // UA_SUPPORT_OPUS
 
 #include <algorithm>
 #include <memory>
@@ -26,6 +36,8 @@ std::unique_ptr<Decoder> DecoderFactory::Create(const CU_STR& filepath, int buf_
 
 	if (false)
 		;
+	else if (WavDecoder::Accepts(ext))
+		decoder = std::make_unique<WavDecoder>(filepath.c_str(), buf_sz);
 #ifndef UA_NO_MPG123
 	else if (Mpg123Decoder::Accepts(ext))
 		decoder = std::make_unique<Mpg123Decoder>(filepath.c_str(), buf_sz);
@@ -34,6 +46,18 @@ std::unique_ptr<Decoder> DecoderFactory::Create(const CU_STR& filepath, int buf_
 	else if (CoreAudioDecoder::Accepts(ext))
 		decoder = std::make_unique<CoreAudioDecoder>(filepath.c_str(), buf_sz);
 #endif // UA_SUPPORT_COREAUDIO
+#ifdef UA_SUPPORT_VORBIS
+	else if (VorbisDecoder::Accepts(ext))
+		decoder = std::make_unique<VorbisDecoder>(filepath.c_str(), buf_sz);
+#endif // UA_SUPPORT_VORBIS
+#ifdef UA_SUPPORT_FLAC
+	else if (FlacDecoder::Accepts(ext))
+		decoder = std::make_unique<FlacDecoder>(filepath.c_str(), buf_sz);
+#endif // UA_SUPPORT_FLAC
+#ifdef UA_SUPPORT_OPUS
+	else if (OpusDecoder::Accepts(ext))
+		decoder = std::make_unique<OpusDecoder>(filepath.c_str(), buf_sz);
+#endif // UA_SUPPORT_OPUS
 
 	return decoder;
 }
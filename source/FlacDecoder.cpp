@@ -0,0 +1,471 @@
+#ifdef UA_SUPPORT_FLAC
+
+#include "uniaudio/FlacDecoder.h"
+#include "uniaudio/MappedFile.h"
+#include "uniaudio/MixKernel.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace ua
+{
+
+struct FlacDecoder::Stream : private cu::Uncopyable
+{
+	struct SeekPoint
+	{
+		int64_t sample;
+		// from audio_begin
+		uint64_t offset;
+	};
+
+	Stream(const std::string& filepath);
+
+	MappedFile file;
+	bool valid;
+
+	int rate;
+	int channels;
+	int bps;
+	int min_block, max_block;
+	// 0 if unknown
+	int64_t frames;
+
+	// the first frame
+	size_t audio_begin;
+	CU_VEC<SeekPoint> seektable;
+
+}; // FlacDecoder::Stream
+
+static inline uint32_t
+read_be16(const unsigned char* p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t
+read_be32(const unsigned char* p)
+{
+	return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline uint64_t
+read_be64(const unsigned char* p)
+{
+	return (static_cast<uint64_t>(read_be32(p)) << 32) | read_be32(p + 4);
+}
+
+// to interleaved 16 bit
+static void
+pack(int16_t* dst, const int32_t* const* src, int frames, int channels, int bps)
+{
+	if (bps >= 16) {
+		MixKernel::Get().pack_s16(dst, src, frames, channels, bps - 16);
+		return;
+	}
+
+	const int scale = 1 << (16 - bps);
+	for (int i = 0; i < frames; ++i) {
+		for (int c = 0; c < channels; ++c) {
+			*dst++ = static_cast<int16_t>(src[c][i] * scale);
+		}
+	}
+}
+
+FlacDecoder::Stream::Stream(const std::string& filepath)
+	: file(filepath)
+	, valid(false)
+	, rate(0)
+	, channels(0)
+	, bps(0)
+	, min_block(0)
+	, max_block(0)
+	, frames(0)
+	, audio_begin(0)
+{
+	const unsigned char* data = file.GetData();
+	const size_t size = file.GetSize();
+	if (!data) {
+		return;
+	}
+
+	size_t pos = 0;
+	// an ID3v2 tag ahead, its size is syncsafe
+	if (size >= 10 && memcmp(data, "ID3", 3) == 0) {
+		pos = 10 + ((data[6] & 0x7f) << 21 | (data[7] & 0x7f) << 14 | (data[8] & 0x7f) << 7 | (data[9] & 0x7f));
+		if (data[5] & 0x10) {
+			pos += 10;
+		}
+	}
+	if (pos + 4 > size || memcmp(data + pos, "fLaC", 4) != 0) {
+		return;
+	}
+	pos += 4;
+
+	bool info = false, last = false;
+	while (!last && pos + 4 <= size)
+	{
+		last = (data[pos] & 0x80) != 0;
+		const int type = data[pos] & 0x7f;
+		const size_t len = (data[pos + 1] << 16) | (data[pos + 2] << 8) | data[pos + 3];
+		pos += 4;
+		if (pos + len > size) {
+			return;
+		}
+
+		const unsigned char* p = data + pos;
+		// STREAMINFO
+		if (type == 0 && len >= 34)
+		{
+			min_block = read_be16(p);
+			max_block = read_be16(p + 2);
+			rate      = (p[10] << 12) | (p[11] << 4) | (p[12] >> 4);
+			channels  = ((p[12] >> 1) & 7) + 1;
+			bps       = (((p[12] & 1) << 4) | (p[13] >> 4)) + 1;
+			frames    = (static_cast<int64_t>(p[13] & 0xf) << 32) | read_be32(p + 14);
+			info = true;
+		}
+		// SEEKTABLE, sorted, without the placeholders
+		else if (type == 3)
+		{
+			for (size_t i = 0; i + 18 <= len; i += 18)
+			{
+				const uint64_t sample = read_be64(p + i);
+				if (sample != 0xFFFFFFFFFFFFFFFFull) {
+					seektable.push_back({ static_cast<int64_t>(sample), read_be64(p + i + 8) });
+				}
+			}
+		}
+		pos += len;
+	}
+
+	if (!info || channels > 2 || bps < 4 || bps > 32 || rate <= 0) {
+		return;
+	}
+	audio_begin = pos;
+	valid = true;
+}
+
+FlacDecoder::FlacDecoder(const std::string& filepath, int buf_sz)
+	: Decoder(buf_sz)
+	, m_stream(std::make_shared<Stream>(filepath))
+	, m_handle(nullptr)
+	, m_pos(0)
+	, m_dst(nullptr)
+	, m_room(0)
+	, m_pending_read(0)
+	, m_target(-1)
+{
+	// empty, like a file mpg123 could not open
+	if (!m_stream->valid) {
+		m_stream.reset();
+		return;
+	}
+
+	m_sample_rate = m_stream->rate;
+	m_length = static_cast<int>(m_stream->frames);
+	Init();
+}
+
+FlacDecoder::FlacDecoder(const FlacDecoder& src)
+	: Decoder(src)
+	, m_stream(src.m_stream)
+	, m_handle(nullptr)
+	, m_pos(0)
+	, m_dst(nullptr)
+	, m_room(0)
+	, m_pending_read(0)
+	, m_target(-1)
+{
+	if (m_stream) {
+		Init();
+	}
+}
+
+FlacDecoder::~FlacDecoder()
+{
+	if (m_handle) {
+		FLAC__stream_decoder_finish(m_handle);
+		FLAC__stream_decoder_delete(m_handle);
+	}
+}
+
+Decoder* FlacDecoder::Clone()
+{
+	return new FlacDecoder(*this);
+}
+
+int FlacDecoder::Decode(unsigned char* dst, int size)
+{
+	if (!m_handle) {
+		return 0;
+	}
+
+	const int channels = m_stream->channels;
+	const int frames = size / (channels * 2);
+	m_dst = reinterpret_cast<int16_t*>(dst);
+	m_room = frames;
+
+	Drain();
+	while (m_room > 0)
+	{
+		if (FLAC__stream_decoder_get_state(m_handle) == FLAC__STREAM_DECODER_END_OF_STREAM ||
+			!FLAC__stream_decoder_process_single(m_handle)) {
+			m_eof = true;
+			break;
+		}
+	}
+
+	const int written = frames - m_room;
+	m_dst = nullptr;
+	m_room = 0;
+	return written * channels * 2;
+}
+
+bool FlacDecoder::Seek(float s)
+{
+	if (s < 0) {
+		return false;
+	}
+	return SeekFrame(static_cast<int64_t>(s * static_cast<double>(m_sample_rate)));
+}
+
+bool FlacDecoder::SeekFrame(int64_t frame)
+{
+	if (!m_handle || frame < 0) {
+		return false;
+	}
+
+	const Stream& s = *m_stream;
+	if (s.frames > 0 && frame >= s.frames)
+	{
+		if (frame > s.frames) {
+			return false;
+		}
+		Restart(s.file.GetSize(), -1);
+		return true;
+	}
+
+	if (s.seektable.empty())
+	{
+		m_pending.clear();
+		m_pending_read = 0;
+		m_target = -1;
+		// the target frame goes to m_pending
+		if (!FLAC__stream_decoder_seek_absolute(m_handle, frame)) {
+			// the decoder is in its seek error state and the read position
+			// anywhere, both go back to the audio start
+			Restart(s.audio_begin, -1);
+			return false;
+		}
+		m_eof = false;
+		return true;
+	}
+
+	auto itr = std::upper_bound(s.seektable.begin(), s.seektable.end(), frame,
+		[](int64_t f, const Stream::SeekPoint& p) { return f < p.sample; });
+	size_t pos = s.audio_begin;
+	int64_t from = 0;
+	if (itr != s.seektable.begin()) {
+		--itr;
+		pos += static_cast<size_t>(itr->offset);
+		from = itr->sample;
+	}
+	Restart(pos, frame);
+
+	// the whole frames before the target are passed over undecoded, when
+	// all of them are the same size
+	if (s.min_block == s.max_block && s.max_block > 0) {
+		for (int64_t n = (frame - from) / s.max_block; n > 0; --n) {
+			if (!FLAC__stream_decoder_skip_single_frame(m_handle)) {
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+bool FlacDecoder::Rewind()
+{
+	if (!m_handle) {
+		return false;
+	}
+
+	Restart(m_stream->audio_begin, -1);
+	return true;
+}
+
+int FlacDecoder::GetChannels() const
+{
+	return m_stream ? m_stream->channels : DEFAULT_CHANNELS;
+}
+
+int FlacDecoder::GetBitDepth() const
+{
+	return 16;
+}
+
+float FlacDecoder::GetDuration() const
+{
+	if (!m_stream || m_stream->frames == 0) {
+		return 0;
+	}
+	return static_cast<float>(static_cast<double>(m_stream->frames) / m_sample_rate);
+}
+
+bool FlacDecoder::Accepts(const CU_STR& ext)
+{
+	return ext == "flac";
+}
+
+void FlacDecoder::Init()
+{
+	m_handle = FLAC__stream_decoder_new();
+	if (!m_handle) {
+		return;
+	}
+
+	// parsed by the Stream
+	FLAC__stream_decoder_set_metadata_ignore_all(m_handle);
+
+	FLAC__StreamDecoderInitStatus status = FLAC__stream_decoder_init_stream(m_handle,
+		&ReadCallback, &SeekCallback, &TellCallback, &LengthCallback, &EofCallback,
+		&WriteCallback, nullptr, &ErrorCallback, this);
+	// before a flush, or skipping frames
+	if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK ||
+		!FLAC__stream_decoder_process_until_end_of_metadata(m_handle)) {
+		FLAC__stream_decoder_delete(m_handle);
+		m_handle = nullptr;
+		return;
+	}
+	m_eof = false;
+}
+
+void FlacDecoder::Drain()
+{
+	const int channels = m_stream->channels;
+	const int left = static_cast<int>(m_pending.size() - m_pending_read) / channels;
+	const int n = std::min(left, m_room);
+	if (n <= 0) {
+		return;
+	}
+
+	memcpy(m_dst, &m_pending[m_pending_read], n * channels * sizeof(int16_t));
+	m_pending_read += n * channels;
+	m_dst += n * channels;
+	m_room -= n;
+}
+
+void FlacDecoder::Restart(size_t pos, int64_t target)
+{
+	FLAC__stream_decoder_flush(m_handle);
+
+	m_pos = pos;
+	m_target = target;
+	m_pending.clear();
+	m_pending_read = 0;
+	m_eof = false;
+}
+
+FLAC__StreamDecoderReadStatus FlacDecoder::ReadCallback(const FLAC__StreamDecoder*,
+	FLAC__byte buffer[], size_t* bytes, void* client_data)
+{
+	FlacDecoder* dec = static_cast<FlacDecoder*>(client_data);
+	const MappedFile& file = dec->m_stream->file;
+	if (dec->m_pos >= file.GetSize()) {
+		*bytes = 0;
+		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	}
+
+	const size_t n = std::min(*bytes, file.GetSize() - dec->m_pos);
+	memcpy(buffer, file.GetData() + dec->m_pos, n);
+	dec->m_pos += n;
+	*bytes = n;
+	return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+FLAC__StreamDecoderSeekStatus FlacDecoder::SeekCallback(const FLAC__StreamDecoder*,
+	FLAC__uint64 absolute_byte_offset, void* client_data)
+{
+	FlacDecoder* dec = static_cast<FlacDecoder*>(client_data);
+	if (absolute_byte_offset > dec->m_stream->file.GetSize()) {
+		return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+	}
+	dec->m_pos = static_cast<size_t>(absolute_byte_offset);
+	return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+}
+
+FLAC__StreamDecoderTellStatus FlacDecoder::TellCallback(const FLAC__StreamDecoder*,
+	FLAC__uint64* absolute_byte_offset, void* client_data)
+{
+	*absolute_byte_offset = static_cast<FlacDecoder*>(client_data)->m_pos;
+	return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+
+FLAC__StreamDecoderLengthStatus FlacDecoder::LengthCallback(const FLAC__StreamDecoder*,
+	FLAC__uint64* stream_length, void* client_data)
+{
+	*stream_length = static_cast<FlacDecoder*>(client_data)->m_stream->file.GetSize();
+	return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+
+FLAC__bool FlacDecoder::EofCallback(const FLAC__StreamDecoder*, void* client_data)
+{
+	FlacDecoder* dec = static_cast<FlacDecoder*>(client_data);
+	return dec->m_pos >= dec->m_stream->file.GetSize();
+}
+
+FLAC__StreamDecoderWriteStatus FlacDecoder::WriteCallback(const FLAC__StreamDecoder*,
+	const FLAC__Frame* frame, const FLAC__int32* const buffer[], void* client_data)
+{
+	FlacDecoder* dec = static_cast<FlacDecoder*>(client_data);
+	const int channels = dec->m_stream->channels;
+	if (static_cast<int>(frame->header.channels) != channels) {
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+
+	// the number is always a sample one here
+	const int n = frame->header.blocksize;
+	int begin = 0;
+	if (dec->m_target >= 0)
+	{
+		const int64_t first = static_cast<int64_t>(frame->header.number.sample_number);
+		if (first + n <= dec->m_target) {
+			return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+		}
+		begin = static_cast<int>(std::max<int64_t>(dec->m_target - first, 0));
+		dec->m_target = -1;
+	}
+
+	const int bps = frame->header.bits_per_sample;
+	const int32_t* src[2] = { buffer[0] + begin, buffer[channels - 1] + begin };
+
+	// what fits goes straight to the output
+	const int direct = std::min(n - begin, dec->m_room);
+	pack(dec->m_dst, src, direct, channels, bps);
+	dec->m_dst += direct * channels;
+	dec->m_room -= direct;
+
+	const int rest = n - begin - direct;
+	if (rest > 0)
+	{
+		src[0] += direct;
+		src[1] += direct;
+		dec->m_pending.resize(rest * channels);
+		dec->m_pending_read = 0;
+		pack(&dec->m_pending[0], src, rest, channels, bps);
+	}
+
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void FlacDecoder::ErrorCallback(const FLAC__StreamDecoder*,
+	FLAC__StreamDecoderErrorStatus, void*)
+{
+	// libFLAC finds the next frame by itself
+}
+
+}
+
+#endif // UA_SUPPORT_FLAC
\ No newline at end of file
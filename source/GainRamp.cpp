@@ -0,0 +1,149 @@
+#include "uniaudio/GainRamp.h"
+#include "uniaudio/AudioMixer.h"
+
+#include <algorithm>
+
+namespace ua
+{
+
+const float GainRamp::RAMP_TIME = 0.005f;
+
+GainRamp::GainRamp()
+	: m_sample_rate(AudioMixer::DEFAULT_SAMPLE_RATE)
+	, m_volume(1)
+	, m_target(1)
+	, m_step(0)
+	, m_remain(0)
+	, m_fade_in_time(0)
+	, m_fade_out_end_time(0)
+	, m_fade_out_time(0)
+	, m_fade_in(0)
+	, m_fade_out_end(0)
+	, m_fade_out(0)
+	, m_pos(0)
+{
+}
+
+void GainRamp::SetSampleRate(int sample_rate)
+{
+	m_sample_rate = sample_rate;
+	UpdateFrames();
+}
+
+void GainRamp::Start(float volume)
+{
+	m_volume = m_target = volume;
+	m_step = 0;
+	m_remain = 0;
+	m_pos = 0;
+}
+
+void GainRamp::Seek(float pos)
+{
+	m_pos = std::max(static_cast<int64_t>(pos * m_sample_rate), static_cast<int64_t>(0));
+}
+
+void GainRamp::SetVolume(float volume, float time)
+{
+	if (volume == m_target) {
+		return;
+	}
+
+	m_target = volume;
+	m_remain = static_cast<int>(time * m_sample_rate);
+	if (m_remain > 0) {
+		m_step = (m_target - m_volume) / m_remain;
+	} else {
+		m_volume = m_target;
+		m_step = 0;
+	}
+}
+
+void GainRamp::SetFadeIn(float time)
+{
+	m_fade_in_time = time;
+	UpdateFrames();
+}
+
+void GainRamp::SetFadeOut(float end, float time)
+{
+	m_fade_out_end_time = end;
+	m_fade_out_time = time;
+	UpdateFrames();
+}
+
+int GainRamp::Next(int frames, float& gain, float& step)
+{
+	if (frames <= 0) {
+		gain = GetGain();
+		step = 0;
+		return 0;
+	}
+
+	// cut at the end of the volume ramp and at the envelope's corners
+	int64_t n = frames;
+	if (m_remain > 0) {
+		n = std::min<int64_t>(n, m_remain);
+	}
+	if (m_pos < m_fade_in) {
+		n = std::min(n, m_fade_in - m_pos);
+	}
+	if (m_fade_out_end > 0)
+	{
+		const int64_t begin = m_fade_out_end - m_fade_out;
+		if (m_pos < begin) {
+			n = std::min(n, begin - m_pos);
+		} else if (m_pos < m_fade_out_end) {
+			n = std::min(n, m_fade_out_end - m_pos);
+		}
+	}
+
+	float end_volume = m_volume;
+	if (m_remain > 0) {
+		m_remain -= static_cast<int>(n);
+		end_volume = m_remain == 0 ? m_target : m_volume + m_step * n;
+	}
+
+	gain = m_volume * Envelope(m_pos);
+	step = (end_volume * Envelope(m_pos + n) - gain) / n;
+
+	m_volume = end_volume;
+	m_pos += n;
+
+	return static_cast<int>(n);
+}
+
+float GainRamp::GetGain() const
+{
+	return m_volume * Envelope(m_pos);
+}
+
+float GainRamp::Envelope(int64_t pos) const
+{
+	float e = 1;
+	if (pos < m_fade_in) {
+		e = static_cast<float>(pos) / m_fade_in;
+	}
+	if (m_fade_out_end > 0)
+	{
+		if (pos >= m_fade_out_end) {
+			e = 0;
+		} else if (pos > m_fade_out_end - m_fade_out) {
+			e *= static_cast<float>(m_fade_out_end - pos) / m_fade_out;
+		}
+	}
+	return e;
+}
+
+void GainRamp::UpdateFrames()
+{
+	m_fade_in = static_cast<int64_t>(m_fade_in_time * m_sample_rate);
+	if (m_fade_out_end_time > 0 && m_fade_out_time > 0) {
+		m_fade_out_end = static_cast<int64_t>(m_fade_out_end_time * m_sample_rate);
+		m_fade_out = static_cast<int64_t>(m_fade_out_time * m_sample_rate);
+	} else {
+		m_fade_out_end = m_fade_out = 0;
+	}
+}
+
+}
\ No newline at end of file
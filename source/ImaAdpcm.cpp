@@ -0,0 +1,163 @@
+#include "uniaudio/ImaAdpcm.h"
+#include "uniaudio/MixKernel.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace ua
+{
+
+const int32_t ImaAdpcm::STEP_TABLE[MAX_INDEX + 1] =
+{
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+	19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+	130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+	5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+const int ImaAdpcm::INDEX_TABLE[16] =
+{
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+namespace
+{
+
+// the nibble nearest `sample`, moves `pred` and `index` as the decoder does
+int encode_sample(int sample, int& pred, int& index)
+{
+	int step = ImaAdpcm::STEP_TABLE[index];
+	int diff = sample - pred;
+	int nibble = 0;
+	if (diff < 0) {
+		nibble = 8;
+		diff = -diff;
+	}
+
+	int delta = step >> 3;
+	if (diff >= step) {
+		nibble |= 4;
+		diff -= step;
+		delta += step;
+	}
+	step >>= 1;
+	if (diff >= step) {
+		nibble |= 2;
+		diff -= step;
+		delta += step;
+	}
+	step >>= 1;
+	if (diff >= step) {
+		nibble |= 1;
+		delta += step;
+	}
+
+	pred += (nibble & 8) ? -delta : delta;
+	pred = std::min(std::max(pred, -32768), 32767);
+	index = std::min(std::max(index + ImaAdpcm::INDEX_TABLE[nibble], 0), static_cast<int>(ImaAdpcm::MAX_INDEX));
+	return nibble;
+}
+
+}
+
+ImaAdpcm::ImaAdpcm(const uint8_t* blocks, int64_t frames, int channels, int block_align)
+	: m_blocks(blocks)
+	, m_frames(IsValid(channels, block_align) ? frames : 0)
+	, m_channels(channels)
+	, m_block_align(block_align)
+	, m_block_frames(m_frames > 0 ? GetBlockFrames(block_align, channels) : 0)
+	, m_cached(-1)
+{
+}
+
+void ImaAdpcm::Decode(int16_t* dst, int64_t frame, int count)
+{
+	const MixKernel& kernel = MixKernel::Get();
+	while (count > 0)
+	{
+		const int64_t block = frame / m_block_frames;
+		const int offset = static_cast<int>(frame - block * m_block_frames);
+		const uint8_t* src = m_blocks + block * m_block_align;
+
+		int n;
+		if (offset == 0 && count >= m_block_frames)
+		{
+			// straight into `dst`
+			const int blocks = count / m_block_frames;
+			kernel.decode_ima(dst, src, blocks, m_block_align, m_channels);
+			n = blocks * m_block_frames;
+		}
+		else
+		{
+			if (block != m_cached) {
+				m_block.resize(m_block_frames * m_channels);
+				kernel.decode_ima(&m_block[0], src, 1, m_block_align, m_channels);
+				m_cached = block;
+			}
+			n = std::min(count, m_block_frames - offset);
+			memcpy(dst, &m_block[offset * m_channels], n * m_channels * sizeof(int16_t));
+		}
+
+		dst += n * m_channels;
+		frame += n;
+		count -= n;
+	}
+}
+
+bool ImaAdpcm::IsValid(int channels, int block_align)
+{
+	return channels >= 1 && channels <= 2 &&
+		block_align % (4 * channels) == 0 && block_align >= 8 * channels;
+}
+
+int ImaAdpcm::GetBlockFrames(int block_align, int channels)
+{
+	// the header sample, then 8 a word
+	return 1 + (block_align / (4 * channels) - 1) * 8;
+}
+
+size_t ImaAdpcm::GetEncodedSize(int64_t frames, int channels, int block_align)
+{
+	const int block_frames = GetBlockFrames(block_align, channels);
+	return static_cast<size_t>((frames + block_frames - 1) / block_frames) * block_align;
+}
+
+void ImaAdpcm::Encode(uint8_t* dst, const int16_t* src, int64_t frames, int channels, int block_align)
+{
+	const int block_frames = GetBlockFrames(block_align, channels);
+
+	// carried across the blocks
+	int index[2] = { 0, 0 };
+	for (int64_t first = 0; first < frames; first += block_frames, dst += block_align)
+	{
+		const int n = static_cast<int>(std::min<int64_t>(block_frames, frames - first));
+		const int16_t* in = src + first * channels;
+		memset(dst, 0, block_align);
+
+		for (int c = 0; c < channels; ++c)
+		{
+			int pred = in[c];
+			uint8_t* header = dst + c * 4;
+			header[0] = static_cast<uint8_t>(pred & 0xff);
+			header[1] = static_cast<uint8_t>((pred >> 8) & 0xff);
+			header[2] = static_cast<uint8_t>(index[c]);
+
+			for (int i = 1; i < block_frames; ++i)
+			{
+				const int sample = i < n ? in[i * channels + c] : 0;
+				const int nibble = encode_sample(sample, pred, index[c]);
+				const int k = i - 1;
+				dst[(channels + (k / 8) * channels + c) * 4 + (k % 8) / 2] |= nibble << ((k & 1) * 4);
+			}
+		}
+	}
+}
+
+}
\ No newline at end of file
@@ -2,85 +2,364 @@
 #include "uniaudio/Decoder.h"
 #include "uniaudio/OutputBuffer.h"
 
+#include <algorithm>
+#include <limits>
+
 #include <assert.h>
+#include <string.h>
 
 namespace ua
 {
 
+const float InputBuffer::LOOP_HEAD_TIME = 0.1f;
+
 InputBuffer::InputBuffer(std::unique_ptr<Decoder>& decoder)
 	: m_decoder(std::move(decoder))
-	, m_size(0)
-	, m_used(0)
-	, m_offset(0)
+	, m_frame(0)
+	, m_looping(false)
+	, m_loop_begin(0)
+	, m_loop_end(0)
+	, m_head_done(false)
+	, m_head_whole(false)
+	, m_head_read(0)
+	, m_seek_frame(-1)
+	, m_busy_since(0)
+	, m_busy_io(0)
+	, m_last_wall(0)
+	, m_last_io(0)
+	, m_last_audio(0)
 {
 }
 
-void InputBuffer::Output(OutputBuffer* out, bool looping)
+void InputBuffer::Output(OutputBuffer* out)
 {
-	if (m_size == 0 || m_used == m_size) {
-		Reload(looping);
+	Output(out, std::numeric_limits<int>::max());
+}
+
+int InputBuffer::Output(OutputBuffer* out, int max_sz)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	BeginBusy();
+	ApplySeek();
+
+	// decodes straight into the free slots
+	int total = 0;
+	int sz;
+	unsigned char* dst;
+	while (total < max_sz && (dst = out->Reserve(sz)))
+	{
+		int read = Read(dst, sz);
+		if (read == 0) {
+			// the last partial block
+			out->Flush();
+			break;
+		}
+		out->Commit(read);
+		total += read;
+		// the loop start is queued, the seek waits for the next pass
+		if (m_seek_frame >= 0) {
+			break;
+		}
 	}
-	if (m_size == 0) {
-		return;
+
+	EndBusy(total);
+	return total;
+}
+
+int InputBuffer::Decode(const unsigned char*& buf)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	BeginBusy();
+	ApplySeek();
+	// straight from the decoder's memory if it has it
+	int ret = Map(buf, m_decoder->GetBufferSize());
+	if (ret < 0)
+	{
+		m_scratch.resize(m_decoder->GetBufferSize());
+		buf = &m_scratch[0];
+		ret = Read(&m_scratch[0], static_cast<int>(m_scratch.size()));
 	}
+	EndBusy(ret);
+	return ret;
+}
 
-	while (true)
+int InputBuffer::GetBytesPerSec() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_decoder->GetSampleRate() * GetFrameSize();
+}
+
+XrunCause InputBuffer::GetStallCause() const
+{
+	int64_t wall, io;
+	const int64_t since = m_busy_since.load(std::memory_order_acquire);
+	if (since != 0)
 	{
-		int left = m_size - m_used;
-		int sz = out->Input(&m_decoder->GetBuffer()[m_used], left);
-		m_offset += sz;
-		assert(sz <= left);
-		if (sz < left) {
-			m_used += sz;
-			break;
-		} else if (sz == left) {
-			Reload(looping);
-			if (m_size == 0) {
-				break;
-			}
+		wall = XrunLog::Now() - since;
+		io = m_decoder->GetIoTime() - m_busy_io.load(std::memory_order_relaxed);
+	}
+	else
+	{
+		wall = m_last_wall.load(std::memory_order_relaxed);
+		io = m_last_io.load(std::memory_order_relaxed);
+		// kept up with real time
+		if (wall <= m_last_audio.load(std::memory_order_relaxed)) {
+			return XRUN_CONSUMER_EARLY;
 		}
 	}
+	return io * 2 > wall ? XRUN_IO_LATE : XRUN_DECODE_LATE;
+}
+
+void InputBuffer::SetLooping(bool looping)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_looping = looping;
+}
+
+void InputBuffer::SetLoopRegion(int64_t begin, int64_t end)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_loop_begin = begin;
+	m_loop_end = end;
+	// the decoder resumes where the replay of the old head is
+	if (m_head_read < m_head.size() || m_seek_frame >= 0) {
+		m_seek_frame = m_frame;
+	}
+	// recaptured from the new start
+	m_head.clear();
+	m_head_done = false;
+	m_head_whole = false;
+	m_head_read = 0;
 }
 
 bool InputBuffer::IsDecoderFinished() const
 {
-	return m_decoder ? m_decoder->IsFinished() : true;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_decoder ? m_decoder->IsFinished() && m_head_read >= m_head.size() && m_seek_frame < 0 : true;
 }
 
 void InputBuffer::DecoderRewind()
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	if (m_decoder) {
 		m_decoder->Rewind();
+		MoveTo(0);
 	}
 }
 
-void InputBuffer::Seek(float offset, bool looping)
+void InputBuffer::Seek(float offset)
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_decoder->Seek(offset);
-	Reload(looping);
-
-	m_offset = m_decoder->GetBitDepth() * m_decoder->GetChannels() * offset * m_decoder->GetSampleRate() / 8;
+	MoveTo(static_cast<int64_t>(static_cast<double>(offset) * m_decoder->GetSampleRate() + 0.5));
 }
 
 float InputBuffer::GetOffset() const
 {
-	return m_offset * 8 / m_decoder->GetBitDepth() / m_decoder->GetChannels() / m_decoder->GetSampleRate();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<float>(static_cast<double>(m_frame) / m_decoder->GetSampleRate());
 }
 
 void InputBuffer::Rewind()
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_decoder->Rewind();
-	m_offset = 0;
+	MoveTo(0);
 }
 
-void InputBuffer::Reload(bool looping)
+int InputBuffer::Read(unsigned char* dst, int size)
 {
-	m_size = m_decoder->Decode();
-	assert(m_size <= m_decoder->GetBufferSize());
-	m_used = 0;
-	if (m_decoder->IsFinished() && looping) {
-		m_decoder->Rewind();
+	const int frame_size = GetFrameSize();
+
+	int total = 0;
+	bool looped = false;
+	while (total < size)
+	{
+		// the loop seam, from memory
+		if (m_head_read < m_head.size())
+		{
+			int n = std::min(static_cast<int>(m_head.size() - m_head_read), size - total);
+			memcpy(dst + total, &m_head[m_head_read], n);
+			m_head_read += n;
+			m_frame += n / frame_size;
+			total += n;
+			looped = false;
+			continue;
+		}
+
+		// the decoder is not past the head yet
+		if (m_seek_frame >= 0) {
+			break;
+		}
+
+		// never past the loop end, the wrap is exact
+		int64_t want = size - total;
+		if (m_looping && m_loop_end > 0) {
+			want = std::min(want, std::max<int64_t>(m_loop_end - m_frame, 0) * frame_size);
+		}
+
+		int n = want > 0 ? std::max(m_decoder->Decode(dst + total, static_cast<int>(want)), 0) : 0;
+		if (n > 0)
+		{
+			CaptureHead(dst + total, n);
+			m_frame += n / frame_size;
+			total += n;
+			looped = false;
+			if (!IsLoopEnd()) {
+				continue;
+			}
+		}
+
+		if (!IsLoopEnd()) {
+			break;
+		}
+		// the end, or nothing to loop
+		if (!m_looping || looped) {
+			break;
+		}
+
+		if (m_head_done)
+		{
+			// replayed now, the decoder seeks past the cached head on the
+			// next pass, stays at the end if that is the whole loop
+			if (!m_head_whole) {
+				m_seek_frame = m_loop_begin + static_cast<int64_t>(m_head.size() / frame_size);
+			}
+			m_head_read = 0;
+		}
+		else
+		{
+			if (m_loop_begin == 0) {
+				m_decoder->Rewind();
+			} else {
+				m_decoder->SeekFrame(m_loop_begin);
+			}
+			m_head.clear();
+		}
+		m_frame = m_loop_begin;
+		looped = true;
+	}
+
+	return total;
+}
+
+int InputBuffer::Map(const unsigned char*& buf, int size)
+{
+	const int frame_size = GetFrameSize();
+
+	int64_t want = size;
+	if (m_looping && m_loop_end > 0) {
+		want = std::min(want, std::max<int64_t>(m_loop_end - m_frame, 0) * frame_size);
+	}
+
+	int n = want > 0 ? m_decoder->Map(buf, static_cast<int>(want)) : 0;
+	if (n < 0) {
+		return -1;
 	}
+	if (n > 0) {
+		m_frame += n / frame_size;
+		return n;
+	}
+	if (!IsLoopEnd() || !m_looping) {
+		return 0;
+	}
+
+	// the loop start straight from the decoder's memory, the decoder
+	// seeks past it on the next pass
+	size_t bytes = 0;
+	const unsigned char* data = m_decoder->GetData(bytes);
+	const int64_t end = m_loop_end > 0 ? m_loop_end : static_cast<int64_t>(bytes / frame_size);
+	const int64_t frames = std::min<int64_t>(size / frame_size, end - m_loop_begin);
+	if (!data || frames <= 0) {
+		return 0;
+	}
+	buf = data + m_loop_begin * frame_size;
+	m_frame = m_loop_begin + frames;
+	m_seek_frame = m_frame;
+	return static_cast<int>(frames) * frame_size;
+}
+
+void InputBuffer::CaptureHead(const unsigned char* buf, int size)
+{
+	// seeks in memory are free, nothing to cache
+	size_t in_memory = 0;
+	if (!m_looping || m_head_done || m_decoder->GetData(in_memory)) {
+		return;
+	}
+
+	// only from a contiguous decode from the loop start, `buf` is at m_frame
+	const int frame_size = GetFrameSize();
+	const int64_t next = m_loop_begin + static_cast<int64_t>(m_head.size() / frame_size);
+	if (next < m_frame || next >= m_frame + size / frame_size) {
+		return;
+	}
+
+	const size_t skip = static_cast<size_t>(next - m_frame) * frame_size;
+	const size_t cap = static_cast<size_t>(LOOP_HEAD_TIME * m_decoder->GetSampleRate()) * frame_size;
+	const size_t n = std::min(cap - m_head.size(), static_cast<size_t>(size) - skip);
+	m_head.insert(m_head.end(), buf + skip, buf + skip + n);
+	m_head_read = m_head.size();
+	// shorter loops are cached whole
+	const int64_t end = m_loop_begin + static_cast<int64_t>(m_head.size() / frame_size);
+	m_head_whole = (m_loop_end > 0 && end >= m_loop_end) ||
+		(m_decoder->IsFinished() && skip + n == static_cast<size_t>(size));
+	if (m_head_whole || m_head.size() == cap) {
+		m_head_done = true;
+	}
+}
+
+bool InputBuffer::IsLoopEnd() const
+{
+	return m_decoder->IsFinished() || (m_looping && m_loop_end > 0 && m_frame >= m_loop_end);
+}
+
+void InputBuffer::MoveTo(int64_t frame)
+{
+	m_frame = frame;
+	m_seek_frame = -1;
+	// a pending seam is dropped, a partial head is captured again
+	m_head_read = m_head.size();
+	if (!m_head_done) {
+		m_head.clear();
+		m_head_read = 0;
+	}
+}
+
+void InputBuffer::ApplySeek()
+{
+	if (m_seek_frame >= 0) {
+		m_decoder->SeekFrame(m_seek_frame);
+		m_seek_frame = -1;
+	}
+}
+
+int InputBuffer::GetFrameSize() const
+{
+	return m_decoder->GetBitDepth() / 8 * m_decoder->GetChannels();
+}
+
+void InputBuffer::BeginBusy()
+{
+	m_busy_io.store(m_decoder->GetIoTime(), std::memory_order_relaxed);
+	m_busy_since.store(XrunLog::Now(), std::memory_order_release);
+}
+
+void InputBuffer::EndBusy(int bytes)
+{
+	// a full ring, nothing to judge the speed by
+	if (bytes <= 0) {
+		m_busy_since.store(0, std::memory_order_release);
+		return;
+	}
+
+	const int64_t since = m_busy_since.load(std::memory_order_relaxed);
+	const int64_t bytes_per_sec = static_cast<int64_t>(m_decoder->GetSampleRate()) * GetFrameSize();
+
+	m_last_wall.store(XrunLog::Now() - since, std::memory_order_relaxed);
+	m_last_io.store(m_decoder->GetIoTime() - m_busy_io.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	m_last_audio.store(bytes_per_sec > 0 ? static_cast<int64_t>(bytes) * 1000000000LL / bytes_per_sec : 0, std::memory_order_relaxed);
+	m_busy_since.store(0, std::memory_order_release);
 }
 
 }
\ No newline at end of file
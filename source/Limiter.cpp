@@ -0,0 +1,85 @@
+#include "uniaudio/Limiter.h"
+#include "uniaudio/MixKernel.h"
+
+#include <algorithm>
+
+#include <math.h>
+#include <string.h>
+
+namespace ua
+{
+
+namespace
+{
+
+void ramp(const MixKernel& k, int16_t* dst, const float* src, int frames, int channels, float gain, float target)
+{
+	const float scale = 32768.0f;
+	k.ramp_s16(dst, src, frames, channels, gain * scale, (target - gain) * scale / frames);
+}
+
+void ramp(const MixKernel& k, float* dst, const float* src, int frames, int channels, float gain, float target)
+{
+	k.ramp_f32(dst, src, frames, channels, gain, (target - gain) / frames);
+}
+
+}
+
+// -0.3dB
+const float Limiter::THRESHOLD = 0.966f;
+
+const float Limiter::RELEASE_TIME = 0.05f;
+
+Limiter::Limiter(int channels, int sample_rate)
+	: m_channels(channels)
+	, m_gain(1)
+	, m_peak(0)
+{
+	m_release = 1 - expf(-LOOKAHEAD / (RELEASE_TIME * sample_rate));
+}
+
+template <typename T>
+void Limiter::ProcessImpl(T* dst, float* buf, int frames, const MixKernel& kernel)
+{
+	// Gain is interpolated linearly across pieces of at most LOOKAHEAD
+	// frames. Both ends of a piece stay under THRESHOLD / peak of that
+	// piece, as the end of the previous piece has already seen it.
+	for (int begin = 0; begin < frames; )
+	{
+		const int end = std::min(begin + LOOKAHEAD, frames);
+		const float next_peak = kernel.peak_f32(buf + end * m_channels, LOOKAHEAD * m_channels);
+
+		float target = m_gain + (1 - m_gain) * m_release;
+		const float peak = std::max(m_peak, next_peak);
+		if (peak * target > THRESHOLD) {
+			target = THRESHOLD / peak;
+		}
+
+		ramp(kernel, dst + begin * m_channels, buf + begin * m_channels, end - begin, m_channels,
+			m_gain, target);
+
+		m_gain = target;
+		m_peak = next_peak;
+		begin = end;
+	}
+
+	memmove(buf, buf + frames * m_channels, sizeof(float) * LOOKAHEAD * m_channels);
+}
+
+void Limiter::Process(int16_t* dst, float* buf, int frames, const MixKernel& kernel)
+{
+	ProcessImpl(dst, buf, frames, kernel);
+}
+
+void Limiter::Process(float* dst, float* buf, int frames, const MixKernel& kernel)
+{
+	ProcessImpl(dst, buf, frames, kernel);
+}
+
+void Limiter::Reset()
+{
+	m_gain = 1;
+	m_peak = 0;
+}
+
+}
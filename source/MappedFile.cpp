@@ -0,0 +1,157 @@
+#include "uniaudio/MappedFile.h"
+
+#include <fs_file.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include <stdlib.h>
+
+namespace ua
+{
+
+MappedFile::MappedFile(const CU_STR& filepath)
+	: m_data(nullptr)
+	, m_size(0)
+	, m_mapped(false)
+#ifdef _WIN32
+	, m_file(INVALID_HANDLE_VALUE)
+	, m_mapping(nullptr)
+#endif // _WIN32
+{
+	if (!Map(filepath)) {
+		Load(filepath);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_mapped) {
+		Unmap();
+	} else if (m_data) {
+		free(const_cast<unsigned char*>(m_data));
+	}
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Map(const CU_STR& filepath)
+{
+	m_file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+		Unmap();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping) {
+		Unmap();
+		return false;
+	}
+
+	m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data) {
+		Unmap();
+		return false;
+	}
+
+	m_size = static_cast<size_t>(size.QuadPart);
+	m_mapped = true;
+	return true;
+}
+
+void MappedFile::Unmap()
+{
+	if (m_data) {
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+	m_size = 0;
+	m_mapped = false;
+}
+
+#else
+
+bool MappedFile::Map(const CU_STR& filepath)
+{
+	int fd = open(filepath.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file
+	close(fd);
+	if (addr == MAP_FAILED) {
+		return false;
+	}
+
+	m_data = static_cast<const unsigned char*>(addr);
+	m_size = static_cast<size_t>(st.st_size);
+	m_mapped = true;
+	return true;
+}
+
+void MappedFile::Unmap()
+{
+	if (m_data) {
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+		m_data = nullptr;
+	}
+	m_size = 0;
+	m_mapped = false;
+}
+
+#endif // _WIN32
+
+bool MappedFile::Load(const CU_STR& filepath)
+{
+	fs_file* file = fs_open(filepath.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+
+	const size_t size = fs_size(file);
+	unsigned char* data = size > 0 ? static_cast<unsigned char*>(malloc(size)) : nullptr;
+	// fails on a short read, not keeps a truncated file
+	if (data && static_cast<size_t>(fs_read(file, data, size)) != size) {
+		free(data);
+		data = nullptr;
+	}
+	fs_close(file);
+	if (!data) {
+		return false;
+	}
+
+	m_data = data;
+	m_size = size;
+	return true;
+}
+
+}
\ No newline at end of file
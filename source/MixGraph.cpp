@@ -0,0 +1,223 @@
+#include "uniaudio/MixGraph.h"
+#include "uniaudio/Exception.h"
+
+#include <algorithm>
+
+namespace ua
+{
+
+MixGraph::MixGraph(float buf_time_len, const OutputFormat& fmt, AudioMixer::Bus bus)
+	: m_buf_time_len(buf_time_len)
+	, m_format(fmt)
+	, m_bus(bus)
+{
+	Node* master = new Node;
+	if (!master) {
+		throw Exception("Could not create MixGraph master.");
+	}
+	master->name   = "master";
+	master->mixer  = nullptr;
+	master->active = false;
+	m_nodes.push_back(master);
+
+	UpdateOrder();
+}
+
+MixGraph::~MixGraph()
+{
+	for (auto& node : m_nodes)
+	{
+		if (node->mixer) {
+			delete node->mixer;
+		}
+		delete node;
+	}
+}
+
+int MixGraph::AddBus(const CU_STR& name, int output)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto& node : m_nodes) {
+		if (node->name == name) {
+			throw Exception("MixGraph bus %s already exists.", name.c_str());
+		}
+	}
+	if (output < 0 || output >= static_cast<int>(m_nodes.size())) {
+		throw Exception("MixGraph no output bus %d.", output);
+	}
+
+	Node* node = new Node;
+	if (!node) {
+		throw Exception("Could not create MixGraph bus.");
+	}
+	node->name   = name;
+	node->mixer  = new AudioMixer(m_buf_time_len, m_format, m_bus);
+	node->active = false;
+	node->outputs.push_back(output);
+	node->ramp.SetSampleRate(node->mixer->GetFormat().sample_rate);
+	node->ramp.Start(1);
+	m_nodes.push_back(node);
+
+	UpdateOrder();
+
+	return static_cast<int>(m_nodes.size()) - 1;
+}
+
+void MixGraph::AddOutput(int bus, int output)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const int n = static_cast<int>(m_nodes.size());
+	if (bus <= MASTER || bus >= n || output < 0 || output >= n) {
+		throw Exception("MixGraph no bus %d or %d.", bus, output);
+	}
+	if (IsReachable(output, bus)) {
+		throw Exception("MixGraph %s to %s makes a cycle.", m_nodes[bus]->name.c_str(),
+			m_nodes[output]->name.c_str());
+	}
+
+	CU_VEC<int>& outputs = m_nodes[bus]->outputs;
+	if (std::find(outputs.begin(), outputs.end(), output) == outputs.end()) {
+		outputs.push_back(output);
+		UpdateOrder();
+	}
+}
+
+int MixGraph::GetBus(const CU_STR& name) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (int i = 0, n = static_cast<int>(m_nodes.size()); i < n; ++i) {
+		if (m_nodes[i]->name == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void MixGraph::SetVolume(int bus, float volume)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (bus > MASTER && bus < static_cast<int>(m_nodes.size())) {
+		m_nodes[bus]->ramp.SetVolume(volume);
+	}
+}
+
+void MixGraph::AddEffect(int bus, AudioMixer::Effect effect, void* ud)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (bus >= MASTER && bus < static_cast<int>(m_nodes.size()))
+	{
+		Effect e;
+		e.func = effect;
+		e.ud   = ud;
+		m_nodes[bus]->effects.push_back(e);
+	}
+}
+
+AudioMixer::Batch& MixGraph::GetBatch(int bus)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (bus < MASTER || bus >= static_cast<int>(m_nodes.size())) {
+		bus = MASTER;
+	}
+	return m_nodes[bus]->batch;
+}
+
+void MixGraph::Mix(AudioMixer& master, ParallelMixer* parallel)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto& id : m_order)
+	{
+		Node* node = m_nodes[id];
+		AudioMixer& dst = id == MASTER ? master : *node->mixer;
+
+		if (!node->batch.Empty())
+		{
+			node->active = true;
+			if (parallel) {
+				parallel->Mix(dst, node->batch);
+			} else {
+				dst.Input(node->batch);
+			}
+			node->batch.Clear();
+		}
+
+		if (!node->active) {
+			continue;
+		}
+		node->active = false;
+
+		for (auto& e : node->effects) {
+			dst.ApplyEffect(e.func, e.ud);
+		}
+
+		if (id == MASTER) {
+			continue;
+		}
+
+		// every output gets the same gain, the ramp moves once
+		GainRamp ramp;
+		for (auto& output : node->outputs)
+		{
+			Node* out = m_nodes[output];
+			ramp = node->ramp;
+			(output == MASTER ? master : *out->mixer).Merge(dst, ramp);
+			out->active = true;
+		}
+		node->ramp = ramp;
+
+		dst.Reset();
+	}
+}
+
+bool MixGraph::IsReachable(int from, int to) const
+{
+	if (from == to) {
+		return true;
+	}
+	for (auto& output : m_nodes[from]->outputs) {
+		if (IsReachable(output, to)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void MixGraph::UpdateOrder()
+{
+	// post-order over the outputs puts every bus after its outputs, then
+	// reversed
+	const int n = static_cast<int>(m_nodes.size());
+	CU_VEC<bool> visited(n, false);
+	m_order.clear();
+
+	struct Visitor
+	{
+		const CU_VEC<Node*>& nodes;
+		CU_VEC<bool>& visited;
+		CU_VEC<int>& order;
+
+		void Visit(int id)
+		{
+			if (visited[id]) {
+				return;
+			}
+			visited[id] = true;
+			for (auto& output : nodes[id]->outputs) {
+				Visit(output);
+			}
+			order.push_back(id);
+		}
+	};
+
+	Visitor visitor = { m_nodes, visited, m_order };
+	for (int i = n - 1; i >= 0; --i) {
+		visitor.Visit(i);
+	}
+	std::reverse(m_order.begin(), m_order.end());
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "uniaudio/MixKernel.h"
+#include "uniaudio/ImaAdpcm.h"
+
+#include <algorithm>
+
+#include <math.h>
+
+namespace ua
+{
+
+namespace
+{
+
+template <typename D, typename T>
+void mix_mono(D* dst, const T* src, int frames, float gain, float step)
+{
+	for (int i = 0; i < frames; ++i) {
+		D v = static_cast<D>(src[i] * (gain + step * static_cast<float>(i)));
+		*dst++ += v;
+		*dst++ += v;
+	}
+}
+
+template <typename D, typename T>
+void mix_stereo(D* dst, const T* src, int frames, float gain, float step)
+{
+	for (int i = 0, n = frames * 2; i < n; ++i) {
+		dst[i] += static_cast<D>(src[i] * (gain + step * static_cast<float>(i / 2)));
+	}
+}
+
+void clamp_s16(int16_t* dst, const int32_t* src, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		int32_t v = src[i];
+		if (v > 32767) {
+			v = 32767;
+		} else if (v < -32768) {
+			v = -32768;
+		}
+		dst[i] = static_cast<int16_t>(v);
+	}
+}
+
+float peak_f32(const float* src, int count)
+{
+	float peak = 0;
+	for (int i = 0; i < count; ++i) {
+		peak = std::max(peak, fabsf(src[i]));
+	}
+	return peak;
+}
+
+void ramp_s16(int16_t* dst, const float* src, int frames, int channels, float gain, float step)
+{
+	for (int i = 0; i < frames; ++i)
+	{
+		const float g = gain + step * static_cast<float>(i);
+		for (int c = 0; c < channels; ++c) {
+			float v = std::min(std::max(*src++ * g, -32768.0f), 32767.0f);
+			*dst++ = static_cast<int16_t>(static_cast<int32_t>(v));
+		}
+	}
+}
+
+void ramp_f32(float* dst, const float* src, int frames, int channels, float gain, float step)
+{
+	for (int i = 0; i < frames; ++i)
+	{
+		const float g = gain + step * static_cast<float>(i);
+		for (int c = 0; c < channels; ++c) {
+			*dst++ = std::min(std::max(*src++ * g, -1.0f), 1.0f);
+		}
+	}
+}
+
+void resample_f32(float* dst, int frames, float gain, float step, const MixKernel::Resample& r)
+{
+	const float* left = r.src;
+	const float* right = r.channels == 2 ? r.src + r.stride : r.src;
+	uint64_t pos = r.pos;
+	for (int i = 0; i < frames; ++i, pos += r.step)
+	{
+		const float volume = gain + step * static_cast<float>(i);
+		const int idx = static_cast<int>(pos >> 32);
+		const float* coef = r.table + (static_cast<uint32_t>(pos) >> r.phase_shift) * r.taps;
+		float l = 0, rr = 0;
+		for (int k = 0; k < r.taps; ++k) {
+			l += left[idx + k] * coef[k];
+			rr += right[idx + k] * coef[k];
+		}
+		*dst++ += l * volume;
+		*dst++ += rr * volume;
+	}
+}
+
+void add_s32(int32_t* dst, const int32_t* src, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		dst[i] += src[i];
+	}
+}
+
+void add_f32(float* dst, const float* src, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		dst[i] += src[i];
+	}
+}
+
+void add_ramp_f32(float* dst, const float* src, int frames, float gain, float step)
+{
+	for (int i = 0, n = frames * 2; i < n; ++i) {
+		dst[i] += src[i] * (gain + step * static_cast<float>(i / 2));
+	}
+}
+
+void pack_s16(int16_t* dst, const int32_t* const* src, int frames, int channels, int shift)
+{
+	for (int i = 0; i < frames; ++i) {
+		for (int c = 0; c < channels; ++c) {
+			*dst++ = static_cast<int16_t>(src[c][i] >> shift);
+		}
+	}
+}
+
+void decode_ima(int16_t* dst, const uint8_t* src, int blocks, int block_align, int channels)
+{
+	const int words = block_align / (4 * channels) - 1;
+	const int frames = 1 + words * 8;
+	for (int b = 0; b < blocks; ++b, src += block_align, dst += frames * channels)
+	{
+		for (int c = 0; c < channels; ++c)
+		{
+			const uint8_t* header = src + c * 4;
+			int pred = static_cast<int16_t>(header[0] | (header[1] << 8));
+			int index = std::min(static_cast<int>(header[2]), static_cast<int>(ImaAdpcm::MAX_INDEX));
+
+			int16_t* out = dst + c;
+			*out = static_cast<int16_t>(pred);
+			out += channels;
+
+			const uint8_t* word = src + (channels + c) * 4;
+			for (int w = 0; w < words; ++w, word += channels * 4)
+			{
+				for (int k = 0; k < 8; ++k)
+				{
+					const int nibble = (word[k >> 1] >> ((k & 1) * 4)) & 0xf;
+					const int step = ImaAdpcm::STEP_TABLE[index];
+					int diff = step >> 3;
+					if (nibble & 4) {
+						diff += step;
+					}
+					if (nibble & 2) {
+						diff += step >> 1;
+					}
+					if (nibble & 1) {
+						diff += step >> 2;
+					}
+					pred += (nibble & 8) ? -diff : diff;
+					pred = std::min(std::max(pred, -32768), 32767);
+					index = std::min(std::max(index + ImaAdpcm::INDEX_TABLE[nibble], 0), static_cast<int>(ImaAdpcm::MAX_INDEX));
+
+					*out = static_cast<int16_t>(pred);
+					out += channels;
+				}
+			}
+		}
+	}
+}
+
+const MixKernel KERNEL =
+{
+	"scalar",
+	mix_mono<int32_t, int8_t>,
+	mix_stereo<int32_t, int8_t>,
+	mix_mono<int32_t, int16_t>,
+	mix_stereo<int32_t, int16_t>,
+	mix_mono<float, int8_t>,
+	mix_stereo<float, int8_t>,
+	mix_mono<float, int16_t>,
+	mix_stereo<float, int16_t>,
+	clamp_s16,
+	peak_f32,
+	ramp_s16,
+	ramp_f32,
+	resample_f32,
+	add_s32,
+	add_f32,
+	add_ramp_f32,
+	pack_s16,
+	decode_ima,
+};
+
+const MixKernel* select_kernel()
+{
+#ifndef UA_MIX_SCALAR
+	if (const MixKernel* k = MixKernel::AVX2()) {
+		return k;
+	}
+	if (const MixKernel* k = MixKernel::SSE2()) {
+		return k;
+	}
+	if (const MixKernel* k = MixKernel::NEON()) {
+		return k;
+	}
+#endif // UA_MIX_SCALAR
+	return &KERNEL;
+}
+
+}
+
+const MixKernel& MixKernel::Get()
+{
+	static const MixKernel* kernel = select_kernel();
+	return *kernel;
+}
+
+const MixKernel& MixKernel::Scalar()
+{
+	return KERNEL;
+}
+
+}
@@ -0,0 +1,446 @@
+#include "uniaudio/MixKernel.h"
+#include "uniaudio/ImaAdpcm.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define UA_HAS_AVX2
+#endif
+
+#ifdef UA_HAS_AVX2
+
+#include <immintrin.h>
+
+#include <algorithm>
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define UA_TARGET_AVX2
+#else
+#define UA_TARGET_AVX2 __attribute__((target("avx2")))
+#endif // _MSC_VER
+
+namespace ua
+{
+
+namespace
+{
+
+// 8 samples to 8 floats
+UA_TARGET_AVX2
+inline __m256 load(const int8_t* src)
+{
+	__m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+	return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(x));
+}
+
+UA_TARGET_AVX2
+inline __m256 load(const int16_t* src)
+{
+	__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x));
+}
+
+UA_TARGET_AVX2
+inline void accum(int32_t* dst, __m256 v)
+{
+	__m256i* p = reinterpret_cast<__m256i*>(dst);
+	_mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), _mm256_cvttps_epi32(v)));
+}
+
+UA_TARGET_AVX2
+inline void accum(float* dst, __m256 v)
+{
+	_mm256_storeu_ps(dst, _mm256_add_ps(_mm256_loadu_ps(dst), v));
+}
+
+// 8 mono samples, duplicated to 8 stereo frames
+template <typename D>
+UA_TARGET_AVX2
+inline void accum_mono(D* dst, __m256 v)
+{
+	__m256 lo = _mm256_unpacklo_ps(v, v);
+	__m256 hi = _mm256_unpackhi_ps(v, v);
+	accum(dst, _mm256_permute2f128_ps(lo, hi, 0x20));
+	accum(dst + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+
+template <int CH, typename D, typename T>
+UA_TARGET_AVX2
+void mix(D* dst, const T* src, int frames, float gain, float step)
+{
+	// frame index of each lane
+	const __m256i lane = CH == 1 ? _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)
+		: _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	const __m256 g = _mm256_set1_ps(gain), s = _mm256_set1_ps(step);
+
+	const int n = frames * CH;
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8)
+	{
+		__m256i f = _mm256_add_epi32(_mm256_set1_epi32(i / CH), lane);
+		__m256 vol = _mm256_add_ps(g, _mm256_mul_ps(s, _mm256_cvtepi32_ps(f)));
+		__m256 v = _mm256_mul_ps(load(src + i), vol);
+		if (CH == 1) {
+			accum_mono(dst + i * 2, v);
+		} else {
+			accum(dst + i, v);
+		}
+	}
+	for (D* ptr = dst + i * 2 / CH; i < n; ++i)
+	{
+		D v = static_cast<D>(src[i] * (gain + step * static_cast<float>(i / CH)));
+		*ptr++ += v;
+		if (CH == 1) {
+			*ptr++ += v;
+		}
+	}
+}
+
+UA_TARGET_AVX2
+void clamp_s16(int16_t* dst, const int32_t* src, int count)
+{
+	int i = 0;
+	for ( ; i + 16 <= count; i += 16)
+	{
+		__m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		__m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 8));
+		// packs works per 128-bit lane, fix the order afterwards
+		__m256i v = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+	}
+	MixKernel::Scalar().clamp_s16(dst + i, src + i, count - i);
+}
+
+UA_TARGET_AVX2
+float peak_f32(const float* src, int count)
+{
+	const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	__m256 peak = _mm256_setzero_ps();
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8) {
+		peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(src + i), mask));
+	}
+	__m128 p = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+	p = _mm_max_ps(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 0, 3, 2)));
+	p = _mm_max_ps(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 3, 0, 1)));
+	float ret = _mm_cvtss_f32(p);
+	float tail = MixKernel::Scalar().peak_f32(src + i, count - i);
+	return ret > tail ? ret : tail;
+}
+
+UA_TARGET_AVX2
+void ramp_s16(int16_t* dst, const float* src, int frames, int channels, float gain, float step)
+{
+	// frame index of each lane, channels should divide 8
+	const __m256i lane = _mm256_setr_epi32(0 / channels, 1 / channels, 2 / channels, 3 / channels,
+		4 / channels, 5 / channels, 6 / channels, 7 / channels);
+	const __m256 g = _mm256_set1_ps(gain), s = _mm256_set1_ps(step);
+	const __m256 min = _mm256_set1_ps(-32768.0f), max = _mm256_set1_ps(32767.0f);
+
+	const int n = frames * channels;
+	int i = 0;
+	for ( ; i + 16 <= n; i += 16)
+	{
+		__m256i f_lo = _mm256_add_epi32(_mm256_set1_epi32(i / channels), lane);
+		__m256i f_hi = _mm256_add_epi32(_mm256_set1_epi32((i + 8) / channels), lane);
+		__m256 g_lo = _mm256_add_ps(g, _mm256_mul_ps(s, _mm256_cvtepi32_ps(f_lo)));
+		__m256 g_hi = _mm256_add_ps(g, _mm256_mul_ps(s, _mm256_cvtepi32_ps(f_hi)));
+		__m256 lo = _mm256_mul_ps(_mm256_loadu_ps(src + i), g_lo);
+		__m256 hi = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), g_hi);
+		lo = _mm256_min_ps(_mm256_max_ps(lo, min), max);
+		hi = _mm256_min_ps(_mm256_max_ps(hi, min), max);
+		__m256i v = _mm256_packs_epi32(_mm256_cvttps_epi32(lo), _mm256_cvttps_epi32(hi));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(v, 0xd8));
+	}
+	for ( ; i < n; ++i)
+	{
+		float v = src[i] * (gain + step * static_cast<float>(i / channels));
+		v = v < -32768.0f ? -32768.0f : (v > 32767.0f ? 32767.0f : v);
+		dst[i] = static_cast<int16_t>(static_cast<int32_t>(v));
+	}
+}
+
+UA_TARGET_AVX2
+void ramp_f32(float* dst, const float* src, int frames, int channels, float gain, float step)
+{
+	// frame index of each lane, channels should divide 8
+	const __m256i lane = _mm256_setr_epi32(0 / channels, 1 / channels, 2 / channels, 3 / channels,
+		4 / channels, 5 / channels, 6 / channels, 7 / channels);
+	const __m256 g = _mm256_set1_ps(gain), s = _mm256_set1_ps(step);
+	const __m256 min = _mm256_set1_ps(-1.0f), max = _mm256_set1_ps(1.0f);
+
+	const int n = frames * channels;
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8)
+	{
+		__m256i f = _mm256_add_epi32(_mm256_set1_epi32(i / channels), lane);
+		__m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_add_ps(g, _mm256_mul_ps(s, _mm256_cvtepi32_ps(f))));
+		_mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_max_ps(v, min), max));
+	}
+	for ( ; i < n; ++i)
+	{
+		float v = src[i] * (gain + step * static_cast<float>(i / channels));
+		dst[i] = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	}
+}
+
+UA_TARGET_AVX2
+void resample_f32(float* dst, int frames, float gain, float step, const MixKernel::Resample& r)
+{
+	if (r.taps % 8 != 0) {
+		MixKernel::Scalar().resample_f32(dst, frames, gain, step, r);
+		return;
+	}
+
+	const float* left = r.src;
+	const float* right = r.channels == 2 ? r.src + r.stride : r.src;
+	uint64_t pos = r.pos;
+	for (int i = 0; i < frames; ++i, pos += r.step, dst += 2)
+	{
+		const int idx = static_cast<int>(pos >> 32);
+		const float* coef = r.table + (static_cast<uint32_t>(pos) >> r.phase_shift) * r.taps;
+		__m256 l = _mm256_setzero_ps(), rr = _mm256_setzero_ps();
+		for (int k = 0; k < r.taps; k += 8) {
+			__m256 c = _mm256_loadu_ps(coef + k);
+			l = _mm256_add_ps(l, _mm256_mul_ps(_mm256_loadu_ps(left + idx + k), c));
+			rr = _mm256_add_ps(rr, _mm256_mul_ps(_mm256_loadu_ps(right + idx + k), c));
+		}
+		// [l01, l23, r01, r23] per 128 bit half, then fold to [l, r]
+		__m256 h = _mm256_hadd_ps(l, rr);
+		__m128 t = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+		t = _mm_hadd_ps(t, t);
+		t = _mm_mul_ps(t, _mm_set1_ps(gain + step * static_cast<float>(i)));
+		__m128 d = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(dst));
+		_mm_storel_pi(reinterpret_cast<__m64*>(dst), _mm_add_ps(d, t));
+	}
+}
+
+UA_TARGET_AVX2
+void add_s32(int32_t* dst, const int32_t* src, int count)
+{
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8) {
+		__m256i* p = reinterpret_cast<__m256i*>(dst + i);
+		_mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p),
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i))));
+	}
+	MixKernel::Scalar().add_s32(dst + i, src + i, count - i);
+}
+
+UA_TARGET_AVX2
+void add_f32(float* dst, const float* src, int count)
+{
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8) {
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+	}
+	MixKernel::Scalar().add_f32(dst + i, src + i, count - i);
+}
+
+UA_TARGET_AVX2
+void add_ramp_f32(float* dst, const float* src, int frames, float gain, float step)
+{
+	const __m256i lane = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	const __m256 g = _mm256_set1_ps(gain), s = _mm256_set1_ps(step);
+
+	const int n = frames * 2;
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8)
+	{
+		__m256i f = _mm256_add_epi32(_mm256_set1_epi32(i / 2), lane);
+		__m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_add_ps(g, _mm256_mul_ps(s, _mm256_cvtepi32_ps(f))));
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), v));
+	}
+	for ( ; i < n; ++i) {
+		dst[i] += src[i] * (gain + step * static_cast<float>(i / 2));
+	}
+}
+
+UA_TARGET_AVX2
+void pack_s16(int16_t* dst, const int32_t* const* src, int frames, int channels, int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	const int32_t* left = src[0];
+	const int32_t* right = src[channels - 1];
+
+	int i = 0;
+	if (channels == 2)
+	{
+		// packs works per lane, which keeps the frames in order here
+		for ( ; i + 8 <= frames; i += 8)
+		{
+			__m256i l = _mm256_sra_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i)), count);
+			__m256i r = _mm256_sra_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + i)), count);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2),
+				_mm256_packs_epi32(_mm256_unpacklo_epi32(l, r), _mm256_unpackhi_epi32(l, r)));
+		}
+	}
+	else
+	{
+		for ( ; i + 16 <= frames; i += 16)
+		{
+			__m256i a = _mm256_sra_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i)), count);
+			__m256i b = _mm256_sra_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i + 8)), count);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+				_mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+		}
+	}
+
+	const int32_t* rest[2] = { left + i, right + i };
+	MixKernel::Scalar().pack_s16(dst + i * channels, rest, frames - i, channels, shift);
+}
+
+inline int32_t load_u32(const uint8_t* p)
+{
+	int32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+// 8 streams, a channel of a block each, the steps gathered
+UA_TARGET_AVX2
+void decode_ima(int16_t* dst, const uint8_t* src, int blocks, int block_align, int channels)
+{
+	const int words = block_align / (4 * channels) - 1;
+	const int frames = 1 + words * 8;
+	const int group = 8 / channels;
+
+	const __m256i mask = _mm256_set1_epi32(0xf);
+	const __m256i bit0 = _mm256_set1_epi32(1);
+	const __m256i bit1 = _mm256_set1_epi32(2);
+	const __m256i bit2 = _mm256_set1_epi32(4);
+	const __m256i bit3 = _mm256_set1_epi32(8);
+	const __m256i three = _mm256_set1_epi32(3);
+	const __m256i minus1 = _mm256_set1_epi32(-1);
+	const __m256i min_pred = _mm256_set1_epi32(-32768);
+	const __m256i max_pred = _mm256_set1_epi32(32767);
+	const __m256i max_index = _mm256_set1_epi32(ImaAdpcm::MAX_INDEX);
+
+	int b = 0;
+	for ( ; b + group <= blocks; b += group)
+	{
+		const uint8_t* word[8];
+		int16_t* out[8];
+		alignas(32) int32_t lane[8];
+		alignas(32) int32_t first[8];
+		for (int l = 0; l < 8; ++l)
+		{
+			const int c = l % channels;
+			const uint8_t* block = src + (b + l / channels) * block_align;
+			word[l] = block + (channels + c) * 4;
+			out[l] = dst + (b + l / channels) * frames * channels + c;
+			*out[l] = static_cast<int16_t>(block[c * 4] | (block[c * 4 + 1] << 8));
+			first[l] = *out[l];
+			lane[l] = std::min(static_cast<int>(block[c * 4 + 2]), static_cast<int>(ImaAdpcm::MAX_INDEX));
+		}
+		__m256i index = _mm256_load_si256(reinterpret_cast<const __m256i*>(lane));
+		__m256i pred = _mm256_load_si256(reinterpret_cast<const __m256i*>(first));
+
+		for (int w = 0; w < words; ++w)
+		{
+			const int at = w * channels * 4;
+			__m256i bits = _mm256_setr_epi32(load_u32(word[0] + at), load_u32(word[1] + at),
+				load_u32(word[2] + at), load_u32(word[3] + at), load_u32(word[4] + at),
+				load_u32(word[5] + at), load_u32(word[6] + at), load_u32(word[7] + at));
+			for (int k = 0; k < 8; ++k, bits = _mm256_srli_epi32(bits, 4))
+			{
+				const __m256i nibble = _mm256_and_si256(bits, mask);
+				const __m256i step = _mm256_i32gather_epi32(reinterpret_cast<const int*>(ImaAdpcm::STEP_TABLE), index, 4);
+
+				const __m256i has2 = _mm256_cmpeq_epi32(_mm256_and_si256(nibble, bit2), bit2);
+				__m256i diff = _mm256_srai_epi32(step, 3);
+				diff = _mm256_add_epi32(diff, _mm256_and_si256(has2, step));
+				diff = _mm256_add_epi32(diff, _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(nibble, bit1), bit1), _mm256_srai_epi32(step, 1)));
+				diff = _mm256_add_epi32(diff, _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(nibble, bit0), bit0), _mm256_srai_epi32(step, 2)));
+				const __m256i sign = _mm256_cmpeq_epi32(_mm256_and_si256(nibble, bit3), bit3);
+				diff = _mm256_sub_epi32(_mm256_xor_si256(diff, sign), sign);
+
+				pred = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(pred, diff), min_pred), max_pred);
+
+				const __m256i up = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(nibble, three), 1), bit1);
+				index = _mm256_add_epi32(index, _mm256_blendv_epi8(minus1, up, has2));
+				index = _mm256_min_epi32(_mm256_max_epi32(index, _mm256_setzero_si256()), max_index);
+
+				_mm256_store_si256(reinterpret_cast<__m256i*>(lane), pred);
+				const int f = (1 + w * 8 + k) * channels;
+				for (int l = 0; l < 8; ++l) {
+					out[l][f] = static_cast<int16_t>(lane[l]);
+				}
+			}
+		}
+	}
+
+	MixKernel::Scalar().decode_ima(dst + b * frames * channels, src + b * block_align, blocks - b, block_align, channels);
+}
+
+bool cpu_support()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	__cpuid(info, 1);
+	// osxsave and avx, then check the os saves the ymm registers
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) {
+		return false;
+	}
+	if ((_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif // _MSC_VER
+}
+
+const MixKernel KERNEL =
+{
+	"avx2",
+	mix<1, int32_t, int8_t>,
+	mix<2, int32_t, int8_t>,
+	mix<1, int32_t, int16_t>,
+	mix<2, int32_t, int16_t>,
+	mix<1, float, int8_t>,
+	mix<2, float, int8_t>,
+	mix<1, float, int16_t>,
+	mix<2, float, int16_t>,
+	clamp_s16,
+	peak_f32,
+	ramp_s16,
+	ramp_f32,
+	resample_f32,
+	add_s32,
+	add_f32,
+	add_ramp_f32,
+	pack_s16,
+	decode_ima,
+};
+
+}
+
+const MixKernel* MixKernel::AVX2()
+{
+	static const bool supported = cpu_support();
+	return supported ? &KERNEL : nullptr;
+}
+
+}
+
+#else
+
+namespace ua
+{
+
+const MixKernel* MixKernel::AVX2()
+{
+	return nullptr;
+}
+
+}
+
+#endif // UA_HAS_AVX2
@@ -0,0 +1,394 @@
+#include "uniaudio/MixKernel.h"
+#include "uniaudio/ImaAdpcm.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define UA_HAS_NEON
+#endif
+
+#ifdef UA_HAS_NEON
+
+#include <arm_neon.h>
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace ua
+{
+
+namespace
+{
+
+// 8 samples to 2x4 floats
+inline void load(const int8_t* src, float32x4_t& lo, float32x4_t& hi)
+{
+	int16x8_t x = vmovl_s8(vld1_s8(src));
+	lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+	hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+}
+
+inline void load(const int16_t* src, float32x4_t& lo, float32x4_t& hi)
+{
+	int16x8_t x = vld1q_s16(src);
+	lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+	hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+}
+
+inline void accum(int32_t* dst, float32x4_t v)
+{
+	// vcvtq_s32_f32 rounds toward zero, same as the scalar cast
+	vst1q_s32(dst, vaddq_s32(vld1q_s32(dst), vcvtq_s32_f32(v)));
+}
+
+inline void accum(float* dst, float32x4_t v)
+{
+	vst1q_f32(dst, vaddq_f32(vld1q_f32(dst), v));
+}
+
+// 4 mono samples, duplicated to 4 stereo frames
+template <typename D>
+inline void accum_mono(D* dst, float32x4_t v)
+{
+	float32x4x2_t z = vzipq_f32(v, v);
+	accum(dst, z.val[0]);
+	accum(dst + 4, z.val[1]);
+}
+
+template <int CH, typename D, typename T>
+void mix(D* dst, const T* src, int frames, float gain, float step)
+{
+	// frame index of each lane
+	static const int32_t LANES[2][8] = { { 0, 1, 2, 3, 4, 5, 6, 7 }, { 0, 0, 1, 1, 2, 2, 3, 3 } };
+	const int32x4_t lane_lo = vld1q_s32(LANES[CH - 1]), lane_hi = vld1q_s32(LANES[CH - 1] + 4);
+	const float32x4_t g = vdupq_n_f32(gain), s = vdupq_n_f32(step);
+
+	const int n = frames * CH;
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8)
+	{
+		int32x4_t f = vdupq_n_s32(i / CH);
+		float32x4_t g_lo = vaddq_f32(g, vmulq_f32(s, vcvtq_f32_s32(vaddq_s32(f, lane_lo))));
+		float32x4_t g_hi = vaddq_f32(g, vmulq_f32(s, vcvtq_f32_s32(vaddq_s32(f, lane_hi))));
+		float32x4_t lo, hi;
+		load(src + i, lo, hi);
+		lo = vmulq_f32(lo, g_lo);
+		hi = vmulq_f32(hi, g_hi);
+		if (CH == 1) {
+			accum_mono(dst + i * 2, lo);
+			accum_mono(dst + i * 2 + 8, hi);
+		} else {
+			accum(dst + i, lo);
+			accum(dst + i + 4, hi);
+		}
+	}
+	for (D* ptr = dst + i * 2 / CH; i < n; ++i)
+	{
+		D v = static_cast<D>(src[i] * (gain + step * static_cast<float>(i / CH)));
+		*ptr++ += v;
+		if (CH == 1) {
+			*ptr++ += v;
+		}
+	}
+}
+
+void clamp_s16(int16_t* dst, const int32_t* src, int count)
+{
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8)
+	{
+		int16x4_t lo = vqmovn_s32(vld1q_s32(src + i));
+		int16x4_t hi = vqmovn_s32(vld1q_s32(src + i + 4));
+		vst1q_s16(dst + i, vcombine_s16(lo, hi));
+	}
+	MixKernel::Scalar().clamp_s16(dst + i, src + i, count - i);
+}
+
+float peak_f32(const float* src, int count)
+{
+	float32x4_t peak = vdupq_n_f32(0);
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4) {
+		peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(src + i)));
+	}
+	float32x2_t p = vpmax_f32(vget_low_f32(peak), vget_high_f32(peak));
+	p = vpmax_f32(p, p);
+	float ret = vget_lane_f32(p, 0);
+	float tail = MixKernel::Scalar().peak_f32(src + i, count - i);
+	return ret > tail ? ret : tail;
+}
+
+void ramp_s16(int16_t* dst, const float* src, int frames, int channels, float gain, float step)
+{
+	// frame index of each lane, channels should divide 8
+	const int32_t lanes[8] = { 0 / channels, 1 / channels, 2 / channels, 3 / channels,
+		4 / channels, 5 / channels, 6 / channels, 7 / channels };
+	const int32x4_t lane_lo = vld1q_s32(lanes), lane_hi = vld1q_s32(lanes + 4);
+	const float32x4_t g = vdupq_n_f32(gain), s = vdupq_n_f32(step);
+	const float32x4_t min = vdupq_n_f32(-32768.0f), max = vdupq_n_f32(32767.0f);
+
+	const int n = frames * channels;
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8)
+	{
+		int32x4_t f = vdupq_n_s32(i / channels);
+		float32x4_t g_lo = vaddq_f32(g, vmulq_f32(s, vcvtq_f32_s32(vaddq_s32(f, lane_lo))));
+		float32x4_t g_hi = vaddq_f32(g, vmulq_f32(s, vcvtq_f32_s32(vaddq_s32(f, lane_hi))));
+		float32x4_t lo = vmulq_f32(vld1q_f32(src + i), g_lo);
+		float32x4_t hi = vmulq_f32(vld1q_f32(src + i + 4), g_hi);
+		lo = vminq_f32(vmaxq_f32(lo, min), max);
+		hi = vminq_f32(vmaxq_f32(hi, min), max);
+		vst1q_s16(dst + i, vcombine_s16(vmovn_s32(vcvtq_s32_f32(lo)), vmovn_s32(vcvtq_s32_f32(hi))));
+	}
+	for ( ; i < n; ++i)
+	{
+		float v = src[i] * (gain + step * static_cast<float>(i / channels));
+		v = v < -32768.0f ? -32768.0f : (v > 32767.0f ? 32767.0f : v);
+		dst[i] = static_cast<int16_t>(static_cast<int32_t>(v));
+	}
+}
+
+void ramp_f32(float* dst, const float* src, int frames, int channels, float gain, float step)
+{
+	// frame index of each lane, channels should divide 4
+	const int32_t lanes[4] = { 0 / channels, 1 / channels, 2 / channels, 3 / channels };
+	const int32x4_t lane = vld1q_s32(lanes);
+	const float32x4_t g = vdupq_n_f32(gain), s = vdupq_n_f32(step);
+	const float32x4_t min = vdupq_n_f32(-1.0f), max = vdupq_n_f32(1.0f);
+
+	const int n = frames * channels;
+	int i = 0;
+	for ( ; i + 4 <= n; i += 4)
+	{
+		int32x4_t f = vaddq_s32(vdupq_n_s32(i / channels), lane);
+		float32x4_t v = vmulq_f32(vld1q_f32(src + i), vaddq_f32(g, vmulq_f32(s, vcvtq_f32_s32(f))));
+		vst1q_f32(dst + i, vminq_f32(vmaxq_f32(v, min), max));
+	}
+	for ( ; i < n; ++i)
+	{
+		float v = src[i] * (gain + step * static_cast<float>(i / channels));
+		dst[i] = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	}
+}
+
+void resample_f32(float* dst, int frames, float gain, float step, const MixKernel::Resample& r)
+{
+	if (r.taps % 4 != 0) {
+		MixKernel::Scalar().resample_f32(dst, frames, gain, step, r);
+		return;
+	}
+
+	const float* left = r.src;
+	const float* right = r.channels == 2 ? r.src + r.stride : r.src;
+	uint64_t pos = r.pos;
+	for (int i = 0; i < frames; ++i, pos += r.step, dst += 2)
+	{
+		const int idx = static_cast<int>(pos >> 32);
+		const float* coef = r.table + (static_cast<uint32_t>(pos) >> r.phase_shift) * r.taps;
+		float32x4_t l = vdupq_n_f32(0), rr = vdupq_n_f32(0);
+		for (int k = 0; k < r.taps; k += 4) {
+			float32x4_t c = vld1q_f32(coef + k);
+			l = vaddq_f32(l, vmulq_f32(vld1q_f32(left + idx + k), c));
+			rr = vaddq_f32(rr, vmulq_f32(vld1q_f32(right + idx + k), c));
+		}
+		float32x2_t t = vpadd_f32(vadd_f32(vget_low_f32(l), vget_high_f32(l)),
+			vadd_f32(vget_low_f32(rr), vget_high_f32(rr)));
+		vst1_f32(dst, vadd_f32(vld1_f32(dst), vmul_n_f32(t, gain + step * static_cast<float>(i))));
+	}
+}
+
+void add_s32(int32_t* dst, const int32_t* src, int count)
+{
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4) {
+		vst1q_s32(dst + i, vaddq_s32(vld1q_s32(dst + i), vld1q_s32(src + i)));
+	}
+	MixKernel::Scalar().add_s32(dst + i, src + i, count - i);
+}
+
+void add_f32(float* dst, const float* src, int count)
+{
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4) {
+		vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+	}
+	MixKernel::Scalar().add_f32(dst + i, src + i, count - i);
+}
+
+void add_ramp_f32(float* dst, const float* src, int frames, float gain, float step)
+{
+	static const int32_t LANE[4] = { 0, 0, 1, 1 };
+	const int32x4_t lane = vld1q_s32(LANE);
+	const float32x4_t g = vdupq_n_f32(gain), s = vdupq_n_f32(step);
+
+	const int n = frames * 2;
+	int i = 0;
+	for ( ; i + 4 <= n; i += 4)
+	{
+		int32x4_t f = vaddq_s32(vdupq_n_s32(i / 2), lane);
+		float32x4_t vol = vaddq_f32(g, vmulq_f32(s, vcvtq_f32_s32(f)));
+		vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_f32(vld1q_f32(src + i), vol)));
+	}
+	for ( ; i < n; ++i) {
+		dst[i] += src[i] * (gain + step * static_cast<float>(i / 2));
+	}
+}
+
+void pack_s16(int16_t* dst, const int32_t* const* src, int frames, int channels, int shift)
+{
+	// a negative count shifts right
+	const int32x4_t count = vdupq_n_s32(-shift);
+	const int32_t* left = src[0];
+	const int32_t* right = src[channels - 1];
+
+	int i = 0;
+	if (channels == 2)
+	{
+		for ( ; i + 4 <= frames; i += 4)
+		{
+			int16x4x2_t v;
+			v.val[0] = vqmovn_s32(vshlq_s32(vld1q_s32(left + i), count));
+			v.val[1] = vqmovn_s32(vshlq_s32(vld1q_s32(right + i), count));
+			vst2_s16(dst + i * 2, v);
+		}
+	}
+	else
+	{
+		for ( ; i + 8 <= frames; i += 8)
+		{
+			int16x4_t a = vqmovn_s32(vshlq_s32(vld1q_s32(left + i), count));
+			int16x4_t b = vqmovn_s32(vshlq_s32(vld1q_s32(left + i + 4), count));
+			vst1q_s16(dst + i, vcombine_s16(a, b));
+		}
+	}
+
+	const int32_t* rest[2] = { left + i, right + i };
+	MixKernel::Scalar().pack_s16(dst + i * channels, rest, frames - i, channels, shift);
+}
+
+inline uint32_t load_u32(const uint8_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+// 4 streams, a channel of a block each, the steps looked up one by one
+void decode_ima(int16_t* dst, const uint8_t* src, int blocks, int block_align, int channels)
+{
+	const int words = block_align / (4 * channels) - 1;
+	const int frames = 1 + words * 8;
+	const int group = 4 / channels;
+
+	const uint32x4_t mask = vdupq_n_u32(0xf);
+	const int32x4_t minus1 = vdupq_n_s32(-1);
+	const int32x4_t two = vdupq_n_s32(2);
+	const int32x4_t min_pred = vdupq_n_s32(-32768);
+	const int32x4_t max_pred = vdupq_n_s32(32767);
+	const int32x4_t max_index = vdupq_n_s32(ImaAdpcm::MAX_INDEX);
+
+	int b = 0;
+	for ( ; b + group <= blocks; b += group)
+	{
+		const uint8_t* word[4];
+		int16_t* out[4];
+		int32_t lane[4];
+		int32_t first[4];
+		for (int l = 0; l < 4; ++l)
+		{
+			const int c = l % channels;
+			const uint8_t* block = src + (b + l / channels) * block_align;
+			word[l] = block + (channels + c) * 4;
+			out[l] = dst + (b + l / channels) * frames * channels + c;
+			*out[l] = static_cast<int16_t>(block[c * 4] | (block[c * 4 + 1] << 8));
+			first[l] = *out[l];
+			lane[l] = std::min(static_cast<int>(block[c * 4 + 2]), static_cast<int>(ImaAdpcm::MAX_INDEX));
+		}
+		int32x4_t index = vld1q_s32(lane);
+		int32x4_t pred = vld1q_s32(first);
+
+		for (int w = 0; w < words; ++w)
+		{
+			const int at = w * channels * 4;
+			const uint32_t packed[4] = { load_u32(word[0] + at), load_u32(word[1] + at),
+				load_u32(word[2] + at), load_u32(word[3] + at) };
+			uint32x4_t bits = vld1q_u32(packed);
+			for (int k = 0; k < 8; ++k, bits = vshrq_n_u32(bits, 4))
+			{
+				const uint32x4_t nibble = vandq_u32(bits, mask);
+
+				vst1q_s32(lane, index);
+				int32x4_t step = vdupq_n_s32(ImaAdpcm::STEP_TABLE[lane[0]]);
+				step = vsetq_lane_s32(ImaAdpcm::STEP_TABLE[lane[1]], step, 1);
+				step = vsetq_lane_s32(ImaAdpcm::STEP_TABLE[lane[2]], step, 2);
+				step = vsetq_lane_s32(ImaAdpcm::STEP_TABLE[lane[3]], step, 3);
+
+				const uint32x4_t has2 = vtstq_u32(nibble, vdupq_n_u32(4));
+				int32x4_t diff = vshrq_n_s32(step, 3);
+				diff = vaddq_s32(diff, vandq_s32(vreinterpretq_s32_u32(has2), step));
+				diff = vaddq_s32(diff, vandq_s32(vreinterpretq_s32_u32(vtstq_u32(nibble, vdupq_n_u32(2))), vshrq_n_s32(step, 1)));
+				diff = vaddq_s32(diff, vandq_s32(vreinterpretq_s32_u32(vtstq_u32(nibble, vdupq_n_u32(1))), vshrq_n_s32(step, 2)));
+				diff = vbslq_s32(vtstq_u32(nibble, vdupq_n_u32(8)), vnegq_s32(diff), diff);
+
+				pred = vminq_s32(vmaxq_s32(vaddq_s32(pred, diff), min_pred), max_pred);
+
+				const int32x4_t up = vaddq_s32(vshlq_n_s32(vreinterpretq_s32_u32(vandq_u32(nibble, vdupq_n_u32(3))), 1), two);
+				index = vaddq_s32(index, vbslq_s32(has2, up, minus1));
+				index = vminq_s32(vmaxq_s32(index, vdupq_n_s32(0)), max_index);
+
+				vst1q_s32(lane, pred);
+				const int f = (1 + w * 8 + k) * channels;
+				for (int l = 0; l < 4; ++l) {
+					out[l][f] = static_cast<int16_t>(lane[l]);
+				}
+			}
+		}
+	}
+
+	MixKernel::Scalar().decode_ima(dst + b * frames * channels, src + b * block_align, blocks - b, block_align, channels);
+}
+
+const MixKernel KERNEL =
+{
+	"neon",
+	mix<1, int32_t, int8_t>,
+	mix<2, int32_t, int8_t>,
+	mix<1, int32_t, int16_t>,
+	mix<2, int32_t, int16_t>,
+	mix<1, float, int8_t>,
+	mix<2, float, int8_t>,
+	mix<1, float, int16_t>,
+	mix<2, float, int16_t>,
+	clamp_s16,
+	peak_f32,
+	ramp_s16,
+	ramp_f32,
+	resample_f32,
+	add_s32,
+	add_f32,
+	add_ramp_f32,
+	pack_s16,
+	decode_ima,
+};
+
+}
+
+const MixKernel* MixKernel::NEON()
+{
+	return &KERNEL;
+}
+
+}
+
+#else
+
+namespace ua
+{
+
+const MixKernel* MixKernel::NEON()
+{
+	return nullptr;
+}
+
+}
+
+#endif // UA_HAS_NEON
@@ -0,0 +1,398 @@
+#include "uniaudio/MixKernel.h"
+#include "uniaudio/ImaAdpcm.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UA_HAS_SSE2
+#endif
+
+#ifdef UA_HAS_SSE2
+
+#include <emmintrin.h>
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace ua
+{
+
+namespace
+{
+
+// 8 samples to 2x4 floats
+inline void load(const int8_t* src, __m128& lo, __m128& hi)
+{
+	__m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+	x = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+	lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+	hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+}
+
+inline void load(const int16_t* src, __m128& lo, __m128& hi)
+{
+	__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+	hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+}
+
+inline void accum(int32_t* dst, __m128 v)
+{
+	__m128i* p = reinterpret_cast<__m128i*>(dst);
+	_mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), _mm_cvttps_epi32(v)));
+}
+
+inline void accum(float* dst, __m128 v)
+{
+	_mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), v));
+}
+
+// 4 mono samples, duplicated to 4 stereo frames
+template <typename D>
+inline void accum_mono(D* dst, __m128 v)
+{
+	accum(dst, _mm_unpacklo_ps(v, v));
+	accum(dst + 4, _mm_unpackhi_ps(v, v));
+}
+
+template <int CH, typename D, typename T>
+void mix(D* dst, const T* src, int frames, float gain, float step)
+{
+	// frame index of each lane
+	const __m128i lane_lo = CH == 1 ? _mm_setr_epi32(0, 1, 2, 3) : _mm_setr_epi32(0, 0, 1, 1);
+	const __m128i lane_hi = CH == 1 ? _mm_setr_epi32(4, 5, 6, 7) : _mm_setr_epi32(2, 2, 3, 3);
+	const __m128 g = _mm_set1_ps(gain), s = _mm_set1_ps(step);
+
+	const int n = frames * CH;
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8)
+	{
+		__m128i f = _mm_set1_epi32(i / CH);
+		__m128 g_lo = _mm_add_ps(g, _mm_mul_ps(s, _mm_cvtepi32_ps(_mm_add_epi32(f, lane_lo))));
+		__m128 g_hi = _mm_add_ps(g, _mm_mul_ps(s, _mm_cvtepi32_ps(_mm_add_epi32(f, lane_hi))));
+		__m128 lo, hi;
+		load(src + i, lo, hi);
+		lo = _mm_mul_ps(lo, g_lo);
+		hi = _mm_mul_ps(hi, g_hi);
+		if (CH == 1) {
+			accum_mono(dst + i * 2, lo);
+			accum_mono(dst + i * 2 + 8, hi);
+		} else {
+			accum(dst + i, lo);
+			accum(dst + i + 4, hi);
+		}
+	}
+	for (D* ptr = dst + i * 2 / CH; i < n; ++i)
+	{
+		D v = static_cast<D>(src[i] * (gain + step * static_cast<float>(i / CH)));
+		*ptr++ += v;
+		if (CH == 1) {
+			*ptr++ += v;
+		}
+	}
+}
+
+void clamp_s16(int16_t* dst, const int32_t* src, int count)
+{
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8)
+	{
+		__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+	}
+	MixKernel::Scalar().clamp_s16(dst + i, src + i, count - i);
+}
+
+float peak_f32(const float* src, int count)
+{
+	const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 peak = _mm_setzero_ps();
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4) {
+		peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(src + i), mask));
+	}
+	peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 0, 3, 2)));
+	peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(2, 3, 0, 1)));
+	float ret = _mm_cvtss_f32(peak);
+	float tail = MixKernel::Scalar().peak_f32(src + i, count - i);
+	return ret > tail ? ret : tail;
+}
+
+void ramp_s16(int16_t* dst, const float* src, int frames, int channels, float gain, float step)
+{
+	// frame index of each lane, channels should divide 8
+	const __m128i lane_lo = _mm_setr_epi32(0 / channels, 1 / channels, 2 / channels, 3 / channels);
+	const __m128i lane_hi = _mm_setr_epi32(4 / channels, 5 / channels, 6 / channels, 7 / channels);
+	const __m128 g = _mm_set1_ps(gain), s = _mm_set1_ps(step);
+	const __m128 min = _mm_set1_ps(-32768.0f), max = _mm_set1_ps(32767.0f);
+
+	const int n = frames * channels;
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8)
+	{
+		__m128i f = _mm_set1_epi32(i / channels);
+		__m128 g_lo = _mm_add_ps(g, _mm_mul_ps(s, _mm_cvtepi32_ps(_mm_add_epi32(f, lane_lo))));
+		__m128 g_hi = _mm_add_ps(g, _mm_mul_ps(s, _mm_cvtepi32_ps(_mm_add_epi32(f, lane_hi))));
+		__m128 lo = _mm_mul_ps(_mm_loadu_ps(src + i), g_lo);
+		__m128 hi = _mm_mul_ps(_mm_loadu_ps(src + i + 4), g_hi);
+		lo = _mm_min_ps(_mm_max_ps(lo, min), max);
+		hi = _mm_min_ps(_mm_max_ps(hi, min), max);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+			_mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi)));
+	}
+	for ( ; i < n; ++i)
+	{
+		float v = src[i] * (gain + step * static_cast<float>(i / channels));
+		v = v < -32768.0f ? -32768.0f : (v > 32767.0f ? 32767.0f : v);
+		dst[i] = static_cast<int16_t>(static_cast<int32_t>(v));
+	}
+}
+
+void ramp_f32(float* dst, const float* src, int frames, int channels, float gain, float step)
+{
+	// frame index of each lane, channels should divide 4
+	const __m128i lane = _mm_setr_epi32(0 / channels, 1 / channels, 2 / channels, 3 / channels);
+	const __m128 g = _mm_set1_ps(gain), s = _mm_set1_ps(step);
+	const __m128 min = _mm_set1_ps(-1.0f), max = _mm_set1_ps(1.0f);
+
+	const int n = frames * channels;
+	int i = 0;
+	for ( ; i + 4 <= n; i += 4)
+	{
+		__m128i f = _mm_add_epi32(_mm_set1_epi32(i / channels), lane);
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), _mm_add_ps(g, _mm_mul_ps(s, _mm_cvtepi32_ps(f))));
+		_mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(v, min), max));
+	}
+	for ( ; i < n; ++i)
+	{
+		float v = src[i] * (gain + step * static_cast<float>(i / channels));
+		dst[i] = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	}
+}
+
+void resample_f32(float* dst, int frames, float gain, float step, const MixKernel::Resample& r)
+{
+	if (r.taps % 4 != 0) {
+		MixKernel::Scalar().resample_f32(dst, frames, gain, step, r);
+		return;
+	}
+
+	const float* left = r.src;
+	const float* right = r.channels == 2 ? r.src + r.stride : r.src;
+	uint64_t pos = r.pos;
+	for (int i = 0; i < frames; ++i, pos += r.step, dst += 2)
+	{
+		const int idx = static_cast<int>(pos >> 32);
+		const float* coef = r.table + (static_cast<uint32_t>(pos) >> r.phase_shift) * r.taps;
+		__m128 l = _mm_setzero_ps(), rr = _mm_setzero_ps();
+		for (int k = 0; k < r.taps; k += 4) {
+			__m128 c = _mm_loadu_ps(coef + k);
+			l = _mm_add_ps(l, _mm_mul_ps(_mm_loadu_ps(left + idx + k), c));
+			rr = _mm_add_ps(rr, _mm_mul_ps(_mm_loadu_ps(right + idx + k), c));
+		}
+		// [l0+l2, r0+r2, l1+l3, r1+r3], then fold the high half
+		__m128 t = _mm_add_ps(_mm_unpacklo_ps(l, rr), _mm_unpackhi_ps(l, rr));
+		const __m128 vol = _mm_set1_ps(gain + step * static_cast<float>(i));
+		t = _mm_mul_ps(_mm_add_ps(t, _mm_movehl_ps(t, t)), vol);
+		__m128 d = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(dst));
+		_mm_storel_pi(reinterpret_cast<__m64*>(dst), _mm_add_ps(d, t));
+	}
+}
+
+void add_s32(int32_t* dst, const int32_t* src, int count)
+{
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4) {
+		__m128i* p = reinterpret_cast<__m128i*>(dst + i);
+		_mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+	}
+	MixKernel::Scalar().add_s32(dst + i, src + i, count - i);
+}
+
+void add_f32(float* dst, const float* src, int count)
+{
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+	}
+	MixKernel::Scalar().add_f32(dst + i, src + i, count - i);
+}
+
+void add_ramp_f32(float* dst, const float* src, int frames, float gain, float step)
+{
+	const __m128i lane = _mm_setr_epi32(0, 0, 1, 1);
+	const __m128 g = _mm_set1_ps(gain), s = _mm_set1_ps(step);
+
+	const int n = frames * 2;
+	int i = 0;
+	for ( ; i + 4 <= n; i += 4)
+	{
+		__m128i f = _mm_add_epi32(_mm_set1_epi32(i / 2), lane);
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), _mm_add_ps(g, _mm_mul_ps(s, _mm_cvtepi32_ps(f))));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), v));
+	}
+	for ( ; i < n; ++i) {
+		dst[i] += src[i] * (gain + step * static_cast<float>(i / 2));
+	}
+}
+
+void pack_s16(int16_t* dst, const int32_t* const* src, int frames, int channels, int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	const int32_t* left = src[0];
+	const int32_t* right = src[channels - 1];
+
+	int i = 0;
+	if (channels == 2)
+	{
+		for ( ; i + 4 <= frames; i += 4)
+		{
+			__m128i l = _mm_sra_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i)), count);
+			__m128i r = _mm_sra_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i)), count);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2),
+				_mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r)));
+		}
+	}
+	else
+	{
+		for ( ; i + 8 <= frames; i += 8)
+		{
+			__m128i a = _mm_sra_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i)), count);
+			__m128i b = _mm_sra_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i + 4)), count);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+		}
+	}
+
+	const int32_t* rest[2] = { left + i, right + i };
+	MixKernel::Scalar().pack_s16(dst + i * channels, rest, frames - i, channels, shift);
+}
+
+inline int32_t load_u32(const uint8_t* p)
+{
+	int32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+// 4 streams, a channel of a block each, the steps looked up one by one
+void decode_ima(int16_t* dst, const uint8_t* src, int blocks, int block_align, int channels)
+{
+	const int words = block_align / (4 * channels) - 1;
+	const int frames = 1 + words * 8;
+	const int group = 4 / channels;
+
+	const __m128i mask = _mm_set1_epi32(0xf);
+	const __m128i bit0 = _mm_set1_epi32(1);
+	const __m128i bit1 = _mm_set1_epi32(2);
+	const __m128i bit2 = _mm_set1_epi32(4);
+	const __m128i bit3 = _mm_set1_epi32(8);
+	const __m128i minus1 = _mm_set1_epi32(-1);
+	const __m128i max_index = _mm_set1_epi32(ImaAdpcm::MAX_INDEX);
+
+	int b = 0;
+	for ( ; b + group <= blocks; b += group)
+	{
+		const uint8_t* word[4];
+		int16_t* out[4];
+		alignas(16) int32_t lane[4];
+		for (int l = 0; l < 4; ++l)
+		{
+			const int c = l % channels;
+			const uint8_t* block = src + (b + l / channels) * block_align;
+			word[l] = block + (channels + c) * 4;
+			out[l] = dst + (b + l / channels) * frames * channels + c;
+			*out[l] = static_cast<int16_t>(block[c * 4] | (block[c * 4 + 1] << 8));
+			lane[l] = std::min(static_cast<int>(block[c * 4 + 2]), static_cast<int>(ImaAdpcm::MAX_INDEX));
+		}
+		__m128i index = _mm_load_si128(reinterpret_cast<const __m128i*>(lane));
+		__m128i pred = _mm_setr_epi32(*out[0], *out[1], *out[2], *out[3]);
+
+		for (int w = 0; w < words; ++w)
+		{
+			const int at = w * channels * 4;
+			__m128i bits = _mm_setr_epi32(load_u32(word[0] + at), load_u32(word[1] + at),
+				load_u32(word[2] + at), load_u32(word[3] + at));
+			for (int k = 0; k < 8; ++k, bits = _mm_srli_epi32(bits, 4))
+			{
+				const __m128i nibble = _mm_and_si128(bits, mask);
+
+				_mm_store_si128(reinterpret_cast<__m128i*>(lane), index);
+				const __m128i step = _mm_setr_epi32(ImaAdpcm::STEP_TABLE[lane[0]], ImaAdpcm::STEP_TABLE[lane[1]],
+					ImaAdpcm::STEP_TABLE[lane[2]], ImaAdpcm::STEP_TABLE[lane[3]]);
+
+				const __m128i has2 = _mm_cmpeq_epi32(_mm_and_si128(nibble, bit2), bit2);
+				__m128i diff = _mm_srai_epi32(step, 3);
+				diff = _mm_add_epi32(diff, _mm_and_si128(has2, step));
+				diff = _mm_add_epi32(diff, _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(nibble, bit1), bit1), _mm_srai_epi32(step, 1)));
+				diff = _mm_add_epi32(diff, _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(nibble, bit0), bit0), _mm_srai_epi32(step, 2)));
+				// negated by the sign bit
+				const __m128i sign = _mm_cmpeq_epi32(_mm_and_si128(nibble, bit3), bit3);
+				diff = _mm_sub_epi32(_mm_xor_si128(diff, sign), sign);
+
+				// clamped through a saturating pack
+				pred = _mm_packs_epi32(_mm_add_epi32(pred, diff), pred);
+				pred = _mm_srai_epi32(_mm_unpacklo_epi16(pred, pred), 16);
+
+				// -1, or 2, 4, 6, 8 with the high bit, in 0 to 88 by 16 bit
+				// min and max, the high halves are all 0 or all 1
+				const __m128i up = _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(nibble, _mm_set1_epi32(3)), 1), bit1);
+				index = _mm_add_epi32(index, _mm_or_si128(_mm_and_si128(has2, up), _mm_andnot_si128(has2, minus1)));
+				index = _mm_min_epi16(_mm_max_epi16(index, _mm_setzero_si128()), max_index);
+
+				_mm_store_si128(reinterpret_cast<__m128i*>(lane), pred);
+				const int f = (1 + w * 8 + k) * channels;
+				for (int l = 0; l < 4; ++l) {
+					out[l][f] = static_cast<int16_t>(lane[l]);
+				}
+			}
+		}
+	}
+
+	MixKernel::Scalar().decode_ima(dst + b * frames * channels, src + b * block_align, blocks - b, block_align, channels);
+}
+
+const MixKernel KERNEL =
+{
+	"sse2",
+	mix<1, int32_t, int8_t>,
+	mix<2, int32_t, int8_t>,
+	mix<1, int32_t, int16_t>,
+	mix<2, int32_t, int16_t>,
+	mix<1, float, int8_t>,
+	mix<2, float, int8_t>,
+	mix<1, float, int16_t>,
+	mix<2, float, int16_t>,
+	clamp_s16,
+	peak_f32,
+	ramp_s16,
+	ramp_f32,
+	resample_f32,
+	add_s32,
+	add_f32,
+	add_ramp_f32,
+	pack_s16,
+	decode_ima,
+};
+
+}
+
+const MixKernel* MixKernel::SSE2()
+{
+	return &KERNEL;
+}
+
+}
+
+#else
+
+namespace ua
+{
+
+const MixKernel* MixKernel::SSE2()
+{
+	return nullptr;
+}
+
+}
+
+#endif // UA_HAS_SSE2
@@ -60,7 +60,7 @@ Decoder* Mpg123Decoder::Clone()
 	return new Mpg123Decoder(*this);
 }
 
-int Mpg123Decoder::Decode()
+int Mpg123Decoder::Decode(unsigned char* dst, int buf_sz)
 {
 	if (!m_handle) {
 		return 0;
@@ -68,10 +68,10 @@ int Mpg123Decoder::Decode()
 
 	int size = 0;
 
-	while (size < m_buf_size && !m_eof)
+	while (size < buf_sz && !m_eof)
 	{
 		size_t numbytes = 0;
-		int ret = mpg123_read(m_handle, m_buf + size, m_buf_size - size, &numbytes);
+		int ret = mpg123_read(m_handle, dst + size, buf_sz - size, &numbytes);
 		switch (ret)
 		{
 		case MPG123_NEED_MORE:
@@ -110,6 +110,21 @@ bool Mpg123Decoder::Seek(float s)
 	}
 }
 
+bool Mpg123Decoder::SeekFrame(int64_t frame)
+{
+	if (!m_handle || frame < 0) {
+		return false;
+	}
+
+	// in samples past the encoder delay, with MPG123_GAPLESS
+	if (mpg123_seek(m_handle, (off_t) frame, SEEK_SET) >= 0) {
+		m_eof = false;
+		return true;
+	} else {
+		return false;
+	}
+}
+
 bool Mpg123Decoder::Rewind()
 {
 	if (!m_handle) {
@@ -161,7 +176,9 @@ static ssize_t read_callback(void* udata, void* buffer, size_t count)
 		return 0;
 	}
 
-	fs_file* file = static_cast<fs_file*>(udata);
+	Mpg123Decoder::Reader* reader = static_cast<Mpg123Decoder::Reader*>(udata);
+	fs_file* file = reader->file;
+	Decoder::IoTimer timer(reader->decoder);
 
 	// Calculates how much data is still left and takes that value or
 	// the buffer size, whichever is lower, as the number of bytes to write.
@@ -182,7 +199,7 @@ static off_t seek_callback(void* udata, off_t offset, int whence)
 		return -1;
 	}
 
-	fs_file* file = static_cast<fs_file*>(udata);
+	fs_file* file = static_cast<Mpg123Decoder::Reader*>(udata)->file;
 
 	switch (whence)
 	{
@@ -241,6 +258,8 @@ void Mpg123Decoder::InitHandle()
 
 	// Suppressing all mpg123 messages.
 	mpg123_param(m_handle, MPG123_ADD_FLAGS, MPG123_QUIET, 0);
+	// trims the encoder delay and padding, loops have no silent seam
+	mpg123_param(m_handle, MPG123_ADD_FLAGS, MPG123_GAPLESS, 0);
 
 	int ret = mpg123_replace_reader_handle(m_handle, &read_callback, &seek_callback, &cleanup_callback);
 	if (ret != MPG123_OK) {
@@ -249,7 +268,9 @@ void Mpg123Decoder::InitHandle()
 		return;
 	}
 
-	ret = mpg123_open_handle(m_handle, m_file);
+	m_reader.file = m_file;
+	m_reader.decoder = this;
+	ret = mpg123_open_handle(m_handle, &m_reader);
 	if (ret != MPG123_OK) {
 		mpg123_delete(m_handle);
 		m_handle = nullptr;
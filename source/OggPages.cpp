@@ -0,0 +1,148 @@
+#if defined(UA_SUPPORT_VORBIS) || defined(UA_SUPPORT_OPUS)
+
+#include "uniaudio/OggPages.h"
+
+#include <string.h>
+
+namespace ua
+{
+
+// the page at `pos` of the file, pointing into it
+static bool
+page_at(const unsigned char* data, size_t size, size_t pos, ogg_page& og, size_t& len)
+{
+	if (pos + 27 > size || memcmp(data + pos, "OggS", 4) != 0 || data[pos + 4] != 0) {
+		return false;
+	}
+
+	const int segs = data[pos + 26];
+	const size_t header = 27 + segs;
+	if (pos + header > size) {
+		return false;
+	}
+	size_t body = 0;
+	for (int i = 0; i < segs; ++i) {
+		body += data[pos + 27 + i];
+	}
+	if (pos + header + body > size) {
+		return false;
+	}
+
+	// libogg only reads them
+	og.header     = const_cast<unsigned char*>(data + pos);
+	og.header_len = static_cast<long>(header);
+	og.body       = const_cast<unsigned char*>(data + pos + header);
+	og.body_len   = static_cast<long>(body);
+	len = header + body;
+	return true;
+}
+
+OggPages::OggPages(const CU_STR& filepath)
+	: m_file(filepath)
+{
+}
+
+bool OggPages::Next(size_t& pos, ogg_page& og) const
+{
+	const unsigned char* data = m_file.GetData();
+	const size_t size = m_file.GetSize();
+	while (pos < size)
+	{
+		size_t len;
+		if (page_at(data, size, pos, og, len)) {
+			pos += len;
+			return true;
+		}
+
+		// lost sync, on to the next capture pattern
+		const void* next = pos + 1 < size ? memchr(data + pos + 1, 'O', size - pos - 1) : nullptr;
+		if (!next) {
+			break;
+		}
+		pos = static_cast<const unsigned char*>(next) - data;
+	}
+
+	pos = size;
+	return false;
+}
+
+int64_t OggPages::GetLastGranule(int serial, size_t begin) const
+{
+	const unsigned char* data = m_file.GetData();
+	const size_t size = m_file.GetSize();
+	for (size_t p = size; p > begin; )
+	{
+		--p;
+		ogg_page og;
+		size_t len;
+		if (data[p] == 'O' && page_at(data, size, p, og, len) &&
+			ogg_page_serialno(&og) == serial && ogg_page_granulepos(&og) >= 0) {
+			return ogg_page_granulepos(&og);
+		}
+	}
+	return -1;
+}
+
+int64_t OggPages::GetStartGranule(int serial, size_t pos, const PacketFrames& frames) const
+{
+	ogg_stream_state os;
+	ogg_stream_init(&os, serial);
+
+	int64_t ret = -1;
+	int64_t count = 0;
+	bool done = false;
+	ogg_page og;
+	while (!done && Next(pos, og))
+	{
+		if (ogg_stream_pagein(&os, &og) != 0) {
+			continue;
+		}
+
+		ogg_packet op;
+		int r;
+		while ((r = ogg_stream_packetout(&os, &op)) != 0)
+		{
+			if (r < 0) {
+				continue;
+			}
+			const int64_t n = frames(op);
+			if (n < 0) {
+				continue;
+			}
+			count += n;
+
+			if (op.granulepos >= 0) {
+				// the last page may be trimmed
+				if (!op.e_o_s) {
+					ret = op.granulepos - count;
+				}
+				done = true;
+				break;
+			}
+		}
+	}
+
+	ogg_stream_clear(&os);
+	return ret;
+}
+
+const CU_VEC<OggPages::Page>& OggPages::GetIndex(int serial, size_t begin)
+{
+	std::call_once(m_index_once, [this, serial, begin]()
+	{
+		size_t pos = begin;
+		ogg_page og;
+		while (Next(pos, og))
+		{
+			const int64_t granule = ogg_page_granulepos(&og);
+			if (ogg_page_serialno(&og) == serial && granule >= 0) {
+				m_index.push_back({ pos, granule });
+			}
+		}
+	});
+	return m_index;
+}
+
+}
+
+#endif // UA_SUPPORT_VORBIS || UA_SUPPORT_OPUS
\ No newline at end of file
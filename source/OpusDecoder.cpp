@@ -0,0 +1,347 @@
+#ifdef UA_SUPPORT_OPUS
+
+#include "uniaudio/OpusDecoder.h"
+#include "uniaudio/OggPages.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace ua
+{
+
+struct OpusDecoder::Stream : private cu::Uncopyable
+{
+	Stream(const std::string& filepath);
+
+	// of the first packet decoded from the page at `pos`, -1 if the stream
+	// ends before a granule position tells
+	int64_t GetStartGranule(size_t pos);
+
+	OggPages pages;
+	bool valid;
+
+	int channels;
+	// frames dropped at the start, the encoder's delay
+	int pre_skip;
+	// Q7.8 dB
+	int gain;
+
+	int serial;
+	// the first audio page
+	size_t  data_begin;
+	// granule position of the end, pre-skip included
+	int64_t end_granule;
+
+}; // OpusDecoder::Stream
+
+// the identification header, mapping family 0 only: one Opus stream,
+// mono or stereo
+static bool
+parse_head(const ogg_packet& op, int& channels, int& pre_skip, int& gain)
+{
+	const unsigned char* p = op.packet;
+	if (op.bytes < 19 || memcmp(p, "OpusHead", 8) != 0) {
+		return false;
+	}
+	// major version 0
+	if ((p[8] >> 4) != 0 || p[18] != 0) {
+		return false;
+	}
+
+	channels = p[9];
+	pre_skip = p[10] | (p[11] << 8);
+	gain     = static_cast<int16_t>(p[16] | (p[17] << 8));
+	return channels >= 1 && channels <= 2;
+}
+
+OpusDecoder::Stream::Stream(const std::string& filepath)
+	: pages(filepath)
+	, valid(false)
+	, channels(0)
+	, pre_skip(0)
+	, gain(0)
+	, serial(0)
+	, data_begin(0)
+	, end_granule(0)
+{
+	// OpusHead then OpusTags, the audio starts on a new page
+	ogg_stream_state os;
+	bool os_inited = false;
+	int headers = 0;
+	size_t pos = 0;
+	ogg_page og;
+	while (headers < 2 && pages.Next(pos, og))
+	{
+		if (!os_inited) {
+			serial = ogg_page_serialno(&og);
+			ogg_stream_init(&os, serial);
+			os_inited = true;
+		}
+		if (ogg_stream_pagein(&os, &og) != 0) {
+			continue;
+		}
+
+		ogg_packet op;
+		while (headers < 2 && ogg_stream_packetout(&os, &op) > 0)
+		{
+			const bool ok = headers == 0
+				? parse_head(op, channels, pre_skip, gain)
+				: op.bytes >= 8 && memcmp(op.packet, "OpusTags", 8) == 0;
+			if (!ok) {
+				ogg_stream_clear(&os);
+				return;
+			}
+			++headers;
+		}
+	}
+	if (os_inited) {
+		ogg_stream_clear(&os);
+	}
+	if (headers < 2) {
+		return;
+	}
+	data_begin = pos;
+
+	// the length, from the last granule position
+	end_granule = std::max<int64_t>(pages.GetLastGranule(serial, data_begin), pre_skip);
+
+	valid = true;
+}
+
+int64_t OpusDecoder::Stream::GetStartGranule(size_t pos)
+{
+	// every packet decodes to the samples its TOC tells
+	return pages.GetStartGranule(serial, pos, [](ogg_packet& op) -> int64_t {
+		return std::max(opus_packet_get_nb_samples(op.packet, static_cast<opus_int32>(op.bytes), SAMPLE_RATE), 0);
+	});
+}
+
+OpusDecoder::OpusDecoder(const std::string& filepath, int buf_sz)
+	: Decoder(buf_sz)
+	, m_stream(std::make_shared<Stream>(filepath))
+	, m_handle(nullptr)
+	, m_pos(0)
+	, m_granule(0)
+	, m_skip(0)
+	, m_pcm_begin(0)
+	, m_pcm_end(0)
+{
+	// empty, like a file mpg123 could not open
+	if (!m_stream->valid) {
+		m_stream.reset();
+		return;
+	}
+
+	m_sample_rate = SAMPLE_RATE;
+	m_length = static_cast<int>(m_stream->end_granule - m_stream->pre_skip);
+	Init();
+}
+
+OpusDecoder::OpusDecoder(const OpusDecoder& src)
+	: Decoder(src)
+	, m_stream(src.m_stream)
+	, m_handle(nullptr)
+	, m_pos(0)
+	, m_granule(0)
+	, m_skip(0)
+	, m_pcm_begin(0)
+	, m_pcm_end(0)
+{
+	if (m_stream) {
+		Init();
+	}
+}
+
+OpusDecoder::~OpusDecoder()
+{
+	if (m_stream) {
+		ogg_stream_clear(&m_ogg);
+	}
+	if (m_handle) {
+		opus_decoder_destroy(m_handle);
+	}
+}
+
+Decoder* OpusDecoder::Clone()
+{
+	return new OpusDecoder(*this);
+}
+
+int OpusDecoder::Decode(unsigned char* dst, int size)
+{
+	if (!m_handle) {
+		return 0;
+	}
+
+	const int channels = m_stream->channels;
+	const int frames = size / (channels * 2);
+	opus_int16* out = reinterpret_cast<opus_int16*>(dst);
+
+	int total = 0;
+	while (total < frames)
+	{
+		if (m_pcm_begin == m_pcm_end)
+		{
+			if (!DecodePacket()) {
+				m_eof = true;
+				break;
+			}
+			continue;
+		}
+
+		const int n = std::min(m_pcm_end - m_pcm_begin, frames - total);
+		memcpy(out + total * channels, &m_pcm[m_pcm_begin * channels], n * channels * sizeof(opus_int16));
+		m_pcm_begin += n;
+		total += n;
+	}
+
+	return total * channels * 2;
+}
+
+bool OpusDecoder::Seek(float s)
+{
+	if (s < 0) {
+		return false;
+	}
+	return SeekFrame(static_cast<int64_t>(s * static_cast<double>(m_sample_rate)));
+}
+
+bool OpusDecoder::SeekFrame(int64_t frame)
+{
+	if (!m_handle || frame < 0 || frame > m_stream->end_granule - m_stream->pre_skip) {
+		return false;
+	}
+
+	Stream& s = *m_stream;
+	const CU_VEC<OggPages::Page>& index = s.pages.GetIndex(s.serial, s.data_begin);
+
+	// in granule positions, from a page at least PRE_ROLL before
+	const int64_t target = frame + s.pre_skip;
+	auto itr = std::upper_bound(index.begin(), index.end(), target - PRE_ROLL,
+		[](int64_t g, const OggPages::Page& p) { return g < p.granule; });
+	while (itr != index.begin())
+	{
+		--itr;
+		const int64_t start = s.GetStartGranule(itr->end);
+		if (start >= 0 && start <= target - PRE_ROLL) {
+			Restart(itr->end, start, target - start);
+			return true;
+		}
+	}
+
+	Restart(s.data_begin, 0, target);
+	return true;
+}
+
+bool OpusDecoder::Rewind()
+{
+	if (!m_handle) {
+		return false;
+	}
+
+	Restart(m_stream->data_begin, 0, m_stream->pre_skip);
+	return true;
+}
+
+int OpusDecoder::GetChannels() const
+{
+	return m_stream ? m_stream->channels : DEFAULT_CHANNELS;
+}
+
+int OpusDecoder::GetBitDepth() const
+{
+	return 16;
+}
+
+float OpusDecoder::GetDuration() const
+{
+	if (!m_stream || m_length == 0) {
+		return 0;
+	}
+	return static_cast<float>(static_cast<double>(m_length) / SAMPLE_RATE);
+}
+
+bool OpusDecoder::Accepts(const CU_STR& ext)
+{
+	return ext == "opus";
+}
+
+void OpusDecoder::Init()
+{
+	ogg_stream_init(&m_ogg, m_stream->serial);
+
+	int err;
+	m_handle = opus_decoder_create(SAMPLE_RATE, m_stream->channels, &err);
+	if (err != OPUS_OK) {
+		m_handle = nullptr;
+		return;
+	}
+	// the header's output gain
+	if (m_stream->gain != 0) {
+		opus_decoder_ctl(m_handle, OPUS_SET_GAIN(m_stream->gain));
+	}
+	m_pcm.resize(MAX_PACKET * m_stream->channels);
+
+	Restart(m_stream->data_begin, 0, m_stream->pre_skip);
+}
+
+bool OpusDecoder::DecodePacket()
+{
+	ogg_packet op;
+	while (true)
+	{
+		int ret = ogg_stream_packetout(&m_ogg, &op);
+		if (ret > 0) {
+			break;
+		}
+		// a hole in the data
+		if (ret < 0) {
+			continue;
+		}
+
+		ogg_page og;
+		if (!m_stream->pages.Next(m_pos, og)) {
+			return false;
+		}
+		// refuses the pages of other logical streams
+		ogg_stream_pagein(&m_ogg, &og);
+	}
+
+	const opus_int32 bytes = static_cast<opus_int32>(op.bytes);
+	int n = opus_decode(m_handle, op.packet, bytes, &m_pcm[0], MAX_PACKET, 0);
+	if (n < 0)
+	{
+		// damaged, silence keeps the granule positions right
+		n = std::min(std::max(opus_packet_get_nb_samples(op.packet, bytes, SAMPLE_RATE), 0), static_cast<int>(MAX_PACKET));
+		memset(&m_pcm[0], 0, n * m_stream->channels * sizeof(opus_int16));
+	}
+
+	const int64_t begin = m_granule;
+	m_granule += n;
+
+	// the pre-skip or up to a seek target, and nothing past the end
+	const int skip = static_cast<int>(std::min<int64_t>(n, m_skip));
+	m_skip -= skip;
+	const int end = static_cast<int>(std::min<int64_t>(n, std::max<int64_t>(m_stream->end_granule - begin, 0)));
+
+	m_pcm_begin = skip;
+	m_pcm_end = std::max(end, skip);
+	return true;
+}
+
+void OpusDecoder::Restart(size_t pos, int64_t granule, int64_t skip)
+{
+	ogg_stream_reset(&m_ogg);
+	opus_decoder_ctl(m_handle, OPUS_RESET_STATE);
+
+	m_pos = pos;
+	m_granule = granule;
+	m_skip = skip;
+	m_pcm_begin = m_pcm_end = 0;
+	m_eof = false;
+}
+
+}
+
+#endif // UA_SUPPORT_OPUS
\ No newline at end of file
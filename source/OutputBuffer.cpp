@@ -1,97 +1,168 @@
 #include "uniaudio/OutputBuffer.h"
+#include "uniaudio/BufferPool.h"
 #include "uniaudio/Exception.h"
 
 #include <algorithm>
 
+#include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
 namespace ua
 {
 
-OutputBuffer::OutputBuffer(int count, int size)
-	: m_full(false)
+OutputBuffer::OutputBuffer(int count, int size, const std::shared_ptr<BufferPool>& pool)
+	: m_pool(pool)
+	, m_data(nullptr)
+	, m_data_size(0)
+	, m_sizes(nullptr)
+	, m_slot_size(0)
+	, m_stride(0)
+	, m_count(0)
+	, m_mask(0)
+	, m_write(0)
+	, m_fill(0)
+	, m_end(0)
+	, m_depth(0)
+	, m_read(0)
+	, m_held(false)
+	, m_starved(false)
+	, m_underruns(0)
 {
 	Init(count, size);
 }
 
 OutputBuffer::~OutputBuffer()
 {
-	std::list<Buffer*>::iterator itr = m_bufs.begin();
-	for ( ; itr != m_bufs.end(); ++itr) {
-		delete *itr;
+	if (m_data)
+	{
+		if (m_pool) {
+			m_pool->Free(m_data, m_data_size);
+		} else {
+			free(m_data);
+		}
 	}
 }
 
 int OutputBuffer::Input(const unsigned char* buf, int buf_sz)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-
-	if (m_full) {
-		return 0;
-	}
-
 	int fill_sz = 0;
-
-	const unsigned char* ptr = buf;
-	std::list<Buffer*>::iterator itr = m_bufs.begin();
-	for ( ; itr != m_bufs.end(); ++itr)
+	while (fill_sz < buf_sz)
 	{
-		Buffer* dst = *itr;
-		if (dst->size >= dst->cap) {
-			continue;
-		}
-		int sz = std::min(static_cast<int>(dst->cap - dst->size), buf_sz - fill_sz);
-		memcpy(&dst->buf[dst->size], ptr, sz);
-		dst->size += sz;
-		ptr += sz;
-		fill_sz += sz;
-		if (fill_sz >= buf_sz) {
+		int free_sz;
+		unsigned char* dst = Reserve(free_sz);
+		if (!dst) {
 			break;
 		}
+		int sz = std::min(free_sz, buf_sz - fill_sz);
+		memcpy(dst, &buf[fill_sz], sz);
+		Commit(sz);
+		fill_sz += sz;
 	}
+	return fill_sz;
+}
 
-	if (fill_sz == 0) {
-		m_full = true;
+unsigned char* OutputBuffer::Reserve(int& sz)
+{
+	const uint32_t write = m_write.load(std::memory_order_relaxed);
+	if (write - m_read.load(std::memory_order_acquire) >= m_depth.load(std::memory_order_relaxed)) {
+		sz = 0;
+		return nullptr;
 	}
 
-	return fill_sz;
+	const uint32_t fill = m_fill.load(std::memory_order_relaxed);
+	sz = m_slot_size - fill;
+	return &m_data[(write & m_mask) * m_stride + fill];
 }
 
-const unsigned char* OutputBuffer::Output(int& sz)
+void OutputBuffer::Commit(int sz)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-
-	Buffer* buf = m_bufs.front();
+	const uint32_t fill = m_fill.load(std::memory_order_relaxed) + sz;
+	assert(fill <= m_slot_size);
+	m_fill.store(fill, std::memory_order_relaxed);
+	if (fill == m_slot_size) {
+		Publish();
+	}
+}
 
-	sz = buf->size;
-	const unsigned char* ret = sz == 0 ? nullptr : buf->buf;
+void OutputBuffer::Flush()
+{
+	if (m_fill.load(std::memory_order_relaxed) != 0) {
+		Publish();
+	}
+	m_end.store(m_write.load(std::memory_order_relaxed), std::memory_order_release);
+}
 
-	// move to end
-	m_bufs.pop_front();
-	buf->size = 0;
-	m_bufs.push_back(buf);
-	m_full = false;
+int OutputBuffer::GetFilled() const
+{
+	const uint32_t write = m_write.load(std::memory_order_relaxed);
+	return (write - m_read.load(std::memory_order_acquire)) * m_slot_size + m_fill.load(std::memory_order_relaxed);
+}
 
-	return ret;
+void OutputBuffer::SetDepth(int depth)
+{
+	const uint32_t d = static_cast<uint32_t>(std::min(std::max(depth, 1), static_cast<int>(m_count)));
+	m_depth.store(d, std::memory_order_relaxed);
 }
 
-void OutputBuffer::Init(int count, int size)
+const unsigned char* OutputBuffer::Output(int& sz)
 {
-	size_t sz = sizeof(Buffer) - sizeof(uint8_t) + size;
-	sz = (sz + 3) & ~3;   // padding to 4 bytes aligned
-	for (int i = 0; i < count; ++i)
+	uint32_t read = m_read.load(std::memory_order_relaxed);
+	if (m_held)
 	{
-		void* ptr = malloc(sz);
-		if (!ptr) {
-			throw Exception("malloc fail.");
+		// give back the last one
+		m_held = false;
+		m_read.store(++read, std::memory_order_release);
+	}
+
+	if (read == m_write.load(std::memory_order_acquire))
+	{
+		m_starved = read != m_end.load(std::memory_order_acquire);
+		if (m_starved) {
+			m_underruns.fetch_add(1, std::memory_order_relaxed);
 		}
-		Buffer* buf = new (ptr) Buffer;
-		memset(buf, 0, sz);
-		buf->cap = size;
-		buf->size = 0;
-		m_bufs.push_back(buf);
+		sz = 0;
+		return nullptr;
 	}
+	m_starved = false;
+
+	const uint32_t slot = read & m_mask;
+	sz = m_sizes[slot];
+	m_held = true;
+	return &m_data[slot * m_stride];
+}
+
+void OutputBuffer::Init(int count, int size)
+{
+	m_count = 1;
+	while (m_count < static_cast<uint32_t>(count)) {
+		m_count <<= 1;
+	}
+	m_mask = m_count - 1;
+	m_depth.store(m_count, std::memory_order_relaxed);
+
+	m_slot_size = size;
+	m_stride = (size + 3) & ~3;
+	m_data_size = (m_stride + sizeof(uint32_t)) * m_count;
+	if (m_pool) {
+		m_data = static_cast<uint8_t*>(m_pool->Alloc(m_data_size));
+	} else {
+		m_data = static_cast<uint8_t*>(malloc(m_data_size));
+	}
+	if (!m_data) {
+		throw Exception("malloc fail.");
+	}
+	m_sizes = reinterpret_cast<uint32_t*>(m_data + m_stride * m_count);
+	memset(m_data, 0, m_data_size);
+}
+
+void OutputBuffer::Publish()
+{
+	// only filled while free
+	const uint32_t write = m_write.load(std::memory_order_relaxed);
+	m_sizes[write & m_mask] = m_fill.load(std::memory_order_relaxed);
+	m_fill.store(0, std::memory_order_relaxed);
+	m_write.store(write + 1, std::memory_order_release);
 }
 
 }
\ No newline at end of file
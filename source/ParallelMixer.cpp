@@ -0,0 +1,149 @@
+#include "uniaudio/ParallelMixer.h"
+#include "uniaudio/Exception.h"
+
+#include <algorithm>
+
+namespace ua
+{
+
+ParallelMixer::ParallelMixer(float buf_time_len, const OutputFormat& fmt, AudioMixer::Bus bus, int threads)
+	: m_num_partials(0)
+	, m_next(0)
+	, m_pending(0)
+	, m_generation(0)
+	, m_quit(false)
+{
+	for (int i = 0; i < NUM_PARTIALS; ++i)
+	{
+		m_partials[i].mixer = new AudioMixer(buf_time_len, fmt, bus);
+		if (!m_partials[i].mixer) {
+			throw Exception("Could not create partial AudioMixer.");
+		}
+		m_partials[i].cost = 0;
+	}
+
+	for (int i = 0; i < threads; ++i) {
+		m_threads.push_back(std::thread(&ParallelMixer::WorkerLoop, this));
+	}
+}
+
+ParallelMixer::~ParallelMixer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_start_cond.notify_all();
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+
+	for (int i = 0; i < NUM_PARTIALS; ++i) {
+		delete m_partials[i].mixer;
+	}
+}
+
+void ParallelMixer::Mix(AudioMixer& dst, const AudioMixer::Batch& batch)
+{
+	if (batch.Empty()) {
+		return;
+	}
+
+	const int num = Split(batch);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_num_partials = num;
+		m_next    = 0;
+		m_pending = m_num_partials;
+		++m_generation;
+	}
+	m_start_cond.notify_all();
+
+	Run();
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done_cond.wait(lock, [this] { return m_pending == 0; });
+	}
+
+	for (int i = 0; i < m_num_partials; ++i) {
+		dst.Merge(*m_partials[i].mixer);
+	}
+}
+
+int ParallelMixer::Split(const AudioMixer::Batch& batch)
+{
+	// longest first to the cheapest partial, ties keep the batch order
+	const int n = batch.Size();
+	m_order.resize(n);
+	for (int i = 0; i < n; ++i) {
+		m_order[i] = i;
+	}
+	std::stable_sort(m_order.begin(), m_order.end(), [&batch](int a, int b) {
+		return batch.GetCost(a) > batch.GetCost(b);
+	});
+
+	const int num = std::min(n, static_cast<int>(NUM_PARTIALS));
+	for (int i = 0; i < num; ++i) {
+		m_partials[i].batch.Clear();
+		m_partials[i].cost = 0;
+	}
+
+	for (auto idx : m_order)
+	{
+		Partial* dst = &m_partials[0];
+		for (int i = 1; i < num; ++i) {
+			if (m_partials[i].cost < dst->cost) {
+				dst = &m_partials[i];
+			}
+		}
+		dst->batch.Add(batch, idx);
+		dst->cost += std::max(batch.GetCost(idx), 1);
+	}
+
+	return num;
+}
+
+void ParallelMixer::Run()
+{
+	for (;;)
+	{
+		int idx;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_next >= m_num_partials) {
+				return;
+			}
+			idx = m_next++;
+		}
+
+		Partial& p = m_partials[idx];
+		p.mixer->Reset();
+		p.mixer->Input(p.batch);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_pending == 0) {
+			m_done_cond.notify_one();
+		}
+	}
+}
+
+void ParallelMixer::WorkerLoop()
+{
+	uint32_t generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start_cond.wait(lock, [&] { return m_quit || m_generation != generation; });
+			if (m_quit) {
+				return;
+			}
+			generation = m_generation;
+		}
+		Run();
+	}
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "uniaudio/PlayCursor.h"
+#include "uniaudio/XrunLog.h"
+
+#include <algorithm>
+
+namespace ua
+{
+
+PlayCursor::PlayCursor()
+	: m_sample_rate(0)
+	, m_seq(0)
+	, m_frame(0)
+	, m_time(0)
+	, m_block(0)
+	, m_pending_begin(0)
+	, m_pending_count(0)
+{
+}
+
+void PlayCursor::SetSampleRate(int sample_rate)
+{
+	m_sample_rate.store(sample_rate, std::memory_order_relaxed);
+}
+
+void PlayCursor::Reset(double time)
+{
+	// the blocks still queued hold the old position
+	m_pending_begin = 0;
+	m_pending_count = 0;
+
+	const int rate = m_sample_rate.load(std::memory_order_relaxed);
+	Publish(static_cast<int64_t>(time * rate + 0.5), 0);
+}
+
+void PlayCursor::Advance(int frames)
+{
+	Publish(m_frame.load(std::memory_order_relaxed) + frames, frames);
+}
+
+void PlayCursor::Queue(int frames, uint64_t block)
+{
+	if (frames <= 0) {
+		return;
+	}
+	if (m_pending_count > 0)
+	{
+		Pending& last = m_pending[(m_pending_begin + m_pending_count - 1) % MAX_PENDING];
+		if (last.block == block) {
+			last.frames += frames;
+			return;
+		}
+	}
+	// a queue deeper than the ring, the oldest counts as heard
+	if (m_pending_count == MAX_PENDING) {
+		Advance(m_pending[m_pending_begin].frames);
+		m_pending_begin = (m_pending_begin + 1) % MAX_PENDING;
+		--m_pending_count;
+	}
+	Pending& p = m_pending[(m_pending_begin + m_pending_count) % MAX_PENDING];
+	p.block  = block;
+	p.frames = frames;
+	++m_pending_count;
+}
+
+void PlayCursor::Play(uint64_t block)
+{
+	int64_t frames = 0;
+	int last = 0;
+	while (m_pending_count > 0 && m_pending[m_pending_begin].block < block)
+	{
+		last = m_pending[m_pending_begin].frames;
+		frames += last;
+		m_pending_begin = (m_pending_begin + 1) % MAX_PENDING;
+		--m_pending_count;
+	}
+	// interpolates over the block playing now, not over all the played
+	if (frames > 0) {
+		Publish(m_frame.load(std::memory_order_relaxed) + frames, last);
+	}
+}
+
+int64_t PlayCursor::GetFrame() const
+{
+	int64_t frame, time;
+	int block;
+	Read(frame, time, block);
+	return frame;
+}
+
+double PlayCursor::GetTime(bool interpolate) const
+{
+	const int rate = m_sample_rate.load(std::memory_order_relaxed);
+	if (rate <= 0) {
+		return 0;
+	}
+
+	int64_t frame, time;
+	int block;
+	Read(frame, time, block);
+
+	double ret = static_cast<double>(frame) / rate;
+	if (interpolate && block > 0) {
+		const double elapsed = (XrunLog::Now() - time) * 1e-9;
+		ret += std::min(std::max(elapsed, 0.0), static_cast<double>(block) / rate);
+	}
+	return ret;
+}
+
+void PlayCursor::Publish(int64_t frame, int block)
+{
+	const uint32_t seq = m_seq.load(std::memory_order_relaxed);
+	m_seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	m_frame.store(frame, std::memory_order_relaxed);
+	m_time.store(XrunLog::Now(), std::memory_order_relaxed);
+	m_block.store(block, std::memory_order_relaxed);
+
+	m_seq.store(seq + 2, std::memory_order_release);
+}
+
+void PlayCursor::Read(int64_t& frame, int64_t& time, int& block) const
+{
+	uint32_t begin, end;
+	do {
+		begin = m_seq.load(std::memory_order_acquire);
+		frame = m_frame.load(std::memory_order_relaxed);
+		time  = m_time.load(std::memory_order_relaxed);
+		block = m_block.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		end = m_seq.load(std::memory_order_relaxed);
+	} while ((begin & 1) || begin != end);
+}
+
+}
\ No newline at end of file
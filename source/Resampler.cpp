@@ -0,0 +1,285 @@
+#include "uniaudio/Resampler.h"
+#include "uniaudio/MixKernel.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <string.h>
+#include <assert.h>
+
+namespace ua
+{
+
+namespace
+{
+
+constexpr double PI = 3.14159265358979323846;
+
+constexpr double const_sin(double x)
+{
+	// reduce to [-pi/2, pi/2]
+	while (x > PI) {
+		x -= 2 * PI;
+	}
+	while (x < -PI) {
+		x += 2 * PI;
+	}
+	if (x > PI / 2) {
+		x = PI - x;
+	} else if (x < -PI / 2) {
+		x = -PI - x;
+	}
+
+	double term = x, sum = x;
+	for (int i = 1; i < 8; ++i) {
+		term *= -x * x / ((2 * i) * (2 * i + 1));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr double const_cos(double x)
+{
+	return const_sin(x + PI / 2);
+}
+
+/**
+ * Blackman windowed sinc, built at compile time.
+ *
+ * Row p holds the taps for a read position p / PHASES past the first tap's
+ * neighbour, each row is normalized to unity gain.
+ **/
+template <int TAPS, int PHASES>
+struct SincTable
+{
+	float coef[PHASES][TAPS];
+
+	constexpr SincTable(double cutoff)
+		: coef()
+	{
+		const int half = TAPS / 2;
+		for (int p = 0; p < PHASES; ++p)
+		{
+			double row[TAPS] = {};
+			double sum = 0;
+			for (int k = 0; k < TAPS; ++k)
+			{
+				const double x = k - half + 1 - static_cast<double>(p) / PHASES;
+				const double w = 0.42 + 0.5 * const_cos(PI * x / half) + 0.08 * const_cos(2 * PI * x / half);
+				const double s = x == 0 ? 1 : const_sin(PI * cutoff * x) / (PI * cutoff * x);
+				row[k] = cutoff * s * w;
+				sum += row[k];
+			}
+			for (int k = 0; k < TAPS; ++k) {
+				coef[p][k] = static_cast<float>(row[k] / sum);
+			}
+		}
+	}
+};
+
+template <int PHASES>
+struct LinearTable
+{
+	float coef[PHASES][2];
+
+	constexpr LinearTable()
+		: coef()
+	{
+		for (int p = 0; p < PHASES; ++p) {
+			coef[p][0] = 1 - static_cast<float>(p) / PHASES;
+			coef[p][1] = static_cast<float>(p) / PHASES;
+		}
+	}
+};
+
+// Cutoff is relative to the input's nyquist, these are for up-sampling,
+// down-sampling scales it by the ratio.
+const double CUTOFF = 0.9;
+
+constexpr LinearTable<256>    TABLE_LINEAR;
+constexpr SincTable<8, 64>    TABLE_MEDIUM(CUTOFF);
+constexpr SincTable<16, 128>  TABLE_HIGH(CUTOFF);
+
+int gcd(int a, int b)
+{
+	while (b != 0) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// below the output's nyquist, built the first time a ratio is used and
+// kept, a game has few rates
+template <int TAPS, int PHASES>
+const float* get_down_table(int src_rate, int dst_rate)
+{
+	static std::mutex mutex;
+	static std::map<std::pair<int, int>, std::unique_ptr<SincTable<TAPS, PHASES>>> tables;
+
+	const int d = gcd(src_rate, dst_rate);
+	const std::pair<int, int> ratio(src_rate / d, dst_rate / d);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& table = tables[ratio];
+	if (!table) {
+		table.reset(new SincTable<TAPS, PHASES>(CUTOFF * ratio.second / ratio.first));
+	}
+	return &table->coef[0][0];
+}
+
+const int PHASE_BITS_LINEAR = 8;
+const int PHASE_BITS_MEDIUM = 6;
+const int PHASE_BITS_HIGH   = 7;
+
+}
+
+Resampler::Resampler(int src_rate, int dst_rate, int channels, Quality quality)
+	: m_src_rate(src_rate)
+	, m_dst_rate(dst_rate)
+	, m_channels(channels)
+	, m_quality(quality)
+	, m_cap(0)
+	, m_len(0)
+	, m_pos(0)
+{
+	switch (quality)
+	{
+	case QUALITY_LINEAR:
+		m_table = &TABLE_LINEAR.coef[0][0];
+		m_taps = 2;
+		m_phase_shift = 32 - PHASE_BITS_LINEAR;
+		break;
+	case QUALITY_MEDIUM:
+		m_table = src_rate > dst_rate ? get_down_table<8, 64>(src_rate, dst_rate) : &TABLE_MEDIUM.coef[0][0];
+		m_taps = 8;
+		m_phase_shift = 32 - PHASE_BITS_MEDIUM;
+		break;
+	default:
+		m_table = src_rate > dst_rate ? get_down_table<16, 128>(src_rate, dst_rate) : &TABLE_HIGH.coef[0][0];
+		m_taps = 16;
+		m_phase_shift = 32 - PHASE_BITS_HIGH;
+		break;
+	}
+
+	m_step = (static_cast<uint64_t>(src_rate) << 32) / dst_rate;
+
+	// 20ms of input at first, grows if the stream delivers more per block
+	m_cap = m_taps + src_rate / 50;
+	m_buf.resize(m_cap * m_channels);
+
+	Reset();
+}
+
+void Resampler::Push(const uint8_t* buf, int buf_sz, int bit_depth)
+{
+	const int frames = buf_sz * 8 / bit_depth / m_channels;
+	if (m_len + frames > m_cap) {
+		Compact();
+	}
+	if (m_len + frames > m_cap)
+	{
+		int cap = std::max(m_cap * 2, m_len + frames);
+		CU_VEC<float> tmp(cap * m_channels);
+		for (int c = 0; c < m_channels; ++c) {
+			memcpy(&tmp[c * cap], &m_buf[c * m_cap], sizeof(float) * m_len);
+		}
+		m_buf.swap(tmp);
+		m_cap = cap;
+	}
+
+	for (int c = 0; c < m_channels; ++c)
+	{
+		float* dst = &m_buf[c * m_cap + m_len];
+		if (bit_depth == 16)
+		{
+			const int16_t* src = reinterpret_cast<const int16_t*>(buf) + c;
+			for (int i = 0; i < frames; ++i, src += m_channels) {
+				dst[i] = *src * (1.0f / 32768);
+			}
+		}
+		else
+		{
+			const int8_t* src = reinterpret_cast<const int8_t*>(buf) + c;
+			for (int i = 0; i < frames; ++i, src += m_channels) {
+				dst[i] = *src * (1.0f / 128);
+			}
+		}
+	}
+	m_len += frames;
+}
+
+int Resampler::GetRequiredFrames(int frames) const
+{
+	if (frames <= 0) {
+		return 0;
+	}
+	const int last = static_cast<int>((m_pos + (frames - 1) * m_step) >> 32);
+	return std::max(0, last + m_taps - m_len);
+}
+
+int Resampler::GetAvailableFrames() const
+{
+	const uint64_t end = static_cast<uint64_t>(m_len - m_taps + 1) << 32;
+	if (m_len < m_taps || end <= m_pos) {
+		return 0;
+	}
+	return static_cast<int>((end - m_pos - 1) / m_step) + 1;
+}
+
+int Resampler::Process(float* dst, int frames, float gain, float step, const MixKernel& kernel)
+{
+	const int n = std::min(frames, GetAvailableFrames());
+	if (n == 0) {
+		return 0;
+	}
+
+	MixKernel::Resample r;
+	r.src         = &m_buf[0];
+	r.stride      = m_cap;
+	r.channels    = m_channels;
+	r.table       = m_table;
+	r.taps        = m_taps;
+	r.phase_shift = m_phase_shift;
+	r.pos         = m_pos;
+	r.step        = m_step;
+	kernel.resample_f32(dst, n, gain, step, r);
+
+	m_pos += n * m_step;
+	// the read input is dropped in bulk, not moved every block
+	if (static_cast<int>(m_pos >> 32) >= m_cap / 2) {
+		Compact();
+	}
+
+	return n;
+}
+
+void Resampler::Reset()
+{
+	// zeros in front of the first frame, it lands on the filter's center
+	m_len = m_taps / 2 - 1;
+	for (int c = 0; c < m_channels; ++c) {
+		std::fill(m_buf.begin() + c * m_cap, m_buf.begin() + c * m_cap + m_len, 0.0f);
+	}
+	m_pos = 0;
+}
+
+void Resampler::Compact()
+{
+	const int shift = static_cast<int>(m_pos >> 32);
+	if (shift == 0) {
+		return;
+	}
+	assert(shift <= m_len);
+	for (int c = 0; c < m_channels; ++c) {
+		float* ptr = &m_buf[c * m_cap];
+		memmove(ptr, ptr + shift, sizeof(float) * (m_len - shift));
+	}
+	m_len -= shift;
+	m_pos -= static_cast<uint64_t>(shift) << 32;
+}
+
+}
@@ -1,37 +1,95 @@
 #include "uniaudio/Source.h"
 #include "uniaudio/Decoder.h"
 
+#include <atomic>
+#include <cmath>
+
 namespace ua
 {
 
+static std::atomic<int> NEXT_ID(0);
+
 Source::Source()
-	: m_offset(0)
+	: m_id(NEXT_ID.fetch_add(1, std::memory_order_relaxed))
+	, m_offset(0)
 	, m_duration(0)
 	, m_fade_in(0)
 	, m_fade_out(0)
 	, m_ori_volume(1)
 	, m_curr_volume(1)
+	, m_resample_quality(Resampler::QUALITY_MEDIUM)
+	, m_mix_bus(0)
+	, m_pan(0)
+	, m_loop_begin(0)
+	, m_loop_end(0)
 {
 }
 
 Source::Source(const Decoder& decoder)
-	: m_offset(0)
+	: m_id(NEXT_ID.fetch_add(1, std::memory_order_relaxed))
+	, m_offset(0)
 	, m_duration(decoder.GetDuration())
 	, m_fade_in(0)
 	, m_fade_out(0)
 	, m_ori_volume(1)
 	, m_curr_volume(1)
+	, m_resample_quality(Resampler::QUALITY_MEDIUM)
+	, m_mix_bus(0)
+	, m_pan(0)
+	, m_loop_begin(0)
+	, m_loop_end(0)
 {
 }
 
 Source::Source(const Source& source)
-	: m_offset(source.m_offset)
+	: m_id(NEXT_ID.fetch_add(1, std::memory_order_relaxed))
+	, m_offset(source.m_offset)
 	, m_duration(source.m_duration)
 	, m_fade_in(source.m_fade_in)
 	, m_fade_out(source.m_fade_out)
 	, m_ori_volume(source.m_ori_volume)
 	, m_curr_volume(source.m_curr_volume)
+	, m_resample_quality(source.m_resample_quality)
+	, m_gain_ramp(source.m_gain_ramp)
+	, m_mix_bus(source.m_mix_bus)
+	, m_pan(source.m_pan)
+	, m_loop_begin(source.m_loop_begin)
+	, m_loop_end(source.m_loop_end)
+{
+}
+
+void Source::UpdateFadeOut()
+{
+	m_gain_ramp.SetFadeOut(IsLooping() ? 0 : m_duration, m_fade_out);
+}
+
+bool Source::IsPastDuration(double time) const
 {
+	return !IsLooping() && m_duration != 0 && time > m_offset + m_duration;
+}
+
+bool Source::SetLoopRegionImpl(int64_t begin, int64_t end)
+{
+	if (begin < 0 || (end != 0 && end <= begin)) {
+		return false;
+	}
+	m_loop_begin = begin;
+	m_loop_end = end;
+	return true;
+}
+
+double Source::WrapLoop(double time, int sample_rate, float length) const
+{
+	if (!IsLooping() || sample_rate <= 0) {
+		return time;
+	}
+
+	const double begin = static_cast<double>(m_loop_begin) / sample_rate;
+	const double end = m_loop_end > 0 ? static_cast<double>(m_loop_end) / sample_rate : length;
+	if (end <= begin || time < end) {
+		return time;
+	}
+	return begin + fmod(time - begin, end - begin);
 }
 
 }
\ No newline at end of file
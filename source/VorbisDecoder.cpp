@@ -0,0 +1,348 @@
+#ifdef UA_SUPPORT_VORBIS
+
+#include "uniaudio/VorbisDecoder.h"
+#include "uniaudio/OggPages.h"
+
+#include <algorithm>
+
+#include <math.h>
+
+namespace ua
+{
+
+struct VorbisDecoder::Stream : private cu::Uncopyable
+{
+	Stream(const std::string& filepath);
+	~Stream();
+
+	// of the first frame output by decoding from the page at `pos`, -1 if
+	// the stream ends before a granule position tells
+	int64_t GetStartFrame(size_t pos);
+
+	OggPages pages;
+	bool valid;
+
+	vorbis_info    info;
+	vorbis_comment comment;
+
+	int serial;
+	// the first audio page
+	size_t  data_begin;
+	int64_t frames;
+
+}; // VorbisDecoder::Stream
+
+static inline int16_t
+to_s16(float v)
+{
+	int s = static_cast<int>(floorf(v * 32768.0f + 0.5f));
+	return static_cast<int16_t>(s > 32767 ? 32767 : (s < -32768 ? -32768 : s));
+}
+
+VorbisDecoder::Stream::Stream(const std::string& filepath)
+	: pages(filepath)
+	, valid(false)
+	, serial(0)
+	, data_begin(0)
+	, frames(0)
+{
+	vorbis_info_init(&info);
+	vorbis_comment_init(&comment);
+
+	// the three header packets, the audio starts on a new page
+	ogg_stream_state os;
+	bool os_inited = false;
+	int headers = 0;
+	size_t pos = 0;
+	ogg_page og;
+	while (headers < 3 && pages.Next(pos, og))
+	{
+		if (!os_inited) {
+			serial = ogg_page_serialno(&og);
+			ogg_stream_init(&os, serial);
+			os_inited = true;
+		}
+		if (ogg_stream_pagein(&os, &og) != 0) {
+			continue;
+		}
+
+		ogg_packet op;
+		while (headers < 3 && ogg_stream_packetout(&os, &op) > 0)
+		{
+			if (vorbis_synthesis_headerin(&info, &comment, &op) != 0) {
+				ogg_stream_clear(&os);
+				return;
+			}
+			++headers;
+		}
+	}
+	if (os_inited) {
+		ogg_stream_clear(&os);
+	}
+	if (headers < 3 || info.channels < 1 || info.channels > 2) {
+		return;
+	}
+	data_begin = pos;
+
+	// unpacks the codebooks into `info` now, the clones only read them
+	vorbis_dsp_state dsp;
+	if (vorbis_synthesis_init(&dsp, &info) != 0) {
+		return;
+	}
+	vorbis_dsp_clear(&dsp);
+
+	// the length, from the last granule position
+	frames = std::max<int64_t>(pages.GetLastGranule(serial, data_begin), 0);
+
+	valid = true;
+}
+
+VorbisDecoder::Stream::~Stream()
+{
+	vorbis_comment_clear(&comment);
+	vorbis_info_clear(&info);
+}
+
+int64_t VorbisDecoder::Stream::GetStartFrame(size_t pos)
+{
+	// a decode from a restart outputs nothing for its first packet, then
+	// a quarter of the previous and of the current block each packet
+	long prev = 0;
+	return pages.GetStartGranule(serial, pos, [this, &prev](ogg_packet& op) -> int64_t {
+		const long bs = vorbis_packet_blocksize(&info, &op);
+		if (bs <= 0) {
+			return -1;
+		}
+		const int64_t n = prev > 0 ? prev / 4 + bs / 4 : 0;
+		prev = bs;
+		return n;
+	});
+}
+
+VorbisDecoder::VorbisDecoder(const std::string& filepath, int buf_sz)
+	: Decoder(buf_sz)
+	, m_stream(std::make_shared<Stream>(filepath))
+	, m_pos(0)
+	, m_skip(0)
+{
+	// empty, like a file mpg123 could not open
+	if (!m_stream->valid) {
+		m_stream.reset();
+		return;
+	}
+
+	m_sample_rate = m_stream->info.rate;
+	m_length = static_cast<int>(m_stream->frames);
+	Init();
+}
+
+VorbisDecoder::VorbisDecoder(const VorbisDecoder& src)
+	: Decoder(src)
+	, m_stream(src.m_stream)
+	, m_pos(0)
+	, m_skip(0)
+{
+	if (m_stream) {
+		Init();
+	}
+}
+
+VorbisDecoder::~VorbisDecoder()
+{
+	if (m_stream) {
+		vorbis_block_clear(&m_block);
+		vorbis_dsp_clear(&m_dsp);
+		ogg_stream_clear(&m_ogg);
+	}
+}
+
+Decoder* VorbisDecoder::Clone()
+{
+	return new VorbisDecoder(*this);
+}
+
+int VorbisDecoder::Decode(unsigned char* dst, int size)
+{
+	if (!m_stream) {
+		return 0;
+	}
+
+	const int frame_size = m_stream->info.channels * 2;
+	return DecodeFrames(dst, size / frame_size, false) * frame_size;
+}
+
+int VorbisDecoder::DecodeFloat(float* dst, int frames)
+{
+	return m_stream ? DecodeFrames(dst, frames, true) : 0;
+}
+
+bool VorbisDecoder::Seek(float s)
+{
+	if (s < 0) {
+		return false;
+	}
+	return SeekFrame(static_cast<int64_t>(s * static_cast<double>(m_sample_rate)));
+}
+
+bool VorbisDecoder::SeekFrame(int64_t frame)
+{
+	if (!m_stream || frame < 0 || frame > m_stream->frames) {
+		return false;
+	}
+
+	Stream& s = *m_stream;
+	const CU_VEC<OggPages::Page>& index = s.pages.GetIndex(s.serial, s.data_begin);
+
+	// a restart loses its first packet and the part of another before the
+	// page, at most a long block in all
+	const int64_t preroll = vorbis_info_blocksize(&s.info, 1);
+	auto itr = std::upper_bound(index.begin(), index.end(), frame - preroll,
+		[](int64_t f, const OggPages::Page& p) { return f < p.granule; });
+	while (itr != index.begin())
+	{
+		--itr;
+		const int64_t start = s.GetStartFrame(itr->end);
+		if (start >= 0 && start <= frame) {
+			Restart(itr->end, frame - start);
+			return true;
+		}
+	}
+
+	Restart(s.data_begin, frame);
+	return true;
+}
+
+bool VorbisDecoder::Rewind()
+{
+	if (!m_stream) {
+		return false;
+	}
+
+	Restart(m_stream->data_begin, 0);
+	return true;
+}
+
+int VorbisDecoder::GetChannels() const
+{
+	return m_stream ? m_stream->info.channels : DEFAULT_CHANNELS;
+}
+
+int VorbisDecoder::GetBitDepth() const
+{
+	return 16;
+}
+
+float VorbisDecoder::GetDuration() const
+{
+	if (!m_stream || m_stream->frames == 0) {
+		return 0;
+	}
+	return static_cast<float>(static_cast<double>(m_stream->frames) / m_sample_rate);
+}
+
+bool VorbisDecoder::Accepts(const CU_STR& ext)
+{
+	return ext == "ogg" || ext == "oga";
+}
+
+void VorbisDecoder::Init()
+{
+	ogg_stream_init(&m_ogg, m_stream->serial);
+	vorbis_synthesis_init(&m_dsp, &m_stream->info);
+	vorbis_block_init(&m_dsp, &m_block);
+
+	m_pos = m_stream->data_begin;
+	m_skip = 0;
+	m_eof = false;
+}
+
+int VorbisDecoder::DecodeFrames(void* dst, int frames, bool to_float)
+{
+	const int channels = m_stream->info.channels;
+
+	int total = 0;
+	while (total < frames)
+	{
+		float** pcm;
+		int n = vorbis_synthesis_pcmout(&m_dsp, &pcm);
+		if (n <= 0)
+		{
+			if (!NextPacket()) {
+				m_eof = true;
+				break;
+			}
+			continue;
+		}
+
+		if (m_skip > 0)
+		{
+			n = static_cast<int>(std::min<int64_t>(n, m_skip));
+			m_skip -= n;
+		}
+		else
+		{
+			// planar to interleaved
+			n = std::min(n, frames - total);
+			if (to_float) {
+				float* out = static_cast<float*>(dst) + total * channels;
+				for (int i = 0; i < n; ++i) {
+					for (int c = 0; c < channels; ++c) {
+						*out++ = pcm[c][i];
+					}
+				}
+			} else {
+				int16_t* out = static_cast<int16_t*>(dst) + total * channels;
+				for (int i = 0; i < n; ++i) {
+					for (int c = 0; c < channels; ++c) {
+						*out++ = to_s16(pcm[c][i]);
+					}
+				}
+			}
+			total += n;
+		}
+		vorbis_synthesis_read(&m_dsp, n);
+	}
+
+	return total;
+}
+
+bool VorbisDecoder::NextPacket()
+{
+	while (true)
+	{
+		ogg_packet op;
+		int ret = ogg_stream_packetout(&m_ogg, &op);
+		if (ret > 0)
+		{
+			if (vorbis_synthesis(&m_block, &op) == 0) {
+				vorbis_synthesis_blockin(&m_dsp, &m_block);
+			}
+			return true;
+		}
+		// a hole in the data
+		if (ret < 0) {
+			continue;
+		}
+
+		ogg_page og;
+		if (!m_stream->pages.Next(m_pos, og)) {
+			return false;
+		}
+		// refuses the pages of other logical streams
+		ogg_stream_pagein(&m_ogg, &og);
+	}
+}
+
+void VorbisDecoder::Restart(size_t pos, int64_t skip)
+{
+	ogg_stream_reset(&m_ogg);
+	vorbis_synthesis_restart(&m_dsp);
+
+	m_pos = pos;
+	m_skip = skip;
+	m_eof = false;
+}
+
+}
+
+#endif // UA_SUPPORT_VORBIS
\ No newline at end of file
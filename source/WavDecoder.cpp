@@ -0,0 +1,318 @@
+#include "uniaudio/WavDecoder.h"
+#include "uniaudio/MappedFile.h"
+#include "uniaudio/ImaAdpcm.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace ua
+{
+
+static const int WAVE_FORMAT_PCM        = 0x0001;
+static const int WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+static const int WAVE_FORMAT_IMA_ADPCM  = 0x0011;
+static const int WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+static inline uint32_t
+read_u16(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t
+read_u32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static inline int16_t
+to_s16(double v)
+{
+	v *= 32768.0;
+	return static_cast<int16_t>(v >= 32767.0 ? 32767 : (v <= -32768.0 ? -32768 : v));
+}
+
+WavDecoder::WavDecoder(const std::string& filepath, int buf_sz)
+	: Decoder(buf_sz)
+	, m_file(std::make_shared<MappedFile>(filepath))
+	, m_samples(nullptr)
+	, m_frames(0)
+	, m_channels(0)
+	, m_src_bits(0)
+	, m_float(false)
+	, m_src_frame_size(0)
+	, m_frame(0)
+{
+	// empty, like a file mpg123 could not open
+	if (!ParseHeader()) {
+		m_samples = nullptr;
+		m_frames = 0;
+		m_channels = DEFAULT_CHANNELS;
+		m_src_bits = DEFAULT_BIT_DEPTH;
+		m_float = false;
+		m_ima.reset();
+	}
+	m_length = static_cast<int>(m_frames);
+}
+
+WavDecoder::WavDecoder(const WavDecoder& src)
+	: Decoder(src)
+	, m_file(src.m_file)
+	, m_samples(src.m_samples)
+	, m_frames(src.m_frames)
+	, m_channels(src.m_channels)
+	, m_src_bits(src.m_src_bits)
+	, m_float(src.m_float)
+	, m_src_frame_size(src.m_src_frame_size)
+	, m_ima(src.m_ima ? new ImaAdpcm(*src.m_ima) : nullptr)
+	, m_frame(0)
+{
+	m_eof = false;
+}
+
+WavDecoder::~WavDecoder()
+{
+}
+
+Decoder* WavDecoder::Clone()
+{
+	return new WavDecoder(*this);
+}
+
+int WavDecoder::Decode(unsigned char* dst, int size)
+{
+	if (!m_samples) {
+		return 0;
+	}
+
+	const int frame_size = m_channels * 2;
+	const int64_t n = std::min<int64_t>(size / frame_size, m_frames - m_frame);
+	const int count = static_cast<int>(n) * m_channels;
+
+	int16_t* out = reinterpret_cast<int16_t*>(dst);
+	if (m_ima)
+	{
+		m_ima->Decode(out, m_frame, static_cast<int>(n));
+	}
+	else if (m_float)
+	{
+		const unsigned char* src = m_samples + m_frame * m_src_frame_size;
+		if (m_src_bits == 32) {
+			for (int i = 0; i < count; ++i) {
+				float v;
+				memcpy(&v, src + i * 4, sizeof(v));
+				out[i] = to_s16(v);
+			}
+		} else {
+			for (int i = 0; i < count; ++i) {
+				double v;
+				memcpy(&v, src + i * 8, sizeof(v));
+				out[i] = to_s16(v);
+			}
+		}
+	}
+	else
+	{
+		// the most significant 16 bits, 8 bit is unsigned
+		const unsigned char* src = m_samples + m_frame * m_src_frame_size;
+		switch (m_src_bits)
+		{
+		case 8:
+			for (int i = 0; i < count; ++i) {
+				out[i] = static_cast<int16_t>((src[i] - 128) * 256);
+			}
+			break;
+		case 16:
+			memcpy(dst, src, count * 2);
+			break;
+		case 24:
+			for (int i = 0; i < count; ++i) {
+				out[i] = static_cast<int16_t>(read_u16(src + i * 3 + 1));
+			}
+			break;
+		case 32:
+			for (int i = 0; i < count; ++i) {
+				out[i] = static_cast<int16_t>(read_u16(src + i * 4 + 2));
+			}
+			break;
+		}
+	}
+
+	m_frame += n;
+	if (m_frame >= m_frames) {
+		m_eof = true;
+	}
+	return count * 2;
+}
+
+int WavDecoder::Map(const unsigned char*& buf, int size)
+{
+	if (!m_samples || !IsPcm16()) {
+		return -1;
+	}
+
+	const int64_t n = std::min<int64_t>(size / m_src_frame_size, m_frames - m_frame);
+	buf = m_samples + m_frame * m_src_frame_size;
+
+	m_frame += n;
+	if (m_frame >= m_frames) {
+		m_eof = true;
+	}
+	return static_cast<int>(n) * m_src_frame_size;
+}
+
+const unsigned char* WavDecoder::GetData(size_t& size) const
+{
+	if (!m_samples || !IsPcm16()) {
+		size = 0;
+		return nullptr;
+	}
+
+	size = static_cast<size_t>(m_frames) * m_src_frame_size;
+	return m_samples;
+}
+
+const unsigned char* WavDecoder::GetAdpcmData(size_t& size, int& block_align, int64_t& frames) const
+{
+	if (!m_samples || !IsAdpcm()) {
+		return Decoder::GetAdpcmData(size, block_align, frames);
+	}
+
+	block_align = m_src_frame_size;
+	frames = m_frames;
+	size = ImaAdpcm::GetEncodedSize(m_frames, m_channels, block_align);
+	return m_samples;
+}
+
+bool WavDecoder::Seek(float s)
+{
+	if (s < 0) {
+		return false;
+	}
+	return SeekFrame(static_cast<int64_t>(s * static_cast<double>(m_sample_rate)));
+}
+
+bool WavDecoder::SeekFrame(int64_t frame)
+{
+	if (!m_samples || frame < 0 || frame > m_frames) {
+		return false;
+	}
+
+	m_frame = frame;
+	m_eof = false;
+	return true;
+}
+
+bool WavDecoder::Rewind()
+{
+	return SeekFrame(0);
+}
+
+int WavDecoder::GetChannels() const
+{
+	return m_channels;
+}
+
+int WavDecoder::GetBitDepth() const
+{
+	return 16;
+}
+
+float WavDecoder::GetDuration() const
+{
+	return m_frames == 0 ? 0 : static_cast<float>(static_cast<double>(m_frames) / m_sample_rate);
+}
+
+bool WavDecoder::Accepts(const CU_STR& ext)
+{
+	return ext == "wav" || ext == "wave";
+}
+
+bool WavDecoder::ParseHeader()
+{
+	const unsigned char* data = m_file->GetData();
+	const size_t size = m_file->GetSize();
+	if (!data || size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+		return false;
+	}
+
+	int tag = 0, block_align = 0;
+	int64_t fact = -1;
+	size_t pos = 12;
+	while (pos + 8 <= size)
+	{
+		const unsigned char* chunk = data + pos;
+		size_t len = read_u32(chunk + 4);
+		pos += 8;
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && len >= 16 && pos + 16 <= size)
+		{
+			tag           = read_u16(data + pos);
+			m_channels    = read_u16(data + pos + 2);
+			m_sample_rate = read_u32(data + pos + 4);
+			block_align   = read_u16(data + pos + 12);
+			m_src_bits    = read_u16(data + pos + 14);
+			// the format is the first field of the sub format guid
+			if (tag == WAVE_FORMAT_EXTENSIBLE && len >= 26 && pos + 26 <= size) {
+				tag = read_u16(data + pos + 24);
+			}
+		}
+		else if (memcmp(chunk, "fact", 4) == 0 && len >= 4 && pos + 4 <= size)
+		{
+			// the frames of the compressed formats
+			fact = read_u32(data + pos);
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			if (tag == WAVE_FORMAT_PCM) {
+				m_float = false;
+				if (m_src_bits != 8 && m_src_bits != 16 && m_src_bits != 24 && m_src_bits != 32) {
+					return false;
+				}
+			} else if (tag == WAVE_FORMAT_IEEE_FLOAT) {
+				m_float = true;
+				if (m_src_bits != 32 && m_src_bits != 64) {
+					return false;
+				}
+			} else if (tag == WAVE_FORMAT_IMA_ADPCM) {
+				m_float = false;
+				if (m_src_bits != 4 || !ImaAdpcm::IsValid(m_channels, block_align)) {
+					return false;
+				}
+			} else {
+				return false;
+			}
+			const bool adpcm = tag == WAVE_FORMAT_IMA_ADPCM;
+			if (m_channels < 1 || m_channels > 2 || m_sample_rate <= 0 ||
+				(!adpcm && block_align != m_channels * m_src_bits / 8)) {
+				return false;
+			}
+
+			// truncated files, or streamed ones without the size
+			len = std::min(len, size - pos);
+			m_samples = data + pos;
+			m_src_frame_size = block_align;
+			m_frames = static_cast<int64_t>(len / block_align);
+			if (adpcm)
+			{
+				// whole blocks, less the padding of the last one
+				m_frames *= ImaAdpcm::GetBlockFrames(block_align, m_channels);
+				if (fact >= 0) {
+					m_frames = std::min(m_frames, fact);
+				}
+				m_ima.reset(new ImaAdpcm(m_samples, m_frames, m_channels, block_align));
+			}
+			return true;
+		}
+
+		if (len > size - pos) {
+			break;
+		}
+		pos += len + (len & 1);
+	}
+
+	return false;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "uniaudio/XrunLog.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace ua
+{
+
+/************************************************************************/
+/* class XrunCounter                                                    */
+/************************************************************************/
+
+XrunCounter::XrunCounter()
+	: m_missing_us(0)
+{
+	for (int i = 0; i < XRUN_CAUSE_COUNT; ++i) {
+		m_counts[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+XrunCounter::XrunCounter(const XrunCounter&)
+	: m_missing_us(0)
+{
+	for (int i = 0; i < XRUN_CAUSE_COUNT; ++i) {
+		m_counts[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void XrunCounter::Add(XrunCause cause, float missing)
+{
+	m_counts[cause].fetch_add(1, std::memory_order_relaxed);
+	m_missing_us.fetch_add(static_cast<int64_t>(missing * 1e6f + 0.5f), std::memory_order_relaxed);
+}
+
+int XrunCounter::GetCount() const
+{
+	int count = 0;
+	for (int i = 0; i < XRUN_CAUSE_COUNT; ++i) {
+		count += m_counts[i].load(std::memory_order_relaxed);
+	}
+	return count;
+}
+
+int XrunCounter::GetCount(XrunCause cause) const
+{
+	return m_counts[cause].load(std::memory_order_relaxed);
+}
+
+float XrunCounter::GetMissing() const
+{
+	return static_cast<float>(m_missing_us.load(std::memory_order_relaxed) * 1e-6);
+}
+
+/************************************************************************/
+/* class XrunLog                                                        */
+/************************************************************************/
+
+XrunLog::XrunLog()
+	: m_next(0)
+{
+	for (int i = 0; i < CAPACITY; ++i)
+	{
+		Slot& s = m_slots[i];
+		s.seq.store(0, std::memory_order_relaxed);
+		s.time.store(0, std::memory_order_relaxed);
+		s.source.store(0, std::memory_order_relaxed);
+		s.cause.store(0, std::memory_order_relaxed);
+		s.missing.store(0, std::memory_order_relaxed);
+	}
+}
+
+void XrunLog::Add(const XrunEvent& ev)
+{
+	const uint32_t idx = m_next.load(std::memory_order_relaxed);
+	Slot& s = m_slots[idx % CAPACITY];
+
+	s.seq.store(idx * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	s.time.store(ev.time, std::memory_order_relaxed);
+	s.source.store(ev.source, std::memory_order_relaxed);
+	s.cause.store(ev.cause, std::memory_order_relaxed);
+	s.missing.store(ev.missing, std::memory_order_relaxed);
+
+	s.seq.store(idx * 2 + 2, std::memory_order_release);
+	m_next.store(idx + 1, std::memory_order_release);
+
+	m_counter.Add(ev.cause, ev.missing);
+}
+
+int XrunLog::GetRecent(XrunEvent* events, int max) const
+{
+	const uint32_t next = m_next.load(std::memory_order_acquire);
+	const int cap = CAPACITY;
+	const uint32_t n = std::min(next, static_cast<uint32_t>(std::min(std::max(max, 0), cap)));
+
+	int count = 0;
+	for (uint32_t idx = next - n; idx != next; ++idx)
+	{
+		const Slot& s = m_slots[idx % CAPACITY];
+
+		const uint32_t begin = s.seq.load(std::memory_order_acquire);
+		XrunEvent ev;
+		ev.time    = s.time.load(std::memory_order_relaxed);
+		ev.source  = s.source.load(std::memory_order_relaxed);
+		ev.cause   = static_cast<XrunCause>(s.cause.load(std::memory_order_relaxed));
+		ev.missing = s.missing.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint32_t end = s.seq.load(std::memory_order_relaxed);
+
+		// overwritten by a newer event meanwhile
+		if (begin != idx * 2 + 2 || end != begin) {
+			continue;
+		}
+		events[count++] = ev;
+	}
+	return count;
+}
+
+int64_t XrunLog::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "uniaudio/openal/AudioPool.h"
 #include "uniaudio/openal/Source.h"
 #include "uniaudio/AudioData.h"
+#include "uniaudio/AdpcmDecoder.h"
+#include "uniaudio/AudioMixer.h"
 #include "uniaudio/DecoderFactory.h"
 #include "uniaudio/Callback.h"
 #include "uniaudio/Exception.h"
@@ -22,19 +24,21 @@ update_cb(void* arg)
 	pool->Update();
 }
 
-AudioContext::AudioContext()
+AudioContext::AudioContext(const OutputFormat& fmt)
 	: m_own_ctx(true)
 	, m_device(nullptr)
 	, m_context(nullptr)
+	, m_format(fmt)
 	, m_pool(nullptr)
 {
 	Initialize();
 }
 
-AudioContext::AudioContext(ALCdevice* device, ALCcontext* context)
+AudioContext::AudioContext(ALCdevice* device, ALCcontext* context, const OutputFormat& fmt)
 	: m_own_ctx(false)
 	, m_device(device)
 	, m_context(context)
+	, m_format(fmt)
 	, m_pool(nullptr)
 {
 	Initialize();
@@ -49,6 +53,11 @@ std::shared_ptr<ua::Source> AudioContext::CreateSource(const AudioData* data)
 {
 	if (!m_pool) {
 		return nullptr;
+	}
+	// mixed, decoded a block at a time
+	if (data->GetBlockAlign() != 0) {
+		std::unique_ptr<Decoder> decoder = std::make_unique<AdpcmDecoder>(data);
+		return std::make_shared<Source>(m_pool, decoder, true);
 	} else {
 		return std::make_shared<Source>(m_pool, data);
 	}
@@ -111,6 +120,47 @@ void AudioContext::SetVolume(float volume)
 	}
 }
 
+void AudioContext::SetMixThreads(int threads)
+{
+	if (m_pool) {
+		m_pool->SetMixThreads(threads);
+	}
+}
+
+void AudioContext::SetDecodeThreads(int threads)
+{
+	if (m_pool) {
+		m_pool->SetDecodeThreads(threads);
+	}
+}
+
+void AudioContext::SetOutputLatency(float min_time, float max_time)
+{
+	if (m_pool) {
+		m_pool->SetOutputLatency(min_time, max_time);
+	}
+}
+
+float AudioContext::GetOutputLatency() const
+{
+	return m_pool ? m_pool->GetOutputLatency() : 0;
+}
+
+const XrunLog& AudioContext::GetXrunLog() const
+{
+	return m_pool->GetXrunLog();
+}
+
+const BufferPool& AudioContext::GetBufferPool() const
+{
+	return *m_pool->GetBufferPool();
+}
+
+MixGraph& AudioContext::GetMixGraph()
+{
+	return m_pool->GetMixGraph();
+}
+
 void AudioContext::Initialize()
 {
 	try {
@@ -121,7 +171,9 @@ void AudioContext::Initialize()
 				throw Exception("Could not open openal device.");
 			}
 
-			m_context = alcCreateContext(m_device, nullptr);
+			// ask the device to mix at the requested rate
+			const ALCint attrs[] = { ALC_FREQUENCY, m_format.sample_rate, 0 };
+			m_context = alcCreateContext(m_device, m_format.sample_rate != 0 ? attrs : nullptr);
 			if (!m_context) {
 				throw Exception("Could not create openal context.");
 			}
@@ -131,7 +183,9 @@ void AudioContext::Initialize()
 			throw Exception("Could not bind openal context.");
 		}
 
-		m_pool = new AudioPool();
+		NegotiateFormat();
+
+		m_pool = new AudioPool(m_format);
 		if (!m_pool) {
 			throw Exception("Could not create pool.");
 		}
@@ -143,6 +197,30 @@ void AudioContext::Initialize()
 	}
 }
 
+void AudioContext::NegotiateFormat()
+{
+	// Render at the rate the device mixes at, so openal has nothing to
+	// resample on the queue player.
+	ALCint freq = 0;
+	alcGetIntegerv(m_device, ALC_FREQUENCY, 1, &freq);
+	if (freq > 0) {
+		m_format.sample_rate = freq;
+	} else if (m_format.sample_rate == 0) {
+		m_format.sample_rate = AudioMixer::DEFAULT_SAMPLE_RATE;
+	}
+
+	if (m_format.channels == 0) {
+		m_format.channels = AudioMixer::DEFAULT_CHANNELS;
+	} else if (m_format.channels != 1 && m_format.channels != 2) {
+		m_format.channels = AudioMixer::DEFAULT_CHANNELS;
+	}
+
+	if (m_format.sample_fmt == OutputFormat::SAMPLE_F32
+		&& !alIsExtensionPresent("AL_EXT_FLOAT32")) {
+		m_format.sample_fmt = OutputFormat::SAMPLE_S16;
+	}
+}
+
 void AudioContext::Terminate()
 {
 	Callback::UnregisterAsyncUpdate(update_cb);
@@ -4,8 +4,11 @@
 #include "uniaudio/Decoder.h"
 #include "uniaudio/InputBuffer.h"
 #include "uniaudio/OutputBuffer.h"
+#include "uniaudio/Resampler.h"
 #include "uniaudio/Exception.h"
 
+#include <algorithm>
+
 #include <assert.h>
 
 namespace ua
@@ -29,8 +32,98 @@ private:
 
 }; // CheckOpenal
 
-AudioPool::AudioPool()
-	: m_active(true)
+static bool
+has_mix_playing(const std::set<std::shared_ptr<Source>>& playing)
+{
+	for (auto& source : playing) {
+		if (source->IsMix() && !source->IsStopped() && !source->IsPaused()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// `frames` of the mix block had no audio from `source`
+static void
+add_xrun(Source& source, int frames, const AudioMixer& mixer, XrunLog& xruns)
+{
+	XrunEvent ev;
+	ev.time    = XrunLog::Now();
+	ev.source  = source.GetId();
+	ev.cause   = source.GetInputBuffer()->GetStallCause();
+	ev.missing = static_cast<float>(frames) / mixer.GetFormat().sample_rate;
+	xruns.Add(ev);
+	source.GetXruns().Add(ev.cause, ev.missing);
+}
+
+// pulls the next block of `source` and adds it to `batch` for the output
+// block `block`, the format is only read from the decoder the first time
+static void
+add_voice(Source& source, AudioMixer::Batch& batch, const AudioMixer& mixer, uint64_t block, XrunLog& xruns)
+{
+	OutputBuffer* obuf = source.GetOutputBuffer();
+	assert(obuf);
+
+	AudioMixer::Voice& v = source.GetMixVoice();
+	if (!v.IsResolved())
+	{
+		const InputBuffer* ibuf = source.GetInputBuffer();
+		assert(ibuf);
+		const std::unique_ptr<Decoder>& decoder = ibuf->GetDecoder();
+		v = mixer.GetVoice(decoder->GetSampleRate(), decoder->GetBitDepth(), decoder->GetChannels());
+	}
+	if (!v.IsResolved()) {
+		return;
+	}
+
+	if (Resampler* resampler = source.GetResampler())
+	{
+		// feed until the whole mix buffer can be rendered
+		int buf_sz;
+		const unsigned char* buf;
+		while (resampler->GetRequiredFrames(mixer.GetSamples()) > 0
+			&& (buf = obuf->Output(buf_sz))) {
+			resampler->Push(buf, buf_sz, v.bit_depth);
+		}
+		batch.Add(*resampler, source.GetGainRamp(), source.GetPan());
+		const int frames = std::min(mixer.GetSamples(), resampler->GetAvailableFrames());
+		source.GetPlayCursor().Queue(frames, block);
+		if (frames < mixer.GetSamples() && obuf->IsStarved()) {
+			add_xrun(source, mixer.GetSamples() - frames, mixer, xruns);
+		}
+		return;
+	}
+
+	int buf_sz;
+	const unsigned char* buf = obuf->Output(buf_sz);
+	if (!buf && obuf->IsStarved()) {
+		add_xrun(source, mixer.GetSamples(), mixer, xruns);
+	}
+	if (buf && v.IsValid())
+	{
+		const int frames = buf_sz / v.frame_size;
+		batch.Add(buf, frames, v, source.GetGainRamp(), source.GetPan());
+		source.GetPlayCursor().Queue(std::min(frames * v.repeat, mixer.GetSamples()), block);
+	}
+}
+
+static ALenum
+get_al_format(const OutputFormat& fmt)
+{
+	if (fmt.sample_fmt == OutputFormat::SAMPLE_F32) {
+		// AL_EXT_FLOAT32, the enums are not in every al.h
+		return alGetEnumValue(fmt.channels == 1 ? "AL_FORMAT_MONO_FLOAT32" : "AL_FORMAT_STEREO_FLOAT32");
+	} else {
+		return fmt.channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+	}
+}
+
+AudioPool::AudioPool(const OutputFormat& fmt)
+	: m_queue_player(fmt)
+	, m_decode_pool(nullptr)
+	, m_buffer_pool(std::make_shared<BufferPool>())
+	, m_stream_buffers(std::make_shared<StreamBuffers>())
+	, m_active(true)
 	, m_volume(1)
 {
 	ALuint sources[NUM_ASSET_PLAYERS];
@@ -49,6 +142,11 @@ AudioPool::~AudioPool()
 	Stop();
 	assert(m_playing.empty());
 
+	if (m_decode_pool) {
+		delete m_decode_pool;
+	}
+	m_releasing.clear();
+
 	ALuint sources[NUM_ASSET_PLAYERS];
 	assert(m_asset_player_freelist.size() == NUM_ASSET_PLAYERS);
 	int ptr = 0;
@@ -58,6 +156,8 @@ AudioPool::~AudioPool()
 		m_asset_player_freelist.pop();
 	}
 	alDeleteSources(NUM_ASSET_PLAYERS, sources);
+
+	m_stream_buffers->Close();
 }
 
 void AudioPool::Update()
@@ -79,6 +179,7 @@ void AudioPool::Update()
 			continue;
 		}
 
+		StopDecodeAhead(source);
 		source->StopImpl();
 		source->RewindImpl();
 
@@ -89,8 +190,9 @@ void AudioPool::Update()
 
 		m_playing.erase(itr++);
 	}
+	ReleaseDecoded();
 
-	m_queue_player.Update(m_playing);
+	m_queue_player.Update(m_playing, m_xruns);
 }
 
 bool AudioPool::Play(const std::shared_ptr<Source>& source)
@@ -117,6 +219,7 @@ bool AudioPool::Play(const std::shared_ptr<Source>& source)
 	m_playing.insert(source);
 
 	source->PlayImpl();
+	StartDecodeAhead(*source);
 
 	return true;
 }
@@ -135,6 +238,7 @@ void AudioPool::Stop()
 			ALuint player = s->GetPlayer();
 			m_asset_player_freelist.push(player);
 		}
+		StopDecodeAhead(s);
 		s->StopImpl();
 	}
 	m_playing.clear();
@@ -154,6 +258,7 @@ void AudioPool::Stop(const std::shared_ptr<Source>& source)
 			ALuint player = source->GetPlayer();
 			m_asset_player_freelist.push(player);
 		}
+		StopDecodeAhead(source);
 		source->StopImpl();
 		m_playing.erase(itr);
 	}
@@ -229,6 +334,9 @@ void AudioPool::Seek(const std::shared_ptr<Source>& source, float offset)
 
 	std::lock_guard<std::mutex> lock(m_mutex);
 	source->SeekImpl(offset);
+	if (m_decode_pool) {
+		m_decode_pool->Wakeup();
+	}
 }
 
 float AudioPool::Tell(const std::shared_ptr<Source>& source)
@@ -239,17 +347,151 @@ float AudioPool::Tell(const std::shared_ptr<Source>& source)
 	return source->TellImpl();
 }
 
+void AudioPool::SetMixThreads(int threads)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queue_player.SetMixThreads(threads);
+}
+
+void AudioPool::SetOutputLatency(float min_time, float max_time)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queue_player.SetLatency(min_time, max_time);
+}
+
+float AudioPool::GetOutputLatency()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_queue_player.GetLatency();
+}
+
+void AudioPool::SetDecodeThreads(int threads)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_decode_pool) {
+		if (m_decode_pool->GetThreads() == threads) {
+			return;
+		}
+		delete m_decode_pool;
+		m_decode_pool = nullptr;
+		// the workers are joined
+		m_releasing.clear();
+	}
+	if (threads > 0)
+	{
+		m_decode_pool = new DecodePool(threads, AudioContext::BUFFER_TIME_LEN);
+		if (!m_decode_pool) {
+			throw Exception("Could not create DecodePool.");
+		}
+		for (auto& source : m_playing) {
+			StartDecodeAhead(*source);
+		}
+	}
+}
+
+void AudioPool::StartDecodeAhead(Source& source)
+{
+	if (m_decode_pool && source.IsMix()) {
+		m_decode_pool->Add(source.GetInputBuffer(), source.GetOutputBuffer());
+	}
+}
+
+void AudioPool::StopDecodeAhead(const std::shared_ptr<Source>& source)
+{
+	if (m_decode_pool && source->IsMix())
+	{
+		// waiting here would hold the pool's lock for a whole decode
+		m_decode_pool->Remove(source->GetInputBuffer());
+		if (m_decode_pool->IsBusy(source->GetInputBuffer())) {
+			m_releasing.push_back(source);
+		}
+	}
+}
+
+void AudioPool::ReleaseDecoded()
+{
+	if (!m_decode_pool) {
+		m_releasing.clear();
+		return;
+	}
+	auto end = std::remove_if(m_releasing.begin(), m_releasing.end(), [&](const std::shared_ptr<Source>& source) {
+		return !m_decode_pool->IsBusy(source->GetInputBuffer());
+	});
+	m_releasing.erase(end, m_releasing.end());
+}
+
+/************************************************************************/
+/* class StreamBuffers                                                  */
+/************************************************************************/
+
+void StreamBuffers::Gen(ALuint* buffers, int n)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const int reused = std::min(n, static_cast<int>(m_freelist.size()));
+	for (int i = 0; i < reused; ++i) {
+		buffers[i] = m_freelist.back();
+		m_freelist.pop_back();
+	}
+	if (reused == n) {
+		return;
+	}
+
+	alGetError();
+	alGenBuffers(n - reused, buffers + reused);
+	ALenum err = alGetError();
+	if (err != AL_NO_ERROR) {
+		m_freelist.insert(m_freelist.end(), buffers, buffers + reused);
+		throw Exception("Gen openal buffers error: %x\n", err);
+	}
+}
+
+void StreamBuffers::Delete(const ALuint* buffers, int n)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	// deleted with the AL context
+	if (!m_closed) {
+		m_freelist.insert(m_freelist.end(), buffers, buffers + n);
+	}
+}
+
+void StreamBuffers::Close()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_freelist.empty()) {
+		alDeleteBuffers(static_cast<ALsizei>(m_freelist.size()), &m_freelist[0]);
+		m_freelist.clear();
+	}
+	m_closed = true;
+}
+
 /************************************************************************/
 /* class AudioPool::QueuePlayer                                         */
 /************************************************************************/
 
 AudioPool::QueuePlayer::
-QueuePlayer()
+QueuePlayer(const OutputFormat& fmt)
 	: m_source(0)
-	, m_mixer(AudioContext::BUFFER_TIME_LEN)
+	, m_mixer(AudioContext::BUFFER_TIME_LEN, fmt, AudioMixer::BUS_FLOAT32)
+	, m_al_format(get_al_format(m_mixer.GetFormat()))
+	, m_graph(AudioContext::BUFFER_TIME_LEN, m_mixer.GetFormat(), m_mixer.GetBus())
+	, m_parallel(nullptr)
+	, m_depth(AudioContext::BUFFER_TIME_LEN, MIN_BUFFERS, MAX_BUFFERS)
+	, m_queued(MAX_BUFFERS)
+	, m_underruns(0)
+	, m_last_update(0)
+	, m_mixed_blocks(0)
+	, m_played_blocks(0)
+	, m_silent_count(MAX_BUFFERS)
+	, m_idle(false)
 {
 	bool inited_buffers = false;
 	memset(m_buffers, 0, sizeof(m_buffers));
+	for (unsigned int i = 0; i < MAX_BUFFERS; ++i) {
+		m_silent[i] = true;
+		m_block[i] = 0;
+	}
 
 	alGetError();
 
@@ -267,12 +509,14 @@ QueuePlayer()
 		}
 		inited_buffers = true;
 
-		ALenum fmt = AL_FORMAT_STEREO16;
-		assert(AudioMixer::DEFAULT_BIT_DEPTH == 16 && AudioMixer::DEFAULT_CHANNELS == 2);
-		int16_t* buf = m_mixer.Output();
+		if (m_al_format == 0) {
+			throw Exception("AudioPool::QueuePlayer unsupported output format.");
+		}
+		void* buf = m_mixer.Output();
 		int buf_sz = m_mixer.GetBufSize();
-		for (int i = 0; i < MAX_BUFFERS; ++i) {
-			alBufferData(m_buffers[i], fmt, buf, buf_sz, AudioMixer::DEFAULT_SAMPLE_RATE);
+		int hz = m_mixer.GetFormat().sample_rate;
+		for (unsigned int i = 0; i < MAX_BUFFERS; ++i) {
+			alBufferData(m_buffers[i], m_al_format, buf, buf_sz, hz);
 			if ((err = alGetError()) != AL_NO_ERROR)  {
 				throw Exception("AudioPool::QueuePlayer alBufferData error: %x\n", err);
 			}
@@ -298,32 +542,127 @@ AudioPool::QueuePlayer::
 ~QueuePlayer()
 {
 	alDeleteBuffers(MAX_BUFFERS, m_buffers);
+	if (m_parallel) {
+		delete m_parallel;
+	}
 }
 
 void AudioPool::QueuePlayer::
-Update(const std::set<std::shared_ptr<Source>>& playing)
+SetMixThreads(int threads)
+{
+	if (m_parallel) {
+		if (m_parallel->GetThreads() == threads) {
+			return;
+		}
+		delete m_parallel;
+		m_parallel = nullptr;
+	}
+	if (threads > 0)
+	{
+		m_parallel = new ParallelMixer(AudioContext::BUFFER_TIME_LEN, m_mixer.GetFormat(), m_mixer.GetBus(), threads);
+		if (!m_parallel) {
+			throw Exception("Could not create ParallelMixer.");
+		}
+	}
+}
+
+void AudioPool::QueuePlayer::
+SetLatency(float min_time, float max_time)
+{
+	m_depth.SetLatency(min_time, std::min(max_time, MAX_BUFFERS * m_depth.GetBlockTime()));
+}
+
+float AudioPool::QueuePlayer::
+GetLatency() const
+{
+	return m_queued * m_depth.GetBlockTime();
+}
+
+void AudioPool::QueuePlayer::
+Update(const std::set<std::shared_ptr<Source>>& playing, XrunLog& xruns)
 {
 	CheckOpenal check;
 
+	const bool active = has_mix_playing(playing);
+	if (m_idle)
+	{
+		if (!active) {
+			return;
+		}
+		Wakeup();
+	}
+
 	ALint processed = 0;
 	alGetSourcei(m_source, AL_BUFFERS_PROCESSED, &processed);
+	const int64_t now = XrunLog::Now();
+	if (processed > 0 && static_cast<unsigned int>(processed) >= m_queued)
+	{
+		++m_underruns;
+
+		// the queue held m_queued blocks at the last update, the rest of
+		// the time was not played
+		XrunEvent ev;
+		ev.time    = now;
+		ev.source  = -1;
+		ev.cause   = XRUN_CONSUMER_EARLY;
+		ev.missing = m_last_update == 0 ? 0 :
+			std::max(static_cast<float>((now - m_last_update) * 1e-9) - m_queued * m_depth.GetBlockTime(), 0.0f);
+		xruns.Add(ev);
+	}
+	m_last_update = now;
+	const unsigned int depth = m_depth.Update(m_underruns);
+
 	while (processed--)
 	{
 		ALuint buffer;
 		alSourceUnqueueBuffers(m_source, 1, &buffer);
-		Stream(buffer, playing);
+		--m_queued;
+		m_played_blocks = std::max(m_played_blocks, m_block[GetBufferIndex(buffer)] + 1);
+		// shrinking, the queue drains to the depth
+		if (m_queued >= depth) {
+			m_free.push_back(buffer);
+			continue;
+		}
+		Stream(buffer, playing, xruns);
 		alSourceQueueBuffers(m_source, 1, &buffer);
+		++m_queued;
+	}
+	// growing
+	while (m_queued < depth && !m_free.empty())
+	{
+		ALuint buffer = m_free.back();
+		m_free.pop_back();
+		Stream(buffer, playing, xruns);
+		alSourceQueueBuffers(m_source, 1, &buffer);
+		++m_queued;
+	}
+
+	// a starved source stops by itself
+	ALint state;
+	alGetSourcei(m_source, AL_SOURCE_STATE, &state);
+	if (state != AL_PLAYING) {
+		alSourcePlay(m_source);
+	}
+
+	if (!active && m_silent_count >= m_queued) {
+		Sleep();
+	}
+
+	// the cursors move by what the device played, paused voices still
+	// drain their queued blocks
+	for (auto& source : playing) {
+		if (source->IsMix()) {
+			source->GetPlayCursor().Play(m_played_blocks);
+		}
 	}
 }
 
 void AudioPool::QueuePlayer::
-Stream(ALuint buffer, const std::set<std::shared_ptr<Source>>& playing)
+Stream(ALuint buffer, const std::set<std::shared_ptr<Source>>& playing, XrunLog& xruns)
 {
 	CheckOpenal check;
 
 	m_mixer.Reset();
-
-	ALenum fmt = AL_FORMAT_STEREO16;
 	auto itr = playing.begin();
 	for ( ; itr != playing.end(); ++itr)
 	{
@@ -331,29 +670,72 @@ Stream(ALuint buffer, const std::set<std::shared_ptr<Source>>& playing)
 		if (!source->IsMix() || source->IsStopped() || source->IsPaused()) {
 			continue;
 		}
+		add_voice(*source, m_graph.GetBatch(source->GetMixBus()), m_mixer, m_mixed_blocks, xruns);
+	}
+	m_graph.Mix(m_mixer, m_parallel);
 
-		OutputBuffer* obuf = source->GetOutputBuffer();
-		assert(obuf);
-		int buf_sz;
-		const unsigned char* buf = obuf->Output(buf_sz);
-		if (!buf) {
-			continue;
-		}
+	void* buf = m_mixer.Output();
 
-		const InputBuffer* ibuf = source->GetInputBuffer();
-		assert(ibuf);
-		const std::unique_ptr<Decoder>& decoder = ibuf->GetDecoder();
-		int hz = decoder->GetSampleRate();
-		int depth = decoder->GetBitDepth();
-		int channels = decoder->GetChannels();
+	const bool silent = m_mixer.IsSilent();
+	if (silent) {
+		++m_silent_count;
+	} else {
+		m_silent_count = 0;
+	}
 
-		m_mixer.Input(buf, buf_sz, hz, depth, channels, source->GetCurrVolume());
+	const int idx = GetBufferIndex(buffer);
+	m_block[idx] = m_mixed_blocks++;
+	if (silent && m_silent[idx]) {
+		return;
 	}
+	m_silent[idx] = silent;
 
-	int16_t* buf = m_mixer.Output();
 	int buf_sz = m_mixer.GetBufSize();
-	alBufferData(buffer, fmt, buf, buf_sz, AudioMixer::DEFAULT_SAMPLE_RATE);
+	alBufferData(buffer, m_al_format, buf, buf_sz, m_mixer.GetFormat().sample_rate);
+}
+
+void AudioPool::QueuePlayer::
+Sleep()
+{
+	// every buffer is processed after stopping
+	alSourceStop(m_source);
+	ALuint buffers[MAX_BUFFERS];
+	alSourceUnqueueBuffers(m_source, m_queued, buffers);
+	m_free.insert(m_free.end(), buffers, buffers + m_queued);
+	m_queued = 0;
+	m_played_blocks = m_mixed_blocks;
+	m_idle = true;
+}
+
+void AudioPool::QueuePlayer::
+Wakeup()
+{
+	// the queue was all silence, the buffers still hold it
+	const unsigned int depth = m_depth.GetDepth();
+	for (auto itr = m_free.begin(); itr != m_free.end() && m_queued < depth; )
+	{
+		if (!m_silent[GetBufferIndex(*itr)]) {
+			++itr;
+			continue;
+		}
+		alSourceQueueBuffers(m_source, 1, &*itr);
+		++m_queued;
+		itr = m_free.erase(itr);
+	}
+	alSourcePlay(m_source);
+	// the idle time is no refill gap
+	m_depth.Restart();
+	m_last_update = 0;
+	m_idle = false;
 }
 
+int AudioPool::QueuePlayer::
+GetBufferIndex(ALuint buffer) const
+{
+	const int idx = static_cast<int>(std::find(m_buffers, m_buffers + MAX_BUFFERS, buffer) - m_buffers);
+	assert(idx < static_cast<int>(MAX_BUFFERS));
+	return idx;
 }
+
 }
+}
\ No newline at end of file
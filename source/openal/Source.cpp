@@ -7,6 +7,8 @@
 #include "uniaudio/InputBuffer.h"
 #include "uniaudio/Exception.h"
 
+#include <algorithm>
+
 #include <assert.h>
 
 #define FORCE_REPLAY
@@ -27,7 +29,11 @@ Source::Source(AudioPool* pool, const AudioData* data)
 	, m_mix(false)
 	, m_ibuf(nullptr)
 	, m_obuf(nullptr)
+	, m_depth(AudioContext::BUFFER_TIME_LEN, OUTPUT_BUF_MIN_DEPTH, OUTPUT_BUF_COUNT)
+	, m_resampler(nullptr)
 	, m_player(0)
+	, m_last_update(0)
+	, m_last_queued(0)
 {
 	memset(m_buffers, 0, sizeof(m_buffers));
 
@@ -68,7 +74,11 @@ Source::Source(AudioPool* pool, std::unique_ptr<Decoder>& decoder, bool mix)
 	, m_mix(mix)
 	, m_ibuf(nullptr)
 	, m_obuf(nullptr)
+	, m_depth(AudioContext::BUFFER_TIME_LEN, OUTPUT_BUF_MIN_DEPTH, OUTPUT_BUF_COUNT)
+	, m_resampler(nullptr)
 	, m_player(0)
+	, m_last_update(0)
+	, m_last_queued(0)
 {
 	m_ibuf = new InputBuffer(decoder);
 	if (!m_ibuf) {
@@ -83,18 +93,15 @@ Source::Source(AudioPool* pool, std::unique_ptr<Decoder>& decoder, bool mix)
 		const int channels = dc->GetChannels();
 		const int samples = static_cast<int>(HZ * AudioContext::BUFFER_TIME_LEN);
 		int buf_sz = depth * channels * samples / 8;
-		m_obuf = new OutputBuffer(OUTPUT_BUF_COUNT, buf_sz);
+		m_obuf = new OutputBuffer(OUTPUT_BUF_COUNT, buf_sz, m_pool->GetBufferPool());
 		if (!m_obuf) {
 			throw Exception("Could not create OutputBuffer.");
 		}
 	}
 	else
 	{
-		alGetError();
-		alGenBuffers(MAX_BUFFERS, m_buffers);
-		if (ALenum err = alGetError() != AL_NO_ERROR)  {
-			throw Exception("Gen openal buffers error: %x\n", err);
-		}
+		m_stream_buffers = m_pool->GetStreamBuffers();
+		m_stream_buffers->Gen(m_buffers, MAX_BUFFERS);
 	}
 }
 
@@ -110,7 +117,11 @@ Source::Source(const Source& src)
 	, m_mix(src.m_mix)
 	, m_ibuf(nullptr)
 	, m_obuf(nullptr)
+	, m_depth(src.m_depth)
+	, m_resampler(nullptr)
 	, m_player(src.m_player)
+	, m_last_update(0)
+	, m_last_queued(0)
 {
 	memset(m_buffers, 0, sizeof(m_buffers));
 
@@ -121,6 +132,8 @@ Source::Source(const Source& src)
 		if (!m_ibuf) {
 			throw Exception("Could not create InputBuffer.");
 		}
+		m_ibuf->SetLooping(m_looping);
+		m_ibuf->SetLoopRegion(m_loop_begin, m_loop_end);
 
 		if (m_mix)
 		{
@@ -130,18 +143,15 @@ Source::Source(const Source& src)
 			const int channels = dc->GetChannels();
 			const int samples = static_cast<int>(HZ * AudioContext::BUFFER_TIME_LEN);
 			int buf_sz = depth * channels * samples / 8;
-			m_obuf = new OutputBuffer(OUTPUT_BUF_COUNT, buf_sz);
+			m_obuf = new OutputBuffer(OUTPUT_BUF_COUNT, buf_sz, m_pool->GetBufferPool());
 			if (!m_obuf) {
 				throw Exception("Could not create OutputBuffer.");
 			}
 		}
 		else
 		{
-			alGetError();
-			alGenBuffers(MAX_BUFFERS, m_buffers);
-			if (ALenum err = alGetError() != AL_NO_ERROR) {
-				throw Exception("Gen openal buffers error: %x\n", err);
-			}
+			m_stream_buffers = m_pool->GetStreamBuffers();
+			m_stream_buffers->Gen(m_buffers, MAX_BUFFERS);
 		}
 	}
 	else
@@ -157,7 +167,7 @@ Source::~Source()
 	}
 	if (m_stream) {
 		if (!m_mix) {
-			alDeleteBuffers(MAX_BUFFERS, m_buffers);
+			m_stream_buffers->Delete(m_buffers, MAX_BUFFERS);
 		}
 	}
 	else {
@@ -170,6 +180,9 @@ Source::~Source()
 	if (m_obuf) {
 		delete m_obuf;
 	}
+	if (m_resampler) {
+		delete m_resampler;
+	}
 }
 
 std::shared_ptr<ua::Source> Source::Clone()
@@ -189,7 +202,7 @@ bool Source::Update()
 		return !IsStopped();
 	} else if (!IsLooping() && IsFinished()) {
 		return false;
-	} else if (m_duration != 0 && GetCurrOffset() > m_offset + m_duration) {
+	} else if (IsPastDuration(GetCurrOffset())) {
 		StopImpl();
 		return false;
 	}
@@ -200,7 +213,11 @@ bool Source::Update()
 	if (m_mix)
 	{
 		assert(m_ibuf && m_obuf);
-		m_ibuf->Output(m_obuf, IsLooping());
+		m_obuf->SetDepth(m_depth.Update(m_obuf->GetUnderruns()));
+		// decoded ahead on the pool's workers otherwise
+		if (!m_pool->IsDecodeAhead()) {
+			m_ibuf->Output(m_obuf);
+		}
 	}
 	else
 	{
@@ -223,6 +240,27 @@ bool Source::Update()
 				alSourceQueueBuffers(m_player, 1, &buffer);
 			}
 		}
+
+		// a drained queue stops the player
+		ALint state, queued;
+		alGetSourcei(m_player, AL_SOURCE_STATE, &state);
+		alGetSourcei(m_player, AL_BUFFERS_QUEUED, &queued);
+		const int64_t now = XrunLog::Now();
+		if (state == AL_STOPPED && queued > 0)
+		{
+			XrunEvent ev;
+			ev.time    = now;
+			ev.source  = GetId();
+			ev.cause   = m_ibuf->GetStallCause();
+			ev.missing = m_last_update == 0 ? 0 :
+				std::max(static_cast<float>((now - m_last_update) * 1e-9) - m_last_queued * GetBufferTime(), 0.0f);
+			m_pool->GetXrunLog().Add(ev);
+			m_xruns.Add(ev.cause, ev.missing);
+
+			alSourcePlay(m_player);
+		}
+		m_last_update = now;
+		m_last_queued = queued;
 	}
 
  	return true;
@@ -275,6 +313,10 @@ void Source::Seek(float offset)
 
 float Source::Tell()
 {
+	// published by the mixer, no lock
+	if (m_mix) {
+		return static_cast<float>(WrapLoop(m_cursor.GetTime(true), m_freq, m_ibuf->GetDecoder()->GetDuration()));
+	}
 	return m_pool->Tell(shared_from_this());
 }
 
@@ -282,13 +324,23 @@ void Source::PlayImpl()
 {
 	// init offset
 	m_curr_offset = m_offset;
+	m_last_update = 0;
+
+	if (m_mix) {
+		ResetResampler();
+		m_mix_voice = AudioMixer::Voice();
+		m_gain_ramp.SetSampleRate(m_pool->GetOutputFormat().sample_rate);
+		m_gain_ramp.Start(m_ori_volume * m_pool->GetVolume());
+		m_cursor.SetSampleRate(m_pool->GetOutputFormat().sample_rate);
+		m_cursor.Reset(m_offset);
+		m_depth.Restart();
+	}
 	if (m_offset != 0)
 	{
 		if (m_stream) {
-			bool looping = IsLooping();
-			m_ibuf->Seek(m_offset, looping);
+			m_ibuf->Seek(m_offset);
 			if (m_mix) {
-				m_ibuf->Output(m_obuf, looping);
+				m_ibuf->Output(m_obuf);
 			}
 		} else {
 			alSourcef(m_player, AL_SEC_OFFSET, m_offset);
@@ -300,14 +352,14 @@ void Source::PlayImpl()
 		if (!m_mix)
 		{
 			int used = 0;
-			for (int i = 0; i < MAX_BUFFERS; ++i)
+			for (unsigned int i = 0; i < MAX_BUFFERS; ++i)
 			{
 				if (Stream(m_buffers[i]) == 0) {
 					break;
 				}
 				++used;
 				assert(m_ibuf);
-				if (m_ibuf->GetDecoder()->IsFinished()) {
+				if (m_ibuf->IsDecoderFinished()) {
 					break;
 				}
 			}
@@ -363,6 +415,8 @@ void Source::StopImpl()
 	}
 	if (!m_mix) {
 		alSourcei(m_player, AL_BUFFER, AL_NONE);
+	} else {
+		m_cursor.Reset(0);
 	}
 
 	m_active = false;
@@ -430,16 +484,17 @@ void Source::SeekImpl(float offset)
 
 	if (m_stream)
 	{
-		bool looping = IsLooping();
-		m_ibuf->Seek(offset, looping);
+		m_ibuf->Seek(offset);
 		if (m_mix) {
-			m_ibuf->Output(m_obuf, looping);
+			m_ibuf->Output(m_obuf);
 		}
 
 		bool paused = m_paused;
 		StopImpl();
 		PlayImpl();
 		m_curr_offset = offset;
+		m_gain_ramp.Seek(offset - m_offset);
+		m_cursor.Reset(offset);
 		if (paused) {
 			PauseImpl();
 		}
@@ -455,12 +510,15 @@ float Source::TellImpl()
 	if (!m_active) {
 		return 0;
 	}
+	if (m_mix) {
+		return static_cast<float>(WrapLoop(m_cursor.GetTime(), m_freq, m_ibuf->GetDecoder()->GetDuration()));
+	}
 
 	float offset;
 	alGetSourcef(m_player, AL_SAMPLE_OFFSET, &offset);
 	offset /= m_freq;
 	if (m_stream) {
-		offset += m_curr_offset;
+		offset = static_cast<float>(WrapLoop(offset + m_curr_offset, m_freq, m_ibuf->GetDecoder()->GetDuration()));
 	}
 	return offset;
 }
@@ -472,6 +530,20 @@ void Source::SetLooping(bool looping)
 		alSourcei(m_player, AL_LOOPING, looping ? AL_TRUE : AL_FALSE);
 	}
 	m_looping = looping;
+	if (m_ibuf) {
+		m_ibuf->SetLooping(looping);
+	}
+	UpdateFadeOut();
+}
+
+void Source::SetLoopRegion(int64_t begin, int64_t end)
+{
+	if (!SetLoopRegionImpl(begin, end)) {
+		throw Exception("Invalid loop region: %lld %lld\n", static_cast<long long>(begin), static_cast<long long>(end));
+	}
+	if (m_ibuf) {
+		m_ibuf->SetLoopRegion(begin, end);
+	}
 }
 
 void Source::SetPlayer(ALuint player)
@@ -512,11 +584,26 @@ bool Source::IsPaused() const
 	}
 }
 
+int Source::GetUnderruns() const
+{
+	return m_obuf ? m_obuf->GetUnderruns() : 0;
+}
+
+void Source::SetBufferLatency(float min_time, float max_time)
+{
+	m_depth.SetLatency(min_time, std::min(max_time, OUTPUT_BUF_COUNT * m_depth.GetBlockTime()));
+}
+
+float Source::GetBufferLatency() const
+{
+	return m_obuf ? m_obuf->GetDepth() * m_depth.GetBlockTime() : 0;
+}
+
 bool Source::IsFinished() const
 {
 	if (m_stream) {
 		assert(m_ibuf);
-		return IsStopped() && !IsLooping() && m_ibuf->GetDecoder()->IsFinished();
+		return IsStopped() && !IsLooping() && m_ibuf->IsDecoderFinished();
 	} else {
 		return IsStopped();
 	}
@@ -540,22 +627,19 @@ int Source::Stream(ALuint buffer)
 {
 	assert(m_ibuf && !m_mix);
 	const std::unique_ptr<Decoder>& d = m_ibuf->GetDecoder();
-	int decoded = std::max(d->Decode(), 0);
+	// loops across the seam
+	const unsigned char* buf = nullptr;
+	int decoded = m_ibuf->Decode(buf);
 	if (decoded > 0)
 	{
 		int fmt = GetFormat(d->GetChannels(), d->GetBitDepth());
 		if (fmt != 0) {
-			alBufferData(buffer, fmt, d->GetBuffer(), decoded, d->GetSampleRate());
+			alBufferData(buffer, fmt, buf, decoded, d->GetSampleRate());
 		} else {
 			decoded = 0;
 		}
 	}
 
-	if (d->IsFinished() && IsLooping())
-	{
-		d->Rewind();
-	}
-
 	return decoded;
 }
 
@@ -583,6 +667,11 @@ float Source::GetCurrOffset(int freq)
 void Source::UpdateCurrVolume()
 {
 	m_curr_volume = m_ori_volume * m_pool->GetVolume();
+	if (m_mix) {
+		// the mixer does the fades
+		m_gain_ramp.SetVolume(m_curr_volume);
+		return;
+	}
 
 	float offset = GetCurrOffset();
 	if (m_fade_in > 0 && offset < m_fade_in) {
@@ -592,9 +681,39 @@ void Source::UpdateCurrVolume()
 	}
 }
 
+float Source::GetBufferTime() const
+{
+	auto& d = m_ibuf->GetDecoder();
+	const int bytes_per_sec = d->GetSampleRate() * d->GetChannels() * d->GetBitDepth() / 8;
+	return bytes_per_sec > 0 ? static_cast<float>(d->GetBufferSize()) / bytes_per_sec : 0;
+}
+
 float Source::GetCurrOffset() const
 {
-	return m_mix ? m_ibuf->GetOffset() : m_curr_offset;
+	return m_mix ? static_cast<float>(m_cursor.GetTime()) : m_curr_offset;
+}
+
+void Source::ResetResampler()
+{
+	auto& dc = m_ibuf->GetDecoder();
+	const int hz = dc->GetSampleRate();
+	const int out_hz = m_pool->GetOutputFormat().sample_rate;
+	if (hz == out_hz) {
+		return;
+	}
+
+	if (m_resampler && m_resampler->GetQuality() == m_resample_quality) {
+		m_resampler->Reset();
+		return;
+	}
+
+	if (m_resampler) {
+		delete m_resampler;
+	}
+	m_resampler = new Resampler(hz, out_hz, dc->GetChannels(), m_resample_quality);
+	if (!m_resampler) {
+		throw Exception("Could not create Resampler.");
+	}
 }
 
 }
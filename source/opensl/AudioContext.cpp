@@ -1,6 +1,8 @@
 #include "uniaudio/opensl/AudioContext.h"
 #include "uniaudio/opensl/AudioPool.h"
 #include "uniaudio/opensl/Source.h"
+#include "uniaudio/AudioData.h"
+#include "uniaudio/AdpcmDecoder.h"
 #include "uniaudio/DecoderFactory.h"
 #include "uniaudio/Callback.h"
 #include "uniaudio/Exception.h"
@@ -23,24 +25,26 @@ update_cb(void* arg)
 	pool->Update();
 }
 
-AudioContext::AudioContext()
+AudioContext::AudioContext(const OutputFormat& fmt)
 	: m_own_ctx(true)
 	, m_engine_obj(nullptr)
 	, m_engine_engine(nullptr)
 	, m_output_mix_obj(nullptr)
 	, m_output_mix_env_reverb(nullptr)
 	, m_pool(nullptr)
+	, m_format(fmt)
 {
 	Initialize();
 }
 
-AudioContext::AudioContext(SLObjectItf engine, SLObjectItf output_mix)
+AudioContext::AudioContext(SLObjectItf engine, SLObjectItf output_mix, const OutputFormat& fmt)
 	: m_own_ctx(false)
 	, m_engine_obj(engine)
 	, m_engine_engine(nullptr)
 	, m_output_mix_obj(output_mix)
 	, m_output_mix_env_reverb(nullptr)
 	, m_pool(nullptr)
+	, m_format(fmt)
 {
 	Initialize();
 }
@@ -52,7 +56,12 @@ AudioContext::~AudioContext()
 
 std::shared_ptr<ua::Source> AudioContext::CreateSource(const AudioData* data)
 {
-	return nullptr;
+	// only IMA ADPCM data, streamed from memory
+	if (!m_pool || data->GetBlockAlign() == 0) {
+		return nullptr;
+	}
+	std::unique_ptr<Decoder> decoder = std::make_unique<AdpcmDecoder>(data);
+	return std::make_shared<Source>(m_pool, decoder);
 }
 
 std::shared_ptr<ua::Source> AudioContext::CreateSource(std::unique_ptr<Decoder>& decoder)
@@ -112,6 +121,47 @@ void AudioContext::SetVolume(float volume)
 	}
 }
 
+void AudioContext::SetMixThreads(int threads)
+{
+	if (m_pool) {
+		m_pool->SetMixThreads(threads);
+	}
+}
+
+void AudioContext::SetDecodeThreads(int threads)
+{
+	if (m_pool) {
+		m_pool->SetDecodeThreads(threads);
+	}
+}
+
+void AudioContext::SetOutputLatency(float min_time, float max_time)
+{
+	if (m_pool) {
+		m_pool->SetOutputLatency(min_time, max_time);
+	}
+}
+
+float AudioContext::GetOutputLatency() const
+{
+	return m_pool ? m_pool->GetOutputLatency() : 0;
+}
+
+const XrunLog& AudioContext::GetXrunLog() const
+{
+	return m_pool->GetXrunLog();
+}
+
+const BufferPool& AudioContext::GetBufferPool() const
+{
+	return *m_pool->GetBufferPool();
+}
+
+MixGraph& AudioContext::GetMixGraph()
+{
+	return m_pool->GetMixGraph();
+}
+
 #ifdef __ANDROID__
 
 void AudioContext::InitAAssetMgr(JNIEnv* env, jobject assetManager)
@@ -195,10 +245,11 @@ void AudioContext::Initialize()
 			(void)result;
 		}
 
-		m_pool = new AudioPool(this);
+		m_pool = new AudioPool(this, m_format);
 		if (!m_pool) {
 			throw Exception("Could not create pool.");
 		}
+		m_format = m_pool->GetOutputFormat();
 
 		Callback::RegisterAsyncUpdate(update_cb, m_pool);
 	} catch (Exception&) {
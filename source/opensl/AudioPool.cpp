@@ -4,9 +4,10 @@
 #include "uniaudio/Decoder.h"
 #include "uniaudio/InputBuffer.h"
 #include "uniaudio/OutputBuffer.h"
+#include "uniaudio/Resampler.h"
 #include "uniaudio/Exception.h"
 
-#include <cstdlib>
+#include <algorithm>
 
 #include <stddef.h>
 #include <assert.h>
@@ -16,14 +17,118 @@ namespace ua
 namespace opensl
 {
 
-AudioPool::AudioPool(AudioContext* ctx)
+static bool
+has_stream_playing(const CU_SET<std::shared_ptr<Source>>& playing)
+{
+	for (auto& source : playing) {
+		if (source->IsStream() && !source->IsStopped() && !source->IsPaused()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// `frames` of the mix block had no audio from `source`
+static void
+add_xrun(Source& source, int frames, const AudioMixer& mixer, XrunLog& xruns)
+{
+	XrunEvent ev;
+	ev.time    = XrunLog::Now();
+	ev.source  = source.GetId();
+	ev.cause   = source.GetInputBuffer()->GetStallCause();
+	ev.missing = static_cast<float>(frames) / mixer.GetFormat().sample_rate;
+	xruns.Add(ev);
+	source.GetXruns().Add(ev.cause, ev.missing);
+}
+
+// pulls the next block of `source` and adds it to `batch` for the output
+// block `block`, the format is only read from the decoder the first time
+static void
+add_voice(Source& source, AudioMixer::Batch& batch, const AudioMixer& mixer, uint64_t block, XrunLog& xruns)
+{
+	OutputBuffer* obuf = source.GetOutputBuffer();
+	assert(obuf);
+
+	AudioMixer::Voice& v = source.GetMixVoice();
+	if (!v.IsResolved())
+	{
+		const InputBuffer* ibuf = source.GetInputBuffer();
+		assert(ibuf);
+		const std::unique_ptr<Decoder>& decoder = ibuf->GetDecoder();
+		v = mixer.GetVoice(decoder->GetSampleRate(), decoder->GetBitDepth(), decoder->GetChannels());
+	}
+	if (!v.IsResolved()) {
+		return;
+	}
+
+	if (Resampler* resampler = source.GetResampler())
+	{
+		// feed until the whole mix buffer can be rendered
+		int buf_sz;
+		const unsigned char* buf;
+		while (resampler->GetRequiredFrames(mixer.GetSamples()) > 0
+			&& (buf = obuf->Output(buf_sz))) {
+			resampler->Push(buf, buf_sz, v.bit_depth);
+		}
+		batch.Add(*resampler, source.GetGainRamp(), source.GetPan());
+		const int frames = std::min(mixer.GetSamples(), resampler->GetAvailableFrames());
+		source.GetPlayCursor().Queue(frames, block);
+		if (frames < mixer.GetSamples() && obuf->IsStarved()) {
+			add_xrun(source, mixer.GetSamples() - frames, mixer, xruns);
+		}
+		return;
+	}
+
+	int buf_sz;
+	const unsigned char* buf = obuf->Output(buf_sz);
+	if (!buf) {
+		if (obuf->IsStarved()) {
+			add_xrun(source, mixer.GetSamples(), mixer, xruns);
+		}
+		return;
+	}
+
+	if (v.IsValid())
+	{
+		const int frames = buf_sz / v.frame_size;
+		batch.Add(buf, frames, v, source.GetGainRamp(), source.GetPan());
+		source.GetPlayCursor().Queue(std::min(frames * v.repeat, mixer.GetSamples()), block);
+	}
+}
+
+AudioPool::AudioPool(AudioContext* ctx, const OutputFormat& fmt)
 	: m_ctx(ctx)
-	, m_queue_mixer(AudioContext::BUFFER_TIME_LEN)
+	, m_queue_mixer(nullptr)
+	, m_graph(nullptr)
+	, m_parallel(nullptr)
+	, m_decode_pool(nullptr)
+	, m_buffer_pool(std::make_shared<BufferPool>())
+	, m_silence(nullptr)
+	, m_silent_count(0)
+	, m_queue_idle(false)
+	, m_queue_paused(false)
+	, m_mixed_blocks(0)
+	, m_played_blocks(0)
 	, m_volume(1)
 {
 	CreateAssetsAudioPlayer();
 
-	CreateBufferQueueAudioPlayer();
+	CreateBufferQueueAudioPlayer(fmt);
+
+	m_queue_mixer = new AudioMixer(AudioContext::BUFFER_TIME_LEN, m_format, AudioMixer::BUS_FLOAT32);
+	if (!m_queue_mixer) {
+		throw Exception("Could not create AudioMixer.");
+	}
+	m_graph = new MixGraph(AudioContext::BUFFER_TIME_LEN, m_format, m_queue_mixer->GetBus());
+	if (!m_graph) {
+		throw Exception("Could not create MixGraph.");
+	}
+	m_silence = new uint8_t[m_queue_mixer->GetBufSize()];
+	if (m_silence) {
+		memset(m_silence, 0, m_queue_mixer->GetBufSize());
+	} else {
+		throw Exception("Could not create m_silence.");
+	}
 	EnqueueAllBuffers();
 }
 
@@ -37,6 +142,29 @@ AudioPool::~AudioPool()
 		delete player;
 		m_asset_player_freelist.pop();
 	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_queue_mixer) {
+		delete m_queue_mixer;
+		m_queue_mixer = nullptr;
+	}
+	if (m_silence) {
+		delete[] m_silence;
+		m_silence = nullptr;
+	}
+	if (m_parallel) {
+		delete m_parallel;
+		m_parallel = nullptr;
+	}
+	if (m_decode_pool) {
+		delete m_decode_pool;
+		m_decode_pool = nullptr;
+	}
+	m_releasing.clear();
+	if (m_graph) {
+		delete m_graph;
+		m_graph = nullptr;
+	}
 }
 
 void AudioPool::Update()
@@ -62,11 +190,24 @@ void AudioPool::Update()
 			m_asset_player_freelist.push(player);
 		}
 
+		StopDecodeAhead(source);
 		source->StopImpl();
 		source->RewindImpl();
 
 		m_playing.erase(itr++);
 	}
+	ReleaseDecoded();
+
+	if (m_queue_idle)
+	{
+		if (has_stream_playing(m_playing)) {
+			WakeupQueuePlayer();
+		} else if (!m_queue_paused) {
+			// let the device go to standby
+			(*m_queue_player.play)->SetPlayState(m_queue_player.play, SL_PLAYSTATE_PAUSED);
+			m_queue_paused = true;
+		}
+	}
 }
 
 bool AudioPool::Play(const std::shared_ptr<Source>& source)
@@ -97,6 +238,7 @@ bool AudioPool::Play(const std::shared_ptr<Source>& source)
 	m_playing.insert(source);
 
 	source->PlayImpl();
+	StartDecodeAhead(*source);
 
 	return true;
 }
@@ -116,6 +258,7 @@ void AudioPool::Stop()
 			player->Release();
 			m_asset_player_freelist.push(player);
 		}
+		StopDecodeAhead(s);
 		s->StopImpl();
 	}
 	m_playing.clear();
@@ -138,6 +281,7 @@ void AudioPool::Stop(const std::shared_ptr<Source>& source)
 		m_asset_player_freelist.push(player);
 	}
 
+	StopDecodeAhead(source);
 	source->StopImpl();
 	m_playing.erase(itr);
 }
@@ -194,6 +338,9 @@ void AudioPool::Seek(const std::shared_ptr<Source>& source, float offset)
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
 	source->SeekImpl(offset);
+	if (m_decode_pool) {
+		m_decode_pool->Wakeup();
+	}
 }
 
 float AudioPool::Tell(const std::shared_ptr<Source>& source)
@@ -202,13 +349,118 @@ float AudioPool::Tell(const std::shared_ptr<Source>& source)
 	return source->TellImpl();
 }
 
+void AudioPool::SetMixThreads(int threads)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_parallel) {
+		if (m_parallel->GetThreads() == threads) {
+			return;
+		}
+		delete m_parallel;
+		m_parallel = nullptr;
+	}
+	if (threads > 0)
+	{
+		m_parallel = new ParallelMixer(AudioContext::BUFFER_TIME_LEN, m_format, m_queue_mixer->GetBus(), threads);
+		if (!m_parallel) {
+			throw Exception("Could not create ParallelMixer.");
+		}
+	}
+}
+
+float AudioPool::GetOutputLatency() const
+{
+	return NUM_OPENSL_BUFFERS * AudioContext::BUFFER_TIME_LEN;
+}
+
+void AudioPool::SetDecodeThreads(int threads)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_decode_pool) {
+		if (m_decode_pool->GetThreads() == threads) {
+			return;
+		}
+		delete m_decode_pool;
+		m_decode_pool = nullptr;
+		// the workers are joined
+		m_releasing.clear();
+	}
+	if (threads > 0)
+	{
+		m_decode_pool = new DecodePool(threads, AudioContext::BUFFER_TIME_LEN);
+		if (!m_decode_pool) {
+			throw Exception("Could not create DecodePool.");
+		}
+		for (auto& source : m_playing) {
+			StartDecodeAhead(*source);
+		}
+	}
+}
+
+void AudioPool::StartDecodeAhead(Source& source)
+{
+	if (m_decode_pool && source.IsStream()) {
+		m_decode_pool->Add(source.GetInputBuffer(), source.GetOutputBuffer());
+	}
+}
+
+void AudioPool::StopDecodeAhead(const std::shared_ptr<Source>& source)
+{
+	if (m_decode_pool && source->IsStream())
+	{
+		// waiting here would hold the pool's lock for a whole decode
+		m_decode_pool->Remove(source->GetInputBuffer());
+		if (m_decode_pool->IsBusy(source->GetInputBuffer())) {
+			m_releasing.push_back(source);
+		}
+	}
+}
+
+void AudioPool::ReleaseDecoded()
+{
+	if (!m_decode_pool) {
+		m_releasing.clear();
+		return;
+	}
+	auto end = std::remove_if(m_releasing.begin(), m_releasing.end(), [&](const std::shared_ptr<Source>& source) {
+		return !m_decode_pool->IsBusy(source->GetInputBuffer());
+	});
+	m_releasing.erase(end, m_releasing.end());
+}
+
 void AudioPool::ProcessSLCallback(SLAndroidSimpleBufferQueueItf bq)
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
 
 	assert(bq == m_queue_player.queue);
 
-	m_queue_mixer.Reset();
+	if (!m_queue_mixer) {
+		return;
+	}
+
+	// the cursors move by what the device played, paused voices still
+	// drain their queued blocks
+	m_played_blocks = std::min(m_played_blocks + 1, m_mixed_blocks);
+	for (auto& source : m_playing) {
+		if (source->IsStream()) {
+			source->GetPlayCursor().Play(m_played_blocks);
+		}
+	}
+
+	if (m_queue_idle) {
+		return;
+	}
+
+	const bool active = has_stream_playing(m_playing);
+	if (!active && m_silent_count >= NUM_OPENSL_BUFFERS) {
+		// the queue drains, nothing is enqueued until WakeupQueuePlayer()
+		m_queue_idle = true;
+		return;
+	}
+
+	m_queue_mixer->Reset();
 
 	auto itr = m_playing.begin();
 	for ( ; itr != m_playing.end(); ++itr)
@@ -217,32 +469,20 @@ void AudioPool::ProcessSLCallback(SLAndroidSimpleBufferQueueItf bq)
 		if (!source->IsStream() || source->IsStopped() || source->IsPaused()) {
 			continue;
 		}
-
-		OutputBuffer* obuf = source->GetOutputBuffer();
-		assert(obuf);
-		int buf_sz;
-		const unsigned char* buf = obuf->Output(buf_sz);
-		if (!buf) {
-			continue;
-		}
-
-		const InputBuffer* ibuf = source->GetInputBuffer();
-		assert(ibuf);
-		const std::unique_ptr<Decoder>& decoder = ibuf->GetDecoder();
-		int hz = decoder->GetSampleRate();
-		int depth = decoder->GetBitDepth();
-		int channels = decoder->GetChannels();
-
-		float samples = buf_sz * 8.0f / depth / channels;
-		float offset = samples / hz;
-		source->UpdataOffset(offset);
-
-		m_queue_mixer.Input(buf, buf_sz, hz, depth, channels, source->GetCurrVolume());
+		add_voice(*source, m_graph->GetBatch(source->GetMixBus()), *m_queue_mixer, m_mixed_blocks, m_xruns);
+	}
+	m_graph->Mix(*m_queue_mixer, m_parallel);
+
+	void* buf = m_queue_mixer->Output();
+	int buf_sz = m_queue_mixer->GetBufSize();
+	if (m_queue_mixer->IsSilent()) {
+		buf = m_silence;
+		++m_silent_count;
+	} else {
+		m_silent_count = 0;
 	}
-
-	int16_t* buf = m_queue_mixer.Output();
-	int buf_sz = m_queue_mixer.GetBufSize();
 	(*m_queue_player.queue)->Enqueue(m_queue_player.queue, buf, buf_sz);
+	++m_mixed_blocks;
 }
 
 void AudioPool::CreateAssetsAudioPlayer()
@@ -263,24 +503,21 @@ static void bqPlayerCallback(SLAndroidSimpleBufferQueueItf bq, void *context)
 	(static_cast<AudioPool*>(context))->ProcessSLCallback(bq);
 }
 
-void AudioPool::CreateBufferQueueAudioPlayer()
+SLresult AudioPool::CreateBufferQueueAudioPlayer(const OutputFormat& fmt, bool float_fmt)
 {
-	SLresult result;
-
     // configure audio source
     SLDataLocator_AndroidSimpleBufferQueue loc_bufq = {SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE, NUM_OPENSL_BUFFERS};
-	// configure a typical audio source of 44.1 kHz stereo 16-bit little endian
-    SLDataFormat_PCM format_pcm = {SL_DATAFORMAT_PCM, 2, SL_SAMPLINGRATE_44_1,
-        SL_PCMSAMPLEFORMAT_FIXED_16, SL_PCMSAMPLEFORMAT_FIXED_16,
-        SL_SPEAKER_FRONT_LEFT | SL_SPEAKER_FRONT_RIGHT, SL_BYTEORDER_LITTLEENDIAN};
-    /*
-     * Enable Fast Audio when possible:  once we set the same rate to be the native, fast audio path
-     * will be triggered
-     */
-    if(m_queue_player.sample_rate) {
-        format_pcm.samplesPerSec = m_queue_player.sample_rate;       //sample rate in mili second
-    }
+    const SLuint32 mask = fmt.channels == 1 ? SL_SPEAKER_FRONT_CENTER : (SL_SPEAKER_FRONT_LEFT | SL_SPEAKER_FRONT_RIGHT);
+    SLDataFormat_PCM format_pcm = {SL_DATAFORMAT_PCM, static_cast<SLuint32>(fmt.channels),
+        static_cast<SLuint32>(fmt.sample_rate * 1000),  //sample rate in mili hz
+        SL_PCMSAMPLEFORMAT_FIXED_16, SL_PCMSAMPLEFORMAT_FIXED_16, mask, SL_BYTEORDER_LITTLEENDIAN};
+    SLAndroidDataFormat_PCM_EX format_pcm_ex = {SL_ANDROID_DATAFORMAT_PCM_EX, format_pcm.numChannels,
+        format_pcm.samplesPerSec, SL_PCMSAMPLEFORMAT_FIXED_32, SL_PCMSAMPLEFORMAT_FIXED_32, mask,
+        SL_BYTEORDER_LITTLEENDIAN, SL_ANDROID_PCM_REPRESENTATION_FLOAT};
     SLDataSource audioSrc = {&loc_bufq, &format_pcm};
+    if (float_fmt) {
+        audioSrc.pFormat = &format_pcm_ex;
+    }
 
     // configure audio sink
     SLDataLocator_OutputMix loc_outmix = {SL_DATALOCATOR_OUTPUTMIX, m_ctx->GetOutputMix()};
@@ -296,10 +533,38 @@ void AudioPool::CreateBufferQueueAudioPlayer()
     const SLboolean req[3] = {SL_BOOLEAN_TRUE, SL_BOOLEAN_TRUE, SL_BOOLEAN_TRUE,
                                    /*SL_BOOLEAN_TRUE,*/ };
 
-	result = (*m_ctx->GetEngine())->CreateAudioPlayer(m_ctx->GetEngine(), &m_queue_player.object, &audioSrc, &audioSnk, 2, ids, req);
+	return (*m_ctx->GetEngine())->CreateAudioPlayer(m_ctx->GetEngine(), &m_queue_player.object, &audioSrc, &audioSnk, 2, ids, req);
+}
+
+void AudioPool::CreateBufferQueueAudioPlayer(const OutputFormat& fmt)
+{
+	SLresult result;
+
+	/*
+	 * Enable Fast Audio when possible:  once we set the same rate to be the native, fast audio path
+	 * will be triggered, the native rate comes from java's AudioManager in `fmt`
+	 */
+	m_format = fmt;
+	if (m_format.sample_rate == 0) {
+		m_format.sample_rate = m_queue_player.sample_rate / 1000;
+	}
+	if (m_format.channels != 1 && m_format.channels != 2) {
+		m_format.channels = AudioMixer::DEFAULT_CHANNELS;
+	}
+
+	result = SL_RESULT_FEATURE_UNSUPPORTED;
+	if (m_format.sample_fmt == OutputFormat::SAMPLE_F32) {
+		result = CreateBufferQueueAudioPlayer(m_format, true);
+	}
+	if (result != SL_RESULT_SUCCESS) {
+		// float needs android 5.0
+		m_format.sample_fmt = OutputFormat::SAMPLE_S16;
+		result = CreateBufferQueueAudioPlayer(m_format, false);
+	}
 	if (result!= SL_RESULT_SUCCESS) {
 		throw Exception("Could not create audio player.");
 	}
+	m_queue_player.sample_rate = m_format.sample_rate * 1000;
 
 	// realize the player
 	result = (*m_queue_player.object)->Realize(m_queue_player.object, SL_BOOLEAN_FALSE);
@@ -357,20 +622,27 @@ void AudioPool::CreateBufferQueueAudioPlayer()
 
 void AudioPool::EnqueueAllBuffers()
 {
-	int buf_sz = m_queue_mixer.GetBufSize();
-	void* buf = std::malloc(buf_sz);
-	if (!buf) {
-		throw Exception("Could not malloc buf.");
-	}
-	memset(buf, 0, buf_sz);
+	// the queue keeps the pointer, m_silence lives as long as the pool
+	int buf_sz = m_queue_mixer->GetBufSize();
 	for (int i = 0; i < NUM_OPENSL_BUFFERS; ++i) {
- 		SLresult result = (*m_queue_player.queue)->Enqueue(m_queue_player.queue, buf, buf_sz);
+ 		SLresult result = (*m_queue_player.queue)->Enqueue(m_queue_player.queue, m_silence, buf_sz);
  		if (SL_RESULT_SUCCESS != result) {
-			std::free(buf);
 			return;
  		}
+		++m_mixed_blocks;
 	}
-	std::free(buf);
+	m_silent_count = NUM_OPENSL_BUFFERS;
+}
+
+void AudioPool::WakeupQueuePlayer()
+{
+	(*m_queue_player.queue)->Clear(m_queue_player.queue);
+	// dropped, as good as played
+	m_played_blocks = m_mixed_blocks;
+	EnqueueAllBuffers();
+	(*m_queue_player.play)->SetPlayState(m_queue_player.play, SL_PLAYSTATE_PLAYING);
+	m_queue_idle = false;
+	m_queue_paused = false;
 }
 
 // todo: life for context
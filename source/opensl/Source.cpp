@@ -6,6 +6,8 @@
 #include "uniaudio/InputBuffer.h"
 #include "uniaudio/Exception.h"
 
+#include <algorithm>
+
 #include <assert.h>
 
 #define FORCE_REPLAY
@@ -24,6 +26,8 @@ Source::Source(AudioPool* pool, const std::string& filepath)
 	, m_stream(false)
 	, m_ibuf(nullptr)
 	, m_obuf(nullptr)
+	, m_depth(AudioContext::BUFFER_TIME_LEN, OUTPUT_BUF_MIN_DEPTH, OUTPUT_BUF_COUNT)
+	, m_resampler(nullptr)
 	, m_filepath(filepath)
 	, m_player(nullptr)
 {
@@ -37,6 +41,8 @@ Source::Source(AudioPool* pool, std::unique_ptr<Decoder>& decoder)
 	, m_curr_offset(0)
 	, m_stream(true)
 	, m_ibuf(nullptr)
+	, m_depth(AudioContext::BUFFER_TIME_LEN, OUTPUT_BUF_MIN_DEPTH, OUTPUT_BUF_COUNT)
+	, m_resampler(nullptr)
 	, m_player(nullptr)
 {
 	m_ibuf = new InputBuffer(decoder);
@@ -50,7 +56,7 @@ Source::Source(AudioPool* pool, std::unique_ptr<Decoder>& decoder)
 	const int channels = dc->GetChannels();
 	const int samples = static_cast<int>(HZ * AudioContext::BUFFER_TIME_LEN);
 	int buf_sz = depth * channels * samples / 8;
-	m_obuf = new OutputBuffer(OUTPUT_BUF_COUNT, buf_sz);
+	m_obuf = new OutputBuffer(OUTPUT_BUF_COUNT, buf_sz, m_pool->GetBufferPool());
 	if (!m_obuf) {
 		throw Exception("Could not create OutputBuffer.");
 	}
@@ -65,6 +71,8 @@ Source::Source(const Source& src)
 	, m_stream(src.m_stream)
 	, m_ibuf(nullptr)
 	, m_obuf(nullptr)
+	, m_depth(src.m_depth)
+	, m_resampler(nullptr)
 	, m_filepath(src.m_filepath)
 	, m_player(nullptr)
 {
@@ -75,6 +83,8 @@ Source::Source(const Source& src)
 		if (!m_ibuf) {
 			throw Exception("Could not create InputBuffer.");
 		}
+		m_ibuf->SetLooping(m_looping);
+		m_ibuf->SetLoopRegion(m_loop_begin, m_loop_end);
 
 		auto& dc = m_ibuf->GetDecoder();
 		const int HZ = dc->GetSampleRate();
@@ -82,7 +92,7 @@ Source::Source(const Source& src)
 		const int channels = dc->GetChannels();
 		const int samples = static_cast<int>(HZ * AudioContext::BUFFER_TIME_LEN);
 		int buf_sz = depth * channels * samples / 8;
-		m_obuf = new OutputBuffer(OUTPUT_BUF_COUNT, buf_sz);
+		m_obuf = new OutputBuffer(OUTPUT_BUF_COUNT, buf_sz, m_pool->GetBufferPool());
 		if (!m_obuf) {
 			throw Exception("Could not create OutputBuffer.");
 		}
@@ -100,6 +110,9 @@ Source::~Source()
 	if (m_obuf) {
 		delete m_obuf;
 	}
+	if (m_resampler) {
+		delete m_resampler;
+	}
 }
 
 std::shared_ptr<ua::Source> Source::Clone()
@@ -117,7 +130,7 @@ bool Source::Update()
 		return !IsStopped();
 	} else if (!IsLooping() && IsFinished()) {
 		return false;
-	} else if (m_duration != 0 && m_curr_offset > m_offset + m_duration) {
+	} else if (IsPastDuration(m_cursor.GetTime())) {
 		StopImpl();
 		return false;
 	}
@@ -179,6 +192,11 @@ void Source::Seek(float offset)
 
 float Source::Tell()
 {
+	// published by the mixer, no lock
+	if (m_stream) {
+		const std::unique_ptr<Decoder>& decoder = m_ibuf->GetDecoder();
+		return static_cast<float>(WrapLoop(m_cursor.GetTime(true), decoder->GetSampleRate(), decoder->GetDuration()));
+	}
 	return m_pool->Tell(shared_from_this());
 }
 
@@ -189,6 +207,13 @@ void Source::PlayImpl()
 
 	if (m_stream)
 	{
+		ResetResampler();
+		m_mix_voice = AudioMixer::Voice();
+		m_gain_ramp.SetSampleRate(m_pool->GetOutputFormat().sample_rate);
+		m_gain_ramp.Start(m_ori_volume * m_pool->GetVolume());
+		m_cursor.SetSampleRate(m_pool->GetOutputFormat().sample_rate);
+		m_cursor.Reset(m_offset);
+		m_depth.Restart();
 	}
 	else
 	{
@@ -209,6 +234,7 @@ void Source::StopImpl()
 
 	if (m_stream)
 	{
+		m_cursor.Reset(0);
 	}
 	else
 	{
@@ -292,14 +318,15 @@ void Source::SeekImpl(float offset)
 
 	if (m_stream)
 	{
-		bool looping = IsLooping();
-		m_ibuf->Seek(offset, looping);
-		m_ibuf->Output(m_obuf, looping);
+		m_ibuf->Seek(offset);
+		m_ibuf->Output(m_obuf);
 
 		bool paused = m_paused;
 		StopImpl();
 		PlayImpl();
 		m_curr_offset = offset;
+		m_gain_ramp.Seek(offset - m_offset);
+		m_cursor.Reset(offset);
 		if (paused) {
 			PauseImpl();
 		}
@@ -310,9 +337,35 @@ void Source::SeekImpl(float offset)
 	}
 }
 
+void Source::SetLooping(bool looping)
+{
+	m_looping = looping;
+	if (m_ibuf) {
+		m_ibuf->SetLooping(looping);
+	}
+	UpdateFadeOut();
+}
+
+void Source::SetLoopRegion(int64_t begin, int64_t end)
+{
+	if (!SetLoopRegionImpl(begin, end)) {
+		throw Exception("Invalid loop region: %lld %lld\n", static_cast<long long>(begin), static_cast<long long>(end));
+	}
+	if (m_ibuf) {
+		m_ibuf->SetLoopRegion(begin, end);
+	}
+}
+
 float Source::TellImpl()
 {
-	return m_active ? m_curr_offset : 0;
+	if (!m_active) {
+		return 0;
+	}
+	if (m_stream) {
+		const std::unique_ptr<Decoder>& decoder = m_ibuf->GetDecoder();
+		return static_cast<float>(WrapLoop(m_cursor.GetTime(), decoder->GetSampleRate(), decoder->GetDuration()));
+	}
+	return m_curr_offset;
 }
 
 bool Source::IsStopped() const
@@ -325,6 +378,21 @@ bool Source::IsPaused() const
 	return m_paused;
 }
 
+int Source::GetUnderruns() const
+{
+	return m_obuf ? m_obuf->GetUnderruns() : 0;
+}
+
+void Source::SetBufferLatency(float min_time, float max_time)
+{
+	m_depth.SetLatency(min_time, std::min(max_time, OUTPUT_BUF_COUNT * m_depth.GetBlockTime()));
+}
+
+float Source::GetBufferLatency() const
+{
+	return m_obuf ? m_obuf->GetDepth() * m_depth.GetBlockTime() : 0;
+}
+
 bool Source::IsFinished() const
 {
 	if (m_stream) {
@@ -338,18 +406,40 @@ bool Source::IsFinished() const
 void Source::Stream()
 {
 	assert(m_ibuf && m_obuf);
-	m_ibuf->Output(m_obuf, IsLooping());
+	m_obuf->SetDepth(m_depth.Update(m_obuf->GetUnderruns()));
+	// decoded ahead on the pool's workers otherwise
+	if (!m_pool->IsDecodeAhead()) {
+		m_ibuf->Output(m_obuf);
+	}
 }
 
 void Source::UpdateCurrVolume()
 {
+	// the mixer does the fades
 	m_curr_volume = m_ori_volume * m_pool->GetVolume();
+	m_gain_ramp.SetVolume(m_curr_volume);
+}
 
-	float offset = m_ibuf->GetOffset();
-	if (m_fade_in > 0 && offset < m_fade_in) {
-		m_curr_volume = m_ori_volume * offset / m_fade_in;
-	} else if (m_fade_out > 0 && m_duration + m_offset - offset < m_fade_out) {
-		m_curr_volume = m_ori_volume * (m_duration + m_offset - offset) / m_fade_out;
+void Source::ResetResampler()
+{
+	auto& dc = m_ibuf->GetDecoder();
+	const int hz = dc->GetSampleRate();
+	const int out_hz = m_pool->GetOutputFormat().sample_rate;
+	if (hz == out_hz) {
+		return;
+	}
+
+	if (m_resampler && m_resampler->GetQuality() == m_resample_quality) {
+		m_resampler->Reset();
+		return;
+	}
+
+	if (m_resampler) {
+		delete m_resampler;
+	}
+	m_resampler = new Resampler(hz, out_hz, dc->GetChannels(), m_resample_quality);
+	if (!m_resampler) {
+		throw Exception("Could not create Resampler.");
 	}
 }
 